@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "backend.h"
+
+#if defined(HAVE_MKL)
+#include "mkl_lapacke.h"
+#define LIBRARY_NAME "mkl"
+#elif defined(HAVE_LAPACKE)
+#include <lapacke.h>
+#define LIBRARY_NAME "lapacke"
+#endif
+
+#define AT(a, lda, i, j) (a)[(size_t)(j) * (lda) + (i)] // column-major element (i, j)
+
+
+/* ---- builtin: unblocked column-oriented loops, every inner loop runs down
+   a contiguous column ---- */
+
+static int builtin_potrf(int n, double *a, int lda) {
+    int i, j, k;
+    double d;
+
+    for (j = 0; j < n; j++) {
+        d = AT(a, lda, j, j);
+        if (d <= 0.0) return j + 1;
+        d = sqrt(d);
+        AT(a, lda, j, j) = d;
+        for (i = j + 1; i < n; i++) AT(a, lda, i, j) /= d;
+        // right-looking update of the lower trailing triangle
+        for (k = j + 1; k < n; k++) {
+            double l = AT(a, lda, k, j);
+            for (i = k; i < n; i++) AT(a, lda, i, k) -= AT(a, lda, i, j) * l;
+        }
+    }
+    return 0;
+}
+
+static int builtin_potrs(int n, int nrhs, const double *a, int lda, double *b, int ldb) {
+    int i, j, c;
+
+    for (c = 0; c < nrhs; c++) {
+        double *x = b + (size_t)c * ldb;
+        for (j = 0; j < n; j++) { // L y = b
+            x[j] /= AT(a, lda, j, j);
+            for (i = j + 1; i < n; i++) x[i] -= AT(a, lda, i, j) * x[j];
+        }
+        for (j = n - 1; j >= 0; j--) { // L^T x = y
+            double s = x[j];
+            for (i = j + 1; i < n; i++) s -= AT(a, lda, i, j) * x[i];
+            x[j] = s / AT(a, lda, j, j);
+        }
+    }
+    return 0;
+}
+
+static int builtin_getrf(int n, double *a, int lda, int *ipiv) {
+    int i, j, k, p;
+    double t;
+
+    for (k = 0; k < n; k++) {
+        p = k;
+        for (i = k + 1; i < n; i++) if (fabs(AT(a, lda, i, k)) > fabs(AT(a, lda, p, k))) p = i;
+        ipiv[k] = p + 1;
+        if (p != k) {
+            for (j = 0; j < n; j++) { t = AT(a, lda, k, j); AT(a, lda, k, j) = AT(a, lda, p, j); AT(a, lda, p, j) = t; }
+        }
+        if (AT(a, lda, k, k) == 0.0) return k + 1;
+        for (i = k + 1; i < n; i++) AT(a, lda, i, k) /= AT(a, lda, k, k);
+        for (j = k + 1; j < n; j++) {
+            double u = AT(a, lda, k, j);
+            for (i = k + 1; i < n; i++) AT(a, lda, i, j) -= AT(a, lda, i, k) * u;
+        }
+    }
+    return 0;
+}
+
+static int builtin_getrs(int n, int nrhs, const double *a, int lda, const int *ipiv, double *b, int ldb) {
+    int i, j, c;
+    double t;
+
+    for (c = 0; c < nrhs; c++) {
+        double *x = b + (size_t)c * ldb;
+        for (j = 0; j < n; j++) {
+            if (ipiv[j] - 1 != j) { t = x[j]; x[j] = x[ipiv[j] - 1]; x[ipiv[j] - 1] = t; }
+        }
+        for (j = 0; j < n; j++) { // unit L
+            for (i = j + 1; i < n; i++) x[i] -= AT(a, lda, i, j) * x[j];
+        }
+        for (j = n - 1; j >= 0; j--) { // U
+            x[j] /= AT(a, lda, j, j);
+            for (i = 0; i < j; i++) x[i] -= AT(a, lda, i, j) * x[j];
+        }
+    }
+    return 0;
+}
+
+static void builtin_gemv(char trans, int m, int n, double alpha, const double *a, int lda,
+                         const double *x, double beta, double *y) {
+    int i, j;
+
+    if (trans == 'N' || trans == 'n') { // y is m long
+        for (i = 0; i < m; i++) y[i] *= beta;
+        for (j = 0; j < n; j++) {
+            double s = alpha * x[j];
+            for (i = 0; i < m; i++) y[i] += AT(a, lda, i, j) * s;
+        }
+    } else { // y is n long, one dot product per column
+        for (j = 0; j < n; j++) {
+            double s = 0.0;
+            for (i = 0; i < m; i++) s += AT(a, lda, i, j) * x[i];
+            y[j] = alpha * s + beta * y[j];
+        }
+    }
+}
+
+static const la_backend backend_builtin = {
+    "builtin", builtin_potrf, builtin_potrs, builtin_getrf, builtin_getrs, builtin_gemv
+};
+
+
+/* ---- LAPACKE (OpenBLAS, reference or MKL), with the Fortran BLAS dgemv ---- */
+#ifdef LIBRARY_NAME
+
+_Static_assert(sizeof(lapack_int) == sizeof(int), "the backend table expects 32-bit LAPACK integers");
+
+void dgemv_(const char *trans, const int *m, const int *n, const double *alpha, const double *a, const int *lda,
+            const double *x, const int *incx, const double *beta, double *y, const int *incy);
+
+static int library_potrf(int n, double *a, int lda) {
+    return LAPACKE_dpotrf(LAPACK_COL_MAJOR, 'L', n, a, lda);
+}
+
+static int library_potrs(int n, int nrhs, const double *a, int lda, double *b, int ldb) {
+    return LAPACKE_dpotrs(LAPACK_COL_MAJOR, 'L', n, nrhs, a, lda, b, ldb);
+}
+
+static int library_getrf(int n, double *a, int lda, int *ipiv) {
+    return LAPACKE_dgetrf(LAPACK_COL_MAJOR, n, n, a, lda, ipiv);
+}
+
+static int library_getrs(int n, int nrhs, const double *a, int lda, const int *ipiv, double *b, int ldb) {
+    return LAPACKE_dgetrs(LAPACK_COL_MAJOR, 'N', n, nrhs, a, lda, ipiv, b, ldb);
+}
+
+static void library_gemv(char trans, int m, int n, double alpha, const double *a, int lda,
+                         const double *x, double beta, double *y) {
+    int one = 1;
+    dgemv_(&trans, &m, &n, &alpha, a, &lda, x, &one, &beta, y, &one);
+}
+
+static const la_backend backend_library = {
+    LIBRARY_NAME, library_potrf, library_potrs, library_getrf, library_getrs, library_gemv
+};
+#endif
+
+
+static const la_backend *selected = NULL;
+
+const la_backend *la_backend_select(void) {
+    const char *env;
+
+    if (selected != NULL) return selected;
+
+    selected = &backend_builtin;
+#ifdef LIBRARY_NAME
+    selected = &backend_library;
+#endif
+    // e.g. LA_BACKEND=builtin to compare the library against the plain loops
+    env = getenv("LA_BACKEND");
+    if (env != NULL) {
+        if (strcmp(env, "builtin") == 0) selected = &backend_builtin;
+#ifdef LIBRARY_NAME
+        else if (strcmp(env, LIBRARY_NAME) == 0) selected = &backend_library;
+#endif
+        else fprintf(stderr, "Warning: LA_BACKEND=%s not built in, using %s.\n", env, selected->name);
+    }
+    return selected;
+}
@@ -0,0 +1,26 @@
+#ifndef BACKEND_H
+#define BACKEND_H
+
+/* double-precision dense kernels behind one table, so the drivers run the
+   same calls on whichever library the node has. All matrices are
+   column-major with a leading dimension, as in LAPACK; pivots are 1-based.
+
+   builtin   plain C loops in backend.c, always available
+   lapacke   any LAPACKE + BLAS (OpenBLAS, reference), built with -DHAVE_LAPACKE
+   mkl       Intel MKL, built with -DHAVE_MKL
+
+   la_backend_select() picks the library compiled in, or builtin; the
+   LA_BACKEND environment variable overrides it. */
+typedef struct {
+    const char *name;
+    int  (*potrf)(int n, double *a, int lda);                       // A = L L^T, L in the lower triangle
+    int  (*potrs)(int n, int nrhs, const double *a, int lda, double *b, int ldb);
+    int  (*getrf)(int n, double *a, int lda, int *ipiv);            // PA = LU
+    int  (*getrs)(int n, int nrhs, const double *a, int lda, const int *ipiv, double *b, int ldb);
+    void (*gemv)(char trans, int m, int n, double alpha, const double *a, int lda,
+                 const double *x, double beta, double *y);          // y = alpha op(A) x + beta y
+} la_backend;
+
+const la_backend *la_backend_select(void);
+
+#endif
@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "util.h"
+#include "kernels.h"
+#include "banded.h"
+
+#define SWAP(a,b) {float temp=(a);(a)=(b);(b)=temp;}
+
+// column blocks of the multi-RHS solves, as in primitives.c
+#define RHS_BLOCK 64
+
+// first stored column of row i: the band edge, or the skyline's first[i]
+#define BAND_FIRST(kl, i) ((i) > (kl) ? (i) - (kl) : 0)
+#define ROW_FIRST(first, kl, i) ((first) != NULL ? (first)[i] : BAND_FIRST(kl, i))
+
+
+/* bandwidth and envelope of A in one pass over its rows. With lower set only
+   the lower triangle is read (A may be a tri_matrix()) and A is taken to be
+   symmetric, ku = kl. The diagonal always counts as inside the band. */
+void band_detect(float **A, int n, int lower, band_info *bi) {
+    int i, j;
+
+    bi->kl = bi->ku = 0;
+    bi->profile = 0;
+    bi->sky_work = 0.0;
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < i && A[i][j] == 0.0f; j++);
+        if (i - j > bi->kl) bi->kl = i - j;
+        bi->profile += i - j + 1;
+        bi->sky_work += 0.5 * (double)(i - j) * (i - j);
+        if (lower) continue;
+        for (j = n - 1; j > i && A[i][j] == 0.0f; j--);
+        if (j - i > bi->ku) bi->ku = j - i;
+    }
+    if (lower) bi->ku = bi->kl;
+}
+
+/* the solver for a system with this band: dense unless the band one saves at
+   least a factor BAND_MIN_GAIN of the multiply-adds. Cholesky takes the
+   skyline when the envelope is ragged enough to save a quarter of the band's
+   work, the band loops are simpler otherwise. */
+band_path band_choose(const band_info *bi, int n, int cholesky) {
+    double dn = (double)n, band;
+
+    if (cholesky) {
+        band = 0.5 * dn * bi->kl * bi->kl;
+        if (BAND_MIN_GAIN * fmin(band, bi->sky_work) > dn * dn * dn / 6.0) return BAND_DENSE;
+        return (4.0 * bi->sky_work < 3.0 * band) ? BAND_SKYLINE : BAND_CHOLESKY;
+    }
+    band = dn * bi->kl * (bi->kl + bi->ku + 1.0);
+    return (BAND_MIN_GAIN * band > dn * dn * dn / 3.0) ? BAND_DENSE : BAND_LU;
+}
+
+const char *band_path_name(band_path path) {
+    switch (path) {
+        case BAND_CHOLESKY: return "band Cholesky";
+        case BAND_SKYLINE: return "skyline Cholesky";
+        case BAND_LU: return "band LU";
+        default: return "dense";
+    }
+}
+
+
+// bytes arena_band_matrix() takes
+size_t arena_band_matrix_size(long n, int lo, int hi, size_t elem_size) {
+    return arena_matrix_size(n, (long)lo + hi + 1, elem_size);
+}
+
+/* n rows of the columns i - lo .. i + hi, addressed as A[i][j]. The row
+   pointer sits inside the block (i (lo + hi) + lo elements in), only the
+   columns before 0 of the first lo rows are never touched. */
+float **arena_band_matrix(arena *a, long n, int lo, int hi) {
+    long w = (long)lo + hi + 1;
+    float **m = arena_alloc(a, (size_t)n * sizeof(float *));
+    float *m_data = arena_vector(a, n * w);
+
+    for (long i = 0; i < n; i++) m[i] = m_data + i * (w - 1) + lo;
+    return m;
+}
+
+/* the lower envelope of A (full or tri_matrix()) copied into skyline storage;
+   first[] (n entries) receives the first nonzero column of each row */
+float **arena_skyline_matrix(arena *a, float **A, int n, int *first) {
+    float **m = arena_alloc(a, (size_t)n * sizeof(float *));
+    float *m_data;
+    long off = 0;
+    int i, j;
+
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < i && A[i][j] == 0.0f; j++);
+        first[i] = j;
+        off += i - j + 1;
+    }
+    m_data = arena_vector(a, off);
+    for (off = 0, i = 0; i < n; i++) {
+        m[i] = m_data + off - first[i]; // off >= i >= first[i]: stays inside the block
+        for (j = first[i]; j <= i; j++) m[i][j] = A[i][j];
+        off += i - first[i] + 1;
+    }
+    return m;
+}
+
+
+/* Cholesky inside the lower envelope, which the factor does not grow out of:
+   L[i][k] L[j][k] is only nonzero from the later of the two first columns on.
+   first == NULL means the band of width kl. Returns like cholesky_factor(). */
+static int envelope_factor(float **L, const int *first, int n, int kl) {
+    int i, j, k, fi, k0;
+    float sum;
+
+    for (i = 0; i < n; i++) {
+        fi = ROW_FIRST(first, kl, i);
+        for (j = fi; j <= i; j++) {
+            k0 = ROW_FIRST(first, kl, j);
+            if (k0 < fi) k0 = fi;
+            sum = L[i][j];
+            for (k = k0; k < j; k++) sum -= L[i][k] * L[j][k];
+            if (i == j) {
+                if (sum <= 0.0f) return i + 1;
+                L[i][i] = sqrtf(sum);
+            } else {
+                L[i][j] = sum / L[j][j];
+            }
+        }
+    }
+    return 0;
+}
+
+// cholesky_solve_multi() with the rows cut to the envelope. B and X may alias
+static void envelope_solve(float **L, const int *first, float **B, float **X, int n, int kl, int m) {
+    int i, j, c0, w, fi;
+    const gj_kernels *kern = gj_kernels_select();
+
+    for (c0 = 0; c0 < m; c0 += RHS_BLOCK) {
+        w = (m - c0 < RHS_BLOCK) ? m - c0 : RHS_BLOCK;
+
+        // forward substitution LY = B
+        for (i = 0; i < n; i++) {
+            float *xi = X[i] + c0;
+            fi = ROW_FIRST(first, kl, i);
+            if (X != B) for (j = 0; j < w; j++) xi[j] = B[i][c0 + j];
+            for (j = fi; j < i; j++) kern->row_axpy(xi, X[j] + c0, L[i][j], w);
+            kern->row_div(xi, L[i][i], w);
+        }
+
+        // back substitution L^T X = Y, column-oriented so L is read along its rows
+        for (i = n - 1; i >= 0; i--) {
+            float *xi = X[i] + c0;
+            fi = ROW_FIRST(first, kl, i);
+            kern->row_div(xi, L[i][i], w);
+            for (j = fi; j < i; j++) kern->row_axpy(X[j] + c0, xi, L[i][j], w);
+        }
+    }
+}
+
+// Cholesky of a band matrix (arena_band_matrix(n, kl, 0)), lower triangle only
+int band_cholesky(float **L, int n, int kl) {
+    return envelope_factor(L, NULL, n, kl);
+}
+
+void band_cholesky_solve_multi(float **L, float **B, float **X, int n, int kl, int m) {
+    envelope_solve(L, NULL, B, X, n, kl, m);
+}
+
+// Cholesky of a skyline matrix from arena_skyline_matrix()
+int skyline_cholesky(float **L, const int *first, int n) {
+    return envelope_factor(L, first, n, 0);
+}
+
+void skyline_solve_multi(float **L, const int *first, float **B, float **X, int n, int m) {
+    envelope_solve(L, first, B, X, n, 0, m);
+}
+
+
+/* LU with partial pivoting of a band matrix with kl sub- and ku
+   superdiagonals, stored as arena_band_matrix(n, kl, kl + ku): the extra kl
+   columns take the fill of the row exchanges. As in LAPACK's gbtrf, piv[k]
+   is the row exchanged with row k at step k and the multipliers of step k
+   stay where they were computed (column k of rows k+1 .. k+kl); only the
+   U part of the two rows is swapped. Returns 0, or k+1 for a zero pivot. */
+int band_lu_factor(float **A, int n, int kl, int ku, int *piv) {
+    int i, j, k, p, bot, last;
+    const gj_kernels *kern = gj_kernels_select();
+
+    for (k = 0; k < n; k++) {
+        bot = (k + kl < n - 1) ? k + kl : n - 1;
+        last = (k + kl + ku < n - 1) ? k + kl + ku : n - 1;
+        p = kern->col_argmax(A, k, k, bot + 1);
+        piv[k] = p;
+        if (p != k) for (j = k; j <= last; j++) SWAP(A[k][j], A[p][j]);
+        if (fabs(A[k][k]) < 1e-12) return k + 1;
+        for (i = k + 1; i <= bot; i++) {
+            A[i][k] /= A[k][k];
+            kern->row_axpy(A[i] + k + 1, A[k] + k + 1, A[i][k], last - k);
+        }
+    }
+    return 0;
+}
+
+// solve AX = B with the factors from band_lu_factor(); B and X may alias
+void band_lu_solve_multi(float **A, const int *piv, float **B, float **X, int n, int kl, int ku, int m) {
+    int i, j, k, c0, w, last;
+    const gj_kernels *kern = gj_kernels_select();
+
+    for (c0 = 0; c0 < m; c0 += RHS_BLOCK) {
+        w = (m - c0 < RHS_BLOCK) ? m - c0 : RHS_BLOCK;
+        if (X != B) for (i = 0; i < n; i++) for (j = 0; j < w; j++) X[i][c0 + j] = B[i][c0 + j];
+
+        // forward: the exchanges and eliminations in the order of the factorization
+        for (k = 0; k < n; k++) {
+            float *xk = X[k] + c0;
+            if (piv[k] != k) for (j = 0; j < w; j++) SWAP(xk[j], X[piv[k]][c0 + j]);
+            for (i = k + 1; i <= k + kl && i < n; i++) kern->row_axpy(X[i] + c0, xk, A[i][k], w);
+        }
+
+        // back substitution UX = Y, U has kl + ku superdiagonals after the fill
+        for (i = n - 1; i >= 0; i--) {
+            float *xi = X[i] + c0;
+            last = (i + kl + ku < n - 1) ? i + kl + ku : n - 1;
+            for (j = i + 1; j <= last; j++) kern->row_axpy(xi, X[j] + c0, A[i][j], w);
+            kern->row_div(xi, A[i][i], w);
+        }
+    }
+}
+
+
+/* solve AX = B along the band path from band_choose(), with the working
+   storage from the arena. A is left untouched; for the Cholesky paths only
+   its lower triangle is read, so it may be a tri_matrix() and must be
+   symmetric. Returns 0, or the info of the failed factorization. */
+int band_solve(float **A, float **B, float **X, int n, int m, band_path path, const band_info *bi, arena *work) {
+    float **W;
+    int *idx, i, j, info, kl = bi->kl, ku = bi->ku;
+
+    if (path == BAND_SKYLINE) {
+        idx = arena_ivector(work, n);
+        W = arena_skyline_matrix(work, A, n, idx);
+        if ((info = skyline_cholesky(W, idx, n)) != 0) return info;
+        skyline_solve_multi(W, idx, B, X, n, m);
+    } else if (path == BAND_CHOLESKY) {
+        W = arena_band_matrix(work, n, kl, 0);
+        for (i = 0; i < n; i++) for (j = BAND_FIRST(kl, i); j <= i; j++) W[i][j] = A[i][j];
+        if ((info = band_cholesky(W, n, kl)) != 0) return info;
+        band_cholesky_solve_multi(W, B, X, n, kl, m);
+    } else {
+        W = arena_band_matrix(work, n, kl, kl + ku);
+        idx = arena_ivector(work, n);
+        for (i = 0; i < n; i++) {
+            for (j = BAND_FIRST(kl, i); j <= i + kl + ku && j < n; j++) W[i][j] = (j <= i + ku) ? A[i][j] : 0.0f;
+        }
+        if ((info = band_lu_factor(W, n, kl, ku, idx)) != 0) return info;
+        band_lu_solve_multi(W, idx, B, X, n, kl, ku, m);
+    }
+    return 0;
+}
@@ -0,0 +1,59 @@
+#ifndef BANDED_H
+#define BANDED_H
+
+#include <stddef.h>
+#include "util.h"
+
+/* band and envelope (skyline) solvers for matrices whose nonzeros stay near
+   the diagonal, O(n b^2) time and O(n b) memory instead of O(n^3) and O(n^2).
+
+   Both storages keep the row pointers of matrix(), but row i only holds a
+   window of columns and its pointer is offset so that A[i][j] addresses
+   column j directly:
+
+   band      rows i - lo .. i + hi, n (lo + hi + 1) elements in one block
+   skyline   rows first[i] .. i (the lower envelope), one block of profile
+             elements; first[i] is the first nonzero of row i
+
+   Nothing outside a window is stored, so loops must keep to it. */
+
+// a band solver replaces the dense one when it needs at most 1/BAND_MIN_GAIN of the work
+#ifndef BAND_MIN_GAIN
+#define BAND_MIN_GAIN 8
+#endif
+
+typedef struct {
+    int kl, ku;         // A[i][j] == 0 for j < i - kl and for j > i + ku
+    long profile;       // entries of the lower envelope, sum of i - first[i] + 1
+    double sky_work;    // multiply-adds of the skyline Cholesky, sum of (i - first[i])^2 / 2
+} band_info;
+
+typedef enum { BAND_DENSE, BAND_CHOLESKY, BAND_SKYLINE, BAND_LU } band_path;
+
+void band_detect(float **A, int n, int lower, band_info *bi);
+
+band_path band_choose(const band_info *bi, int n, int cholesky);
+
+const char *band_path_name(band_path path);
+
+size_t arena_band_matrix_size(long n, int lo, int hi, size_t elem_size);
+
+float **arena_band_matrix(arena *a, long n, int lo, int hi);
+
+float **arena_skyline_matrix(arena *a, float **A, int n, int *first);
+
+int band_cholesky(float **L, int n, int kl);
+
+void band_cholesky_solve_multi(float **L, float **B, float **X, int n, int kl, int m);
+
+int skyline_cholesky(float **L, const int *first, int n);
+
+void skyline_solve_multi(float **L, const int *first, float **B, float **X, int n, int m);
+
+int band_lu_factor(float **A, int n, int kl, int ku, int *piv);
+
+void band_lu_solve_multi(float **A, const int *piv, float **B, float **X, int n, int kl, int ku, int m);
+
+int band_solve(float **A, float **B, float **X, int n, int m, band_path path, const band_info *bi, arena *work);
+
+#endif
@@ -0,0 +1,240 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "util.h"
+#include "batch.h"
+
+// the same element of BATCH_LANES systems; one register in the AVX2 clones
+typedef float lanes __attribute__((vector_size(BATCH_LANES * sizeof(float))));
+typedef int lanes_mask __attribute__((vector_size(BATCH_LANES * sizeof(int))));
+
+// a where the mask is clear, b where it is set (comparisons set all bits of a lane)
+#define BLEND(a, b, mask) ((lanes)(((lanes_mask)(a) & ~(mask)) | ((lanes_mask)(b) & (mask))))
+#define BLEND_INT(a, b, mask) (((a) & ~(mask)) | ((b) & (mask)))
+#define VABS(a) ((lanes)((lanes_mask)(a) & 0x7fffffff))
+
+// the scalar Gauss-Jordan tests the pivot in double against 1e-12; the float
+// just above it (1e-12f rounds below) gives the same answer in float compares
+#define PIVOT_MIN 0x1.19799ap-40f
+
+
+// bytes arena_batch() takes
+size_t arena_batch_size(int n, int m, long count) {
+    long len = (count + BATCH_LANES - 1) / BATCH_LANES * BATCH_LANES;
+
+    return arena_matrix_size(1, len * n * n, sizeof(float)) + 2 * arena_matrix_size(1, len * n * m, sizeof(float))
+         + arena_matrix_size(1, (long)BATCH_LANES * n * (n + m), sizeof(float)) + arena_matrix_size(1, count, sizeof(int));
+}
+
+// the lanes past count in the last group: harmless for either solver, and no NaN or denormal in the vector ops
+static void pad_lanes(batch *bt) {
+    int i, j, n = bt->n, m = bt->m;
+
+    for (long s = bt->count; s < bt->groups * BATCH_LANES; s++) {
+        for (i = 0; i < n; i++) {
+            for (j = 0; j < n; j++) BATCH_AT(bt->A, n, n, s, i, j) = (i == j) ? 1.0f : 0.0f;
+            for (j = 0; j < m; j++) BATCH_AT(bt->B, n, m, s, i, j) = 0.0f;
+        }
+    }
+}
+
+// room for count systems of N x N with M right-hand sides
+void arena_batch(arena *a, batch *bt, int n, int m, long count) {
+    long len;
+
+    bt->n = n;
+    bt->m = m;
+    bt->count = count;
+    bt->groups = (count + BATCH_LANES - 1) / BATCH_LANES;
+    len = bt->groups * BATCH_LANES;
+    bt->A = arena_vector(a, len * n * n);
+    bt->B = arena_vector(a, len * n * m);
+    bt->X = arena_vector(a, len * n * m);
+    bt->W = arena_vector(a, (long)BATCH_LANES * n * (n + m));
+    bt->info = arena_ivector(a, count);
+    pad_lanes(bt);
+}
+
+// cut the batch to its first count systems, e.g. when the input ran out before it was full
+void batch_resize(batch *bt, long count) {
+    bt->count = count;
+    bt->groups = (count + BATCH_LANES - 1) / BATCH_LANES;
+    pad_lanes(bt);
+}
+
+// system s of the batch from row-pointer matrices
+void batch_set(batch *bt, long s, float **A, float **B) {
+    int i, j, n = bt->n, m = bt->m;
+
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < n; j++) BATCH_AT(bt->A, n, n, s, i, j) = A[i][j];
+        for (j = 0; j < m; j++) BATCH_AT(bt->B, n, m, s, i, j) = B[i][j];
+    }
+}
+
+// system s back into row-pointer matrices; any of them may be NULL
+void batch_get(const batch *bt, long s, float **A, float **B, float **X) {
+    int i, j, n = bt->n, m = bt->m;
+
+    for (i = 0; i < n; i++) {
+        if (A != NULL) for (j = 0; j < n; j++) A[i][j] = BATCH_AT(bt->A, n, n, s, i, j);
+        if (B != NULL) for (j = 0; j < m; j++) B[i][j] = BATCH_AT(bt->B, n, m, s, i, j);
+        if (X != NULL) for (j = 0; j < m; j++) X[i][j] = BATCH_AT(bt->X, n, m, s, i, j);
+    }
+}
+
+
+/* Gauss-Jordan with partial pivoting on the augmented [A | B] of one group,
+   w row-major with c = n + m vectors per row. Each lane takes its own pivot
+   row, found with compare + blend; the exchange then blends rows k and r in
+   the lanes whose pivot is r. Columns left of k are already zero in every
+   row but the pivot rows, so only columns k.. are touched. */
+__attribute__((target_clones("avx2", "default")))
+static void gj_group(float *W, int n, int c, int *info) {
+    lanes *w = (lanes *)W, best, a, t, piv, inv, f;
+    lanes_mask prow, sel, iv = {0}, bad, failed = {0};
+    int i, j, k, r, l, hit;
+
+    for (k = 0; k < n; k++) {
+        lanes *wk = w + (size_t)k * c;
+
+        best = VABS(wk[k]);
+        prow = (lanes_mask){0} + k;
+        for (r = k + 1; r < n; r++) {
+            a = VABS(w[(size_t)r * c + k]);
+            sel = a > best;
+            best = BLEND(best, a, sel);
+            prow = BLEND_INT(prow, (lanes_mask){0} + r, sel);
+        }
+        bad = best < PIVOT_MIN;
+        iv = BLEND_INT(iv, (lanes_mask){0} + k + 1, bad & ~failed);
+        failed |= bad;
+
+        for (r = k + 1; r < n; r++) {
+            lanes *wr = w + (size_t)r * c;
+            sel = prow == r;
+            for (hit = 0, l = 0; l < BATCH_LANES; l++) hit |= sel[l];
+            if (!hit) continue; // no lane pivots on row r
+            for (j = k; j < c; j++) {
+                t = wk[j];
+                wk[j] = BLEND(t, wr[j], sel);
+                wr[j] = BLEND(wr[j], t, sel);
+            }
+        }
+
+        // a failed lane divides by 1, so its values stay finite
+        piv = BLEND(wk[k], (lanes){0} + 1.0f, failed);
+        inv = 1.0f / piv;
+        for (j = k + 1; j < c; j++) wk[j] *= inv;
+        wk[k] = (lanes){0} + 1.0f;
+
+        for (i = 0; i < n; i++) {
+            lanes *wi = w + (size_t)i * c;
+            if (i == k) continue;
+            f = wi[k];
+            for (j = k + 1; j < c; j++) wi[j] -= f * wk[j];
+            wi[k] = (lanes){0};
+        }
+    }
+    for (l = 0; l < BATCH_LANES; l++) info[l] = iv[l];
+}
+
+/* Cholesky of one group in the row order of cholesky_factor(), then the two
+   triangular solves into X. Only the lower triangle of A is read; the
+   diagonal of L is kept as its inverse so the solves only multiply. */
+__attribute__((target_clones("avx2", "default")))
+static void cholesky_group(const float *Ag, const float *Bg, float *Xg, float *W, int n, int m, int *info) {
+    const lanes *a = (const lanes *)Ag, *b = (const lanes *)Bg;
+    lanes *L = (lanes *)W, *x = (lanes *)Xg, sum, d;
+    lanes_mask iv = {0}, bad, failed = {0};
+    int i, j, k, l;
+
+    for (i = 0; i < n; i++) {
+        lanes *li = L + (size_t)i * n;
+        for (j = 0; j <= i; j++) {
+            lanes *lj = L + (size_t)j * n;
+            sum = a[(size_t)i * n + j];
+            for (k = 0; k < j; k++) sum -= li[k] * lj[k];
+            if (j < i) {
+                li[j] = sum * lj[j];
+                continue;
+            }
+            bad = ~(sum > 0.0f); // also catches NaN
+            iv = BLEND_INT(iv, (lanes_mask){0} + i + 1, bad & ~failed);
+            failed |= bad;
+            sum = BLEND(sum, (lanes){0} + 1.0f, failed);
+            for (l = 0; l < BATCH_LANES; l++) d[l] = sqrtf(sum[l]);
+            li[i] = 1.0f / d;
+        }
+    }
+
+    for (j = 0; j < m; j++) {
+        // forward substitution LY = B
+        for (i = 0; i < n; i++) {
+            sum = b[(size_t)i * m + j];
+            for (k = 0; k < i; k++) sum -= L[(size_t)i * n + k] * x[(size_t)k * m + j];
+            x[(size_t)i * m + j] = sum * L[(size_t)i * n + i];
+        }
+        // back substitution L^T X = Y
+        for (i = n - 1; i >= 0; i--) {
+            sum = x[(size_t)i * m + j];
+            for (k = i + 1; k < n; k++) sum -= L[(size_t)k * n + i] * x[(size_t)k * m + j];
+            x[(size_t)i * m + j] = sum * L[(size_t)i * n + i];
+        }
+    }
+    for (l = 0; l < BATCH_LANES; l++) info[l] = iv[l];
+}
+
+// per-lane info of group g into bt->info, counting the failures
+static long group_info(batch *bt, long g, const int *info) {
+    long s, failed = 0;
+
+    for (int l = 0; l < BATCH_LANES; l++) {
+        s = g * BATCH_LANES + l;
+        if (s >= bt->count) break;
+        bt->info[s] = info[l];
+        failed += (info[l] != 0);
+    }
+    return failed;
+}
+
+
+/* solve every system of the batch by Gauss-Jordan, X from A and B (both
+   left untouched). Returns the number of systems with a pivot below
+   PIVOT_MIN; their info holds that step + 1 and their X is meaningless. */
+long batch_gj_solve(batch *bt) {
+    int n = bt->n, m = bt->m, c = n + m, i, info[BATCH_LANES];
+    size_t ga = (size_t)n * n * BATCH_LANES, gb = (size_t)n * m * BATCH_LANES, row = (size_t)c * BATCH_LANES;
+    long g, failed = 0;
+
+    for (g = 0; g < bt->groups; g++) {
+        for (i = 0; i < n; i++) {
+            memcpy(bt->W + i * row, bt->A + g * ga + (size_t)i * n * BATCH_LANES, (size_t)n * BATCH_LANES * sizeof(float));
+            memcpy(bt->W + i * row + (size_t)n * BATCH_LANES, bt->B + g * gb + (size_t)i * m * BATCH_LANES,
+                   (size_t)m * BATCH_LANES * sizeof(float));
+        }
+        gj_group(bt->W, n, c, info);
+        for (i = 0; i < n; i++) {
+            memcpy(bt->X + g * gb + (size_t)i * m * BATCH_LANES, bt->W + i * row + (size_t)n * BATCH_LANES,
+                   (size_t)m * BATCH_LANES * sizeof(float));
+        }
+        failed += group_info(bt, g, info);
+    }
+    return failed;
+}
+
+/* solve every system of the batch by Cholesky; A must be symmetric positive
+   definite, only its lower triangle is read. Returns the number of systems
+   that are not, with info as cholesky_factor() returns it. */
+long batch_cholesky_solve(batch *bt) {
+    int n = bt->n, m = bt->m, info[BATCH_LANES];
+    size_t ga = (size_t)n * n * BATCH_LANES, gb = (size_t)n * m * BATCH_LANES;
+    long g, failed = 0;
+
+    for (g = 0; g < bt->groups; g++) {
+        cholesky_group(bt->A + g * ga, bt->B + g * gb, bt->X + g * gb, bt->W, n, m, info);
+        failed += group_info(bt, g, info);
+    }
+    return failed;
+}
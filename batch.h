@@ -0,0 +1,59 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+#include "util.h"
+
+/* batched solvers for many small systems of the same size.
+
+   The systems are stored interleaved, BATCH_LANES at a time: element (i, j)
+   of system s sits in group s / BATCH_LANES, lane s % BATCH_LANES (see
+   BATCH_AT), so one SIMD vector holds the same element of BATCH_LANES
+   systems and every step of the elimination is one vector op for all of
+   them. Pivot rows differ between lanes, so row exchanges are blends under
+   a per-lane mask instead of pointer swaps. A group's working copy is
+   n (n + m) vectors, which stays in L1 for the sizes this is meant for.
+
+   The lanes past count in the last group hold the identity with B = 0. */
+
+// floats per vector: 8 fills an AVX2 register; override with -DBATCH_LANES=<l>
+#ifndef BATCH_LANES
+#define BATCH_LANES 8
+#endif
+
+// largest N the multisolver batches (--batch), and systems per batch
+#ifndef BATCH_MAX_N
+#define BATCH_MAX_N 32
+#endif
+#ifndef BATCH_SYSTEMS
+#define BATCH_SYSTEMS 4096
+#endif
+
+// element (i, j) of system s in an interleaved block of rows x cols matrices
+#define BATCH_AT(p, rows, cols, s, i, j) \
+    (p)[((((size_t)(s) / BATCH_LANES) * (rows) + (i)) * (cols) + (j)) * BATCH_LANES + (size_t)(s) % BATCH_LANES]
+
+typedef struct {
+    int n, m;           // every system is N x N with M right-hand sides
+    long count;         // systems in the batch
+    long groups;        // of BATCH_LANES systems, the last one padded
+    float *A, *B, *X;   // interleaved, groups x N x N (A) and groups x N x M (B, X)
+    float *W;           // one group's working copy, N x (N + M) vectors
+    int *info;          // per system after a solve: 0, or the step that failed + 1
+} batch;
+
+size_t arena_batch_size(int n, int m, long count);
+
+void arena_batch(arena *a, batch *bt, int n, int m, long count);
+
+void batch_resize(batch *bt, long count);
+
+void batch_set(batch *bt, long s, float **A, float **B);
+
+void batch_get(const batch *bt, long s, float **A, float **B, float **X);
+
+long batch_gj_solve(batch *bt);
+
+long batch_cholesky_solve(batch *bt);
+
+#endif
@@ -0,0 +1,316 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include "primitives.h"
+#include "util.h"
+#include "backend.h"
+#include "taskdag.h"
+
+/* Benchmark of the dense solvers on in-memory systems, without file parsing
+   or printing in the timed region.
+
+   For every N of the sweep and every solver: warm-up runs, then timed
+   repetitions of factor + solve on a fresh copy of A (the copy is not
+   timed). Reports median, min and standard deviation, GFLOP/s from the
+   median and the usual flop count of the algorithm, and GB/s for the
+   compulsory traffic (A read and written once, b read, x written), which
+   is a lower bound on what the solver actually moved.
+
+   gemv times the backend's y = A b alone, the memory-bound kernel next to
+   the compute-bound factorizations, so two backends compare on both. */
+
+#define MAX_SWEEP 64
+
+typedef enum { BENCH_GJ, BENCH_CHOLESKY, BENCH_LU, BENCH_LAPACK, BENCH_TASKS, BENCH_GEMV, BENCH_COUNT } BenchSolver;
+
+static const char *solver_names[BENCH_COUNT] = { "gj", "cholesky", "lu", "lapack-cholesky", "task-cholesky", "gemv" };
+
+typedef struct {
+    BenchSolver solver;
+    long n;
+    int reps;
+    double median, min, stddev;  // seconds
+    double gflops, gbytes;       // per second, from the median
+    double residual;             // ||b - Ax||_inf / (||A||_inf ||x||_inf), last repetition;
+                                 // gemv: ||x - Ab||_inf / (||A||_inf ||b||_inf) against plain loops
+} BenchResult;
+
+
+// xorshift64*, so every run and every machine sees the same matrices
+static uint64_t rng_state;
+
+static double rng_uniform(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (double)((rng_state * 2685821657736338717ULL) >> 11) * (1.0 / 9007199254740992.0) * 2.0 - 1.0;
+}
+
+// symmetric, entries in [-1, 1] plus n on the diagonal: SPD and well conditioned
+static void make_system(double **A, double *b, long n, uint64_t seed) {
+    rng_state = seed ? seed : 1;
+    for (long i = 0; i < n; i++) {
+        for (long j = 0; j <= i; j++) A[i][j] = A[j][i] = rng_uniform();
+        A[i][i] += (double)n;
+        b[i] = rng_uniform();
+    }
+}
+
+static double flop_count(BenchSolver s, double n) {
+    switch (s) {
+        case BENCH_GJ: return n * n * n + 2.0 * n * n;                 // eliminate above and below every pivot
+        case BENCH_CHOLESKY:
+        case BENCH_LAPACK:
+        case BENCH_TASKS: return n * n * n / 3.0 + 2.0 * n * n;        // factor, two triangular solves
+        case BENCH_LU: return 2.0 * n * n * n / 3.0 + 2.0 * n * n;
+        case BENCH_GEMV: return 2.0 * n * n;
+        default: return 0.0;
+    }
+}
+
+static double byte_count(BenchSolver s, double n) {
+    double elem = (s >= BENCH_LAPACK) ? sizeof(double) : sizeof(float);
+    if (s == BENCH_GEMV) return elem * (n * n + 2.0 * n); // A only read
+    return elem * (2.0 * n * n + 2.0 * n);
+}
+
+
+/* one timed factor + solve; the working copies are refilled first, untimed.
+   x receives the solution in double. */
+static double run_once(BenchSolver s, const la_backend *la, double **A, const double *b, long n,
+                       float **W, float **Bf, float **Xf, int *perm, double *Wd, double *x) {
+    double t0, t;
+    long i, j;
+    int k;
+
+    switch (s) {
+    case BENCH_GJ: // augmented [A | b]
+        for (i = 0; i < n; i++) {
+            for (j = 0; j < n; j++) W[i][j] = (float)A[i][j];
+            W[i][n] = (float)b[i];
+        }
+        t0 = wall_time();
+        gauss_jordan_parallel(W, (int)n, 1, 0);
+        t = wall_time() - t0;
+        for (i = 0; i < n; i++) x[i] = W[i][n];
+        return t;
+
+    case BENCH_CHOLESKY:
+    case BENCH_LU:
+        for (i = 0; i < n; i++) {
+            for (j = 0; j < n; j++) W[i][j] = (float)A[i][j];
+            Bf[i][0] = (float)b[i];
+        }
+        t0 = wall_time();
+        if (s == BENCH_CHOLESKY) {
+            cholesky(W, (int)n);
+            cholesky_solve_multi(W, Bf, Xf, (int)n, 1);
+        } else {
+            if (lu_factor(W, (int)n, perm) != 0) nrerror("bench: singular test matrix");
+            lu_solve_multi(W, perm, Bf, Xf, (int)n, 1);
+        }
+        t = wall_time() - t0;
+        for (i = 0; i < n; i++) x[i] = Xf[i][0];
+        return t;
+
+    case BENCH_GEMV: // x = A b, A column-major as for potrf
+        memcpy(Wd, A[0], (size_t)n * n * sizeof(double));
+        t0 = wall_time();
+        la->gemv('N', (int)n, (int)n, 1.0, Wd, (int)n, b, 0.0, x);
+        return wall_time() - t0;
+
+    default: // column-major copy of the symmetric A is A itself
+        memcpy(Wd, A[0], (size_t)n * n * sizeof(double));
+        memcpy(x, b, (size_t)n * sizeof(double));
+        t0 = wall_time();
+        k = (s == BENCH_TASKS) ? task_potrf((int)n, Wd, (int)n, 0) : la->potrf((int)n, Wd, (int)n);
+        if (k != 0) nrerror("bench: test matrix not positive definite");
+        la->potrs((int)n, 1, Wd, (int)n, x, (int)n);
+        return wall_time() - t0;
+    }
+}
+
+static double residual(double **A, const double *b, const double *x, long n) {
+    double rmax = 0.0, amax = 0.0, xmax = 0.0;
+    for (long i = 0; i < n; i++) {
+        double r = b[i], a = 0.0;
+        for (long j = 0; j < n; j++) { r -= A[i][j] * x[j]; a += fabs(A[i][j]); }
+        if (fabs(r) > rmax) rmax = fabs(r);
+        if (a > amax) amax = a;
+        if (fabs(x[i]) > xmax) xmax = fabs(x[i]);
+    }
+    return (amax * xmax > 0.0) ? rmax / (amax * xmax) : rmax;
+}
+
+// how far the backend's gemv is from the same product in plain double loops
+static double product_error(double **A, const double *b, const double *x, long n) {
+    double emax = 0.0, amax = 0.0, bmax = 0.0;
+    for (long i = 0; i < n; i++) {
+        double y = 0.0, a = 0.0;
+        for (long j = 0; j < n; j++) { y += A[i][j] * b[j]; a += fabs(A[i][j]); }
+        if (fabs(x[i] - y) > emax) emax = fabs(x[i] - y);
+        if (a > amax) amax = a;
+        if (fabs(b[i]) > bmax) bmax = fabs(b[i]);
+    }
+    return (amax * bmax > 0.0) ? emax / (amax * bmax) : emax;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void bench_one(BenchResult *r, BenchSolver s, const la_backend *la, long n, int warmups, int reps, uint64_t seed) {
+    arena work;
+    double **A, *b, *x, *Wd, *times, mean = 0.0, var = 0.0;
+    float **W, **Bf, **Xf;
+    int *perm, k;
+
+    arena_init(&work, arena_matrix_size(n, n, sizeof(double)) + arena_matrix_size(n, n + 1, sizeof(float))
+                      + arena_matrix_size(1, n * n, sizeof(double)) + 2 * arena_matrix_size(n, 1, sizeof(float))
+                      + 3 * arena_matrix_size(1, n, sizeof(double)) + arena_matrix_size(1, reps, sizeof(double)));
+    A = arena_dmatrix(&work, n, n);
+    b = arena_dvector(&work, n);
+    x = arena_dvector(&work, n);
+    W = arena_matrix(&work, n, n + 1);
+    Bf = arena_matrix(&work, n, 1);
+    Xf = arena_matrix(&work, n, 1);
+    perm = arena_ivector(&work, n);
+    Wd = (s >= BENCH_LAPACK) ? arena_dvector(&work, n * n) : NULL;
+    times = arena_dvector(&work, reps);
+    make_system(A, b, n, seed);
+
+    for (k = 0; k < warmups; k++) run_once(s, la, A, b, n, W, Bf, Xf, perm, Wd, x);
+    for (k = 0; k < reps; k++) {
+        times[k] = run_once(s, la, A, b, n, W, Bf, Xf, perm, Wd, x);
+        mean += times[k];
+    }
+    mean /= reps;
+    for (k = 0; k < reps; k++) var += (times[k] - mean) * (times[k] - mean);
+    qsort(times, (size_t)reps, sizeof(double), cmp_double);
+
+    r->solver = s;
+    r->n = n;
+    r->reps = reps;
+    r->median = (reps % 2) ? times[reps / 2] : 0.5 * (times[reps / 2 - 1] + times[reps / 2]);
+    r->min = times[0];
+    r->stddev = (reps > 1) ? sqrt(var / (reps - 1)) : 0.0;
+    r->gflops = (r->median > 0.0) ? 1.0e-9 * flop_count(s, (double)n) / r->median : 0.0;
+    r->gbytes = (r->median > 0.0) ? 1.0e-9 * byte_count(s, (double)n) / r->median : 0.0;
+    r->residual = (s == BENCH_GEMV) ? product_error(A, b, x, n) : residual(A, b, x, n);
+    arena_free(&work);
+}
+
+
+static void write_csv(FILE *fp, const BenchResult *res, int count, const char *backend) {
+    fprintf(fp, "solver,backend,n,reps,median_s,min_s,stddev_s,gflops,gbytes_per_s,residual\n");
+    for (int i = 0; i < count; i++) {
+        const BenchResult *r = &res[i];
+        fprintf(fp, "%s,%s,%ld,%d,%.9g,%.9g,%.9g,%.6g,%.6g,%.3e\n", solver_names[r->solver],
+                (r->solver >= BENCH_LAPACK) ? backend : "primitives", r->n, r->reps,
+                r->median, r->min, r->stddev, r->gflops, r->gbytes, r->residual);
+    }
+}
+
+static void write_json(FILE *fp, const BenchResult *res, int count, const char *backend) {
+    fprintf(fp, "[\n");
+    for (int i = 0; i < count; i++) {
+        const BenchResult *r = &res[i];
+        fprintf(fp, "  {\"solver\": \"%s\", \"backend\": \"%s\", \"n\": %ld, \"reps\": %d, "
+                    "\"median_s\": %.9g, \"min_s\": %.9g, \"stddev_s\": %.9g, "
+                    "\"gflops\": %.6g, \"gbytes_per_s\": %.6g, \"residual\": %.3e}%s\n",
+                solver_names[r->solver], (r->solver >= BENCH_LAPACK) ? backend : "primitives", r->n, r->reps,
+                r->median, r->min, r->stddev, r->gflops, r->gbytes, r->residual, (i + 1 < count) ? "," : "");
+    }
+    fprintf(fp, "]\n");
+}
+
+// "-" is stdout
+static int write_report(const char *path, int json, const BenchResult *res, int count, const char *backend) {
+    FILE *fp = (strcmp(path, "-") == 0) ? stdout : fopen(path, "w");
+
+    if (fp == NULL) {
+        fprintf(stderr, "Error: Could not open '%s' for the benchmark report.\n", path);
+        return -1;
+    }
+    if (json) write_json(fp, res, count, backend);
+    else write_csv(fp, res, count, backend);
+    if (fp != stdout) {
+        fclose(fp);
+        printf("Wrote %s report to %s.\n", json ? "JSON" : "CSV", path);
+    }
+    return 0;
+}
+
+
+int main(int argc, char *argv[]) {
+    long sizes[MAX_SWEEP] = { 64, 128, 256, 512, 1024 };
+    int nsizes = 5, warmups = 1, reps = 5, enabled[BENCH_COUNT] = { 1, 1, 1, 1, 1, 1 };
+    uint64_t seed = 42;
+    const char *csv_path = NULL, *json_path = NULL;
+    const la_backend *la = la_backend_select();
+    BenchResult *res;
+    int count = 0, k, s, status = 0;
+    char *list, *tok;
+
+    for (k = 1; k < argc; k++) {
+        if (strcmp(argv[k], "-n") == 0 && k + 1 < argc) {
+            list = argv[++k];
+            for (nsizes = 0, tok = strtok(list, ","); tok != NULL && nsizes < MAX_SWEEP; tok = strtok(NULL, ",")) {
+                if ((sizes[nsizes] = atol(tok)) > 0) nsizes++;
+            }
+        } else if (strcmp(argv[k], "-s") == 0 && k + 1 < argc) {
+            list = argv[++k];
+            for (s = 0; s < BENCH_COUNT; s++) enabled[s] = 0;
+            for (tok = strtok(list, ","); tok != NULL; tok = strtok(NULL, ",")) {
+                for (s = 0; s < BENCH_COUNT && strcmp(tok, solver_names[s]) != 0; s++) ;
+                if (s < BENCH_COUNT) enabled[s] = 1;
+                else fprintf(stderr, "Warning: Unknown solver '%s' ignored.\n", tok);
+            }
+        } else if (strcmp(argv[k], "-r") == 0 && k + 1 < argc) {
+            reps = atoi(argv[++k]);
+        } else if (strcmp(argv[k], "-w") == 0 && k + 1 < argc) {
+            warmups = atoi(argv[++k]);
+        } else if (strcmp(argv[k], "-seed") == 0 && k + 1 < argc) {
+            seed = strtoull(argv[++k], NULL, 10);
+        } else if (strcmp(argv[k], "-csv") == 0 && k + 1 < argc) {
+            csv_path = argv[++k];
+        } else if (strcmp(argv[k], "-json") == 0 && k + 1 < argc) {
+            json_path = argv[++k];
+        } else {
+            fprintf(stderr, "Usage: %s [-n <N1,N2,...>] [-s <solvers>] [-r <reps>] [-w <warmups>] [-seed <s>] [-csv <file>] [-json <file>]\n", argv[0]);
+            fprintf(stderr, "  -n : sizes to sweep (default 64,128,256,512,1024)\n");
+            fprintf(stderr, "  -s : any of gj,cholesky,lu,lapack-cholesky,task-cholesky,gemv (default: all)\n");
+            fprintf(stderr, "  -r, -w : timed repetitions (default 5) and warm-up runs (default 1)\n");
+            fprintf(stderr, "  -csv, -json : also write the results there, '-' for stdout\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (reps < 1) reps = 1;
+    if (warmups < 0) warmups = 0;
+    if (nsizes == 0) nrerror("No valid sizes to benchmark.");
+
+    res = malloc((size_t)nsizes * BENCH_COUNT * sizeof(BenchResult));
+    if (res == NULL) nrerror("allocation failure in bench");
+
+    printf("Backend for lapack-cholesky, gemv (and the task-cholesky solve): %s; %d warm-up run(s), %d repetition(s), seed %llu\n",
+           la->name, warmups, reps, (unsigned long long)seed);
+    printf("%-16s %6s %12s %12s %10s %9s %9s %10s\n", "solver", "N", "median [s]", "min [s]", "stddev", "GFLOP/s", "GB/s", "residual");
+    for (k = 0; k < nsizes; k++) {
+        for (s = 0; s < BENCH_COUNT; s++) {
+            if (!enabled[s]) continue;
+            BenchResult *r = &res[count++];
+            bench_one(r, (BenchSolver)s, la, sizes[k], warmups, reps, seed);
+            printf("%-16s %6ld %12.6f %12.6f %10.2e %9.3f %9.3f %10.2e\n", solver_names[s], r->n,
+                   r->median, r->min, r->stddev, r->gflops, r->gbytes, r->residual);
+            fflush(stdout);
+        }
+    }
+
+    if (csv_path != NULL && write_report(csv_path, 0, res, count, la->name) != 0) status = EXIT_FAILURE;
+    if (json_path != NULL && write_report(json_path, 1, res, count, la->name) != 0) status = EXIT_FAILURE;
+    free(res);
+    return status;
+}
@@ -0,0 +1,476 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <float.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "datfile.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_SCAN
+#include <immintrin.h>
+#endif
+
+#define DAT_CHUNK_BYTES (1L << 20)  // unit of parallel parsing
+#define DAT_MAX_THREADS 64
+#define DAT_TOKEN_MAX 128           // longest number handed to strtod()
+#define DAT_SYM_TOL 1.0e-6          // |A[i][j] - A[j][i]| allowed by datfile_read_sym(), as is_symmetric()
+#define SYM_EMPTY 0xFFFFFFFFu       // a packed slot neither A[i][j] nor A[j][i] has reached yet
+
+typedef uint32_t __attribute__((may_alias)) sym_word;
+
+
+// exact powers of ten: every double up to 1e22 is representable
+static const double pow10_tab[23] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static int is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static const char *next_line(const char *p, const char *end) {
+    const char *q = memchr(p, '\n', (size_t)(end - p));
+    return (q == NULL) ? end : q + 1;
+}
+
+// section headers such as "--- Matrix A (20x20) ---"
+static int is_header_line(const char *p, const char *e) {
+    while (p < e && (*p == ' ' || *p == '\t')) p++;
+    return e - p >= 3 && p[0] == '-' && p[1] == '-' && p[2] == '-';
+}
+
+
+/* number of whitespace separated tokens in [p, e) */
+
+static long count_tokens_scalar(const char *p, const char *e) {
+    long count = 0;
+    int prev = 1; // the line start counts as whitespace
+    for (; p < e; p++) {
+        int w = is_space(*p);
+        count += (!w && prev);
+        prev = w;
+    }
+    return count;
+}
+
+#ifdef HAVE_X86_SCAN
+// 32 bytes per step: a token starts where a non-space byte follows a space byte
+__attribute__((target("avx2,popcnt")))
+static long count_tokens_avx2(const char *p, const char *e) {
+    const __m256i sp = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i nl = _mm256_set1_epi8('\n');
+    uint32_t prev = 1;
+    long count = 0;
+
+    for (; p + 32 <= e; p += 32) {
+        __m256i c = _mm256_loadu_si256((const __m256i *)p);
+        __m256i ws = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(c, sp), _mm256_cmpeq_epi8(c, tab)),
+                                     _mm256_or_si256(_mm256_cmpeq_epi8(c, cr), _mm256_cmpeq_epi8(c, nl)));
+        uint32_t m = (uint32_t)_mm256_movemask_epi8(ws);
+        count += __builtin_popcount(~m & ((m << 1) | prev));
+        prev = m >> 31;
+    }
+    for (; p < e; p++) {
+        int w = is_space(*p);
+        count += (!w && prev);
+        prev = w;
+    }
+    return count;
+}
+#endif
+
+static long (*count_tokens)(const char *p, const char *e) = NULL;
+static pthread_once_t count_tokens_once = PTHREAD_ONCE_INIT; // the -s reader and the workers may all get here first
+
+static void count_tokens_init(void) {
+    count_tokens = count_tokens_scalar;
+#ifdef HAVE_X86_SCAN
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) count_tokens = count_tokens_avx2;
+#endif
+}
+
+static void select_count_tokens(void) {
+    pthread_once(&count_tokens_once, count_tokens_init);
+}
+
+
+/* Clinger's fast path: a decimal with at most 19 digits whose mantissa fits
+   in 53 bits and |exponent| <= 22 converts exactly with one double multiply
+   or divide. Returns the end of the number, or NULL when strtod() is needed. */
+static const char *decimal_fast(const char *p, const char *e, double *out) {
+    uint64_t mant = 0;
+    int exp10 = 0, neg = 0;
+    const char *start;
+    long ndigits;
+    double d;
+
+    if (p < e && (*p == '-' || *p == '+')) { neg = (*p == '-'); p++; }
+    for (start = p; p < e && (unsigned)(*p - '0') < 10; p++) mant = mant * 10 + (uint64_t)(*p - '0');
+    ndigits = p - start;
+    if (p < e && *p == '.') {
+        for (start = ++p; p < e && (unsigned)(*p - '0') < 10; p++) mant = mant * 10 + (uint64_t)(*p - '0');
+        exp10 = (int)(start - p);
+        ndigits += p - start;
+    }
+    // too many digits may have wrapped mant (leading zeros included, strtod() copes)
+    if (ndigits == 0 || ndigits > 19) return NULL;
+    if (p < e && (*p == 'e' || *p == 'E')) {
+        int eneg = 0, ev = 0;
+        p++;
+        if (p < e && (*p == '-' || *p == '+')) { eneg = (*p == '-'); p++; }
+        for (start = p; p < e && (unsigned)(*p - '0') < 10; p++) {
+            if (ev < 10000) ev = ev * 10 + (*p - '0');
+        }
+        if (p == start) return NULL;
+        exp10 += eneg ? -ev : ev;
+    }
+    if (mant > (1ULL << 53) || exp10 < -22 || exp10 > 22) return NULL;
+
+    d = (double)mant;
+    d = (exp10 < 0) ? d / pow10_tab[-exp10] : d * pow10_tab[exp10];
+    *out = neg ? -d : d;
+    return p;
+}
+
+// full conversion of the token at p; returns its end, or NULL if it is not a number
+static const char *decimal_slow(const char *p, const char *e, double *d, float *f) {
+    char tok[DAT_TOKEN_MAX];
+    char *stop;
+    const char *t;
+    size_t len;
+
+    for (t = p; t < e && !is_space(*t); t++) ;
+    len = (size_t)(t - p);
+    if (len >= sizeof(tok)) return NULL;
+    memcpy(tok, p, len);
+    tok[len] = '\0';
+    if (f != NULL) *f = strtof(tok, &stop);
+    else *d = strtod(tok, &stop);
+    return (stop == tok + len) ? t : NULL;
+}
+
+/* parse the number at p (p < e, not a space); returns the end of the token,
+   or NULL if the token is not a number. Also used by the .mtx reader. */
+const char *datfile_parse_double(const char *p, const char *e, double *d) {
+    const char *t = decimal_fast(p, e, d);
+    if (t != NULL && (t == e || is_space(*t))) return t;
+    return decimal_slow(p, e, d, NULL); // nan, inf, hex floats, long mantissas, junk
+}
+
+static const char *parse_float(const char *p, const char *e, float *f) {
+    const char *t;
+    double d;
+    uint64_t bits;
+
+    t = decimal_fast(p, e, &d);
+    if (t != NULL && (t == e || is_space(*t))) {
+        /* rounding the exact double to float is the correctly rounded float,
+           unless the double sits exactly halfway between two floats (the
+           decimal may not) or in the float subnormal range */
+        memcpy(&bits, &d, sizeof(bits));
+        if (d == 0.0 || (fabs(d) >= FLT_MIN && (bits & 0x1FFFFFFFULL) != 0x10000000ULL)) {
+            *f = (float)d;
+            return t;
+        }
+    }
+    return decimal_slow(p, e, NULL, f);
+}
+
+
+/* one slice of a system, always made of whole lines */
+typedef struct {
+    const char *begin, *end;
+    long first;             // index of the first number of this chunk in the A, B stream
+    const char *err;        // first token that did not parse
+    long asym_row, asym_col;    // datfile_read_sym(): a pair found unequal, row -1 if none
+    float asym_a, asym_b;       // A[row][col] and A[col][row]
+} dat_chunk;
+
+/* what one parser thread works on: chunks tid, tid + stride, ... */
+typedef struct {
+    const datfile *df;
+    dat_chunk *chunks;
+    int nchunks, tid, stride;
+    float **A, **B;         // float destination, or
+    double **dA, **dB;      // double destination
+    int packed;             // A is the packed lower triangle of datfile_read_sym()
+    int shared;             // more than one thread writes A
+} dat_worker;
+
+/* A[row][col] of a packed read, col != row. Both A[i][j] and A[j][i] land in
+   the lower slot; whichever comes second, in whatever thread, compares itself
+   with the first and leaves the lower one's value there. */
+static void sym_store(const dat_worker *w, dat_chunk *c, long row, long col, float v) {
+    sym_word *slot = (sym_word *)((col < row) ? &w->A[row][col] : &w->A[col][row]);
+    uint32_t bits, old;
+    float first;
+
+    memcpy(&bits, &v, sizeof(bits));
+    if (w->shared) old = __atomic_exchange_n(slot, bits, __ATOMIC_RELAXED);
+    else { old = *slot; *slot = bits; }
+    if (old == SYM_EMPTY) return;
+
+    // the second of the pair: nobody else writes this slot any more
+    memcpy(&first, &old, sizeof(first));
+    if (col > row) *slot = old;
+    if (!(fabsf(first - v) <= DAT_SYM_TOL) && c->asym_row < 0) {
+        c->asym_row = row;
+        c->asym_col = col;
+        c->asym_a = v;
+        c->asym_b = first;
+    }
+}
+
+static void parse_chunk(const dat_worker *w, dat_chunk *c) {
+    long n = w->df->n, m = w->df->m, n_a = n * n;
+    long row, col, width;
+    int in_b = (c->first >= n_a);
+    const char *p, *e, *q, *t;
+    float v;
+
+    // position of the first number: A is filled row by row, then B
+    width = in_b ? m : n;
+    row = (in_b ? c->first - n_a : c->first) / width;
+    col = (in_b ? c->first - n_a : c->first) % width;
+
+    for (p = c->begin; p < c->end; p = e) {
+        e = next_line(p, c->end);
+        if (is_header_line(p, e)) continue;
+        for (q = p; ; q = t) {
+            while (q < e && is_space(*q)) q++;
+            if (q == e) break;
+
+            if (w->packed && !in_b) {
+                t = parse_float(q, e, &v);
+                if (t != NULL && col == row) w->A[row][col] = v;
+                else if (t != NULL) sym_store(w, c, row, col, v);
+            }
+            else if (w->A != NULL) t = parse_float(q, e, in_b ? &w->B[row][col] : &w->A[row][col]);
+            else t = datfile_parse_double(q, e, in_b ? &w->dB[row][col] : &w->dA[row][col]);
+            if (t == NULL) { c->err = q; return; }
+
+            if (++col == width) {
+                col = 0;
+                if (++row == n && !in_b) { in_b = 1; row = 0; width = m; }
+            }
+        }
+    }
+}
+
+static void *parse_chunks(void *arg) {
+    dat_worker *w = arg;
+    for (int i = w->tid; i < w->nchunks; i += w->stride) parse_chunk(w, &w->chunks[i]);
+    return NULL;
+}
+
+static int dat_threads(int nchunks) {
+    const char *env = getenv("DAT_NUM_THREADS");
+    long nthreads;
+
+    if (nchunks < 2) return 1;
+    nthreads = (env != NULL) ? atol(env) : sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads < 1) nthreads = 1;
+    if (nthreads > nchunks) nthreads = nchunks;
+    if (nthreads > DAT_MAX_THREADS) nthreads = DAT_MAX_THREADS;
+    return (int)nthreads;
+}
+
+static long line_number(const datfile *df, const char *pos) {
+    long line = 1;
+    for (const char *p = df->map; p < pos; p++) line += (*p == '\n');
+    return line;
+}
+
+
+/* map a text .dat file and read the N M line of its first system.
+   Returns 0 on success, -1 (with a message on stderr) otherwise. */
+int datfile_open(const char *path, datfile *df) {
+    struct stat st;
+    const char *end;
+    int fd, k;
+
+    memset(df, 0, sizeof(*df));
+    if ((fd = open(path, O_RDONLY)) < 0) {
+        fprintf(stderr, "Error: Could not open matrix file '%s'.\n", path);
+        return -1;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        fprintf(stderr, "Error: Matrix file '%s' is empty.\n", path);
+        close(fd);
+        return -1;
+    }
+    df->size = (size_t)st.st_size;
+    df->map = mmap(NULL, df->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (df->map == MAP_FAILED) {
+        fprintf(stderr, "Error: mmap failed for '%s'.\n", path);
+        df->map = NULL;
+        return -1;
+    }
+    madvise(df->map, df->size, MADV_WILLNEED);
+    end = df->map + df->size;
+
+    // two free-form header lines, then the systems
+    df->pos = df->map;
+    for (k = 0; k < 2; k++) {
+        if (df->pos == end) {
+            fprintf(stderr, "Error: '%s' is too short for the two header lines.\n", path);
+            datfile_close(df);
+            return -1;
+        }
+        df->pos = next_line(df->pos, end);
+    }
+    if (datfile_next(df) != 1) {
+        fprintf(stderr, "Error: Could not read the dimensions (N M) from '%s'.\n", path);
+        datfile_close(df);
+        return -1;
+    }
+    return 0;
+}
+
+
+/* move to the N M line of the next system, skipping blank and "---" lines.
+   Returns 1 with n, m set, 0 at the end of the file, -1 on a malformed line. */
+int datfile_next(datfile *df) {
+    const char *end = df->map + df->size, *p, *e;
+    char line[64];
+    size_t len;
+
+    for (p = df->pos; p < end; p = e) {
+        e = next_line(p, end);
+        if (is_header_line(p, e) || count_tokens_scalar(p, e) == 0) continue;
+
+        len = (size_t)(e - p) < sizeof(line) - 1 ? (size_t)(e - p) : sizeof(line) - 1;
+        memcpy(line, p, len);
+        line[len] = '\0';
+        if (sscanf(line, "%d %d", &df->n, &df->m) != 2 || df->n <= 0 || df->m <= 0) {
+            fprintf(stderr, "Error: Expected the dimensions (N M) of a system on line %ld.\n", line_number(df, p));
+            return -1;
+        }
+        df->body = df->pos = e;
+        return 1;
+    }
+    df->pos = end;
+    return 0;
+}
+
+
+void datfile_close(datfile *df) {
+    if (df->map != NULL) munmap(df->map, df->size);
+    df->map = NULL;
+    df->body = df->pos = NULL;
+}
+
+
+/* read the N*N + N*M numbers after the N M line into A and B. One scan
+   finds where the system ends and cuts it into DAT_CHUNK_BYTES chunks with
+   the index of their first number; the chunks are then parsed in parallel
+   straight into their destination. */
+static int dat_read(datfile *df, float **A, float **B, double **dA, double **dB, int *symmetric) {
+    pthread_t tid[DAT_MAX_THREADS];
+    int started[DAT_MAX_THREADS];
+    dat_worker workers[DAT_MAX_THREADS];
+    const char *end = df->map + df->size, *p, *e;
+    long total = (long)df->n * df->n + (long)df->n * df->m, found = 0;
+    dat_chunk *chunks, *tmp;
+    int nchunks = 1, cap = 16, nthreads, t, i, status = 0;
+
+    select_count_tokens();
+    if ((chunks = malloc((size_t)cap * sizeof(dat_chunk))) == NULL) {
+        fprintf(stderr, "Error: Out of memory in the matrix file parser.\n");
+        return -1;
+    }
+    chunks[0] = (dat_chunk){ df->body, NULL, 0, NULL, -1, -1, 0.0f, 0.0f };
+    for (p = df->body; p < end && found < total; p = e) {
+        if (p - chunks[nchunks - 1].begin >= DAT_CHUNK_BYTES) {
+            if (nchunks == cap) {
+                if ((tmp = realloc(chunks, (size_t)(cap *= 2) * sizeof(dat_chunk))) == NULL) {
+                    fprintf(stderr, "Error: Out of memory in the matrix file parser.\n");
+                    free(chunks);
+                    return -1;
+                }
+                chunks = tmp;
+            }
+            chunks[nchunks - 1].end = p;
+            chunks[nchunks++] = (dat_chunk){ p, NULL, found, NULL, -1, -1, 0.0f, 0.0f };
+        }
+        e = next_line(p, end);
+        if (!is_header_line(p, e)) found += count_tokens(p, e);
+    }
+    chunks[nchunks - 1].end = p;
+    if (found != total) {
+        if (found < total) {
+            fprintf(stderr, "Error: Expected %ld numbers for A (%dx%d) and B (%dx%d), found %ld.\n",
+                    total, df->n, df->n, df->n, df->m, found);
+        } else {
+            fprintf(stderr, "Error: Line %ld runs past the end of the system's B (%dx%d).\n",
+                    line_number(df, p) - 1, df->n, df->m);
+        }
+        free(chunks);
+        return -1;
+    }
+
+    // worker 0 runs on the calling thread
+    nthreads = dat_threads(nchunks);
+    if (symmetric != NULL) { // off-diagonal slots start empty, see sym_store()
+        for (i = 1; i < df->n; i++) memset(A[i], 0xFF, (size_t)i * sizeof(float));
+    }
+    for (t = 0; t < nthreads; t++) {
+        workers[t] = (dat_worker){ df, chunks, nchunks, t, nthreads, A, B, dA, dB, symmetric != NULL, nthreads > 1 };
+    }
+    for (t = 1; t < nthreads; t++) {
+        started[t] = (pthread_create(&tid[t], NULL, parse_chunks, &workers[t]) == 0);
+        if (!started[t]) parse_chunks(&workers[t]);
+    }
+    parse_chunks(&workers[0]);
+    for (t = 1; t < nthreads; t++) {
+        if (started[t]) pthread_join(tid[t], NULL);
+    }
+
+    for (i = 0; i < nchunks; i++) {
+        if (chunks[i].err != NULL) {
+            fprintf(stderr, "Error: Invalid number on line %ld of the matrix file.\n",
+                    line_number(df, chunks[i].err));
+            status = -1;
+            break;
+        }
+    }
+    for (i = 0; symmetric != NULL && i < nchunks; i++) {
+        *symmetric = (chunks[i].asym_row < 0);
+        if (!*symmetric) {
+            fprintf(stderr, "Symmetry Check Failed: A[%ld][%ld] (%.4f) != A[%ld][%ld] (%.4f)\n",
+                    chunks[i].asym_row, chunks[i].asym_col, chunks[i].asym_a,
+                    chunks[i].asym_col, chunks[i].asym_row, chunks[i].asym_b);
+            break;
+        }
+    }
+    free(chunks);
+    df->pos = p; // the next system starts here
+    return status;
+}
+
+// A is N x N, B is N x M. Returns 0 on success, -1 (with a message on stderr) otherwise.
+int datfile_read(datfile *df, float **A, float **B) {
+    return dat_read(df, A, B, NULL, NULL, NULL);
+}
+
+int datfile_read_d(datfile *df, double **A, double **B) {
+    return dat_read(df, NULL, NULL, A, B, NULL);
+}
+
+/* symmetric ingest: only the lower triangle of A is kept, in L from
+   tri_matrix(), and *symmetric says whether every A[i][j] matched A[j][i]
+   within DAT_SYM_TOL, found while parsing rather than in a pass of its own */
+int datfile_read_sym(datfile *df, float **L, float **B, int *symmetric) {
+    return dat_read(df, L, B, NULL, NULL, symmetric);
+}
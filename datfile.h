@@ -0,0 +1,49 @@
+#ifndef DATFILE_H
+#define DATFILE_H
+
+#include <stddef.h>
+
+/* Fast reader for the text .dat format
+
+   line 1, line 2   free-form header lines
+   N M              dimensions of the first system
+   --- ... ---      section header (any line starting with "---" is skipped)
+   A                N x N numbers
+   --- ... ---
+   B                N x M numbers
+   N M              further systems, each laid out as above
+   ...
+
+   The file is mmap'd and the numbers after an N M line are read as one
+   stream of N*N + N*M numbers, so the layout of numbers over lines does not
+   matter. Large systems are split at line boundaries and parsed by several
+   threads (DAT_NUM_THREADS, default: all online CPUs).
+
+   datfile_open() leaves n, m set for the first system; after each
+   datfile_read*(), datfile_next() moves on to the following one.
+   datfile_read_sym() is the symmetric ingest: A goes into a packed lower
+   triangle (tri_matrix()) and is checked for symmetry as it is parsed. */
+
+typedef struct {
+    char *map;          // the whole file, read-only
+    size_t size;
+    const char *body;   // first byte after the current N M line
+    const char *pos;    // where the next datfile_next() starts looking
+    int n, m;
+} datfile;
+
+int datfile_open(const char *path, datfile *df);
+
+int datfile_next(datfile *df);
+
+int datfile_read(datfile *df, float **A, float **B);
+
+int datfile_read_d(datfile *df, double **A, double **B);
+
+int datfile_read_sym(datfile *df, float **L, float **B, int *symmetric);
+
+void datfile_close(datfile *df);
+
+const char *datfile_parse_double(const char *p, const char *e, double *d);
+
+#endif
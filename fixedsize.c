@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "fixedsize.h"
+
+// a statement-level pragma from inside a macro
+#define UNROLL _Pragma("GCC unroll 32")
+
+// padded length of a Gauss-Jordan row of N + 1 columns
+#define ROW(N) (((N) + 8) / 8 * 8)
+
+
+/* Gauss-Jordan with partial pivoting on [A | B], N x (N + m), m <= ROW(N) - N.
+   Every row op runs over the whole padded row: left of the pivot column the
+   pivot row is already zero, so the extra multiply-adds change nothing, and
+   the constant length lets them unroll into whole vectors. The pivot
+   column ends up exactly 1 and 0 (p / p and a - a * 1). As in
+   gauss_jordan_multi_info(), the pivot is tested in double against 1e-12
+   and the row ops run in float, so both fail on the same pivots. */
+#define GJ_FIXED(N)                                                                     \
+__attribute__((target_clones("avx2", "default")))                                       \
+static int gj_##N(float **A, int m) {                                                   \
+    float a[N][ROW(N)], t, f, best;                                                     \
+    int i, j, k, r, info = 0;                                                           \
+                                                                                        \
+    for (i = 0; i < N; i++) {                                                           \
+        UNROLL for (j = 0; j < ROW(N); j++) a[i][j] = (j < N + m) ? A[i][j] : 0.0f;     \
+    }                                                                                   \
+    for (i = 0; i < N; i++) {                                                           \
+        r = i;                                                                          \
+        best = fabsf(a[i][i]);                                                          \
+        UNROLL for (k = 0; k < N; k++) {                                                \
+            if (k > i && fabsf(a[k][i]) > best) { best = fabsf(a[k][i]); r = k; }       \
+        }                                                                               \
+        if ((double)best < 1e-12) { info = i + 1; break; }                              \
+        if (r != i) {                                                                   \
+            UNROLL for (j = 0; j < ROW(N); j++) { t = a[i][j]; a[i][j] = a[r][j]; a[r][j] = t; } \
+        }                                                                               \
+        f = a[i][i];                                                                    \
+        UNROLL for (j = 0; j < ROW(N); j++) a[i][j] /= f;                               \
+        for (k = 0; k < N; k++) {                                                       \
+            if (k == i) continue;                                                       \
+            f = a[k][i];                                                                \
+            UNROLL for (j = 0; j < ROW(N); j++) a[k][j] -= f * a[i][j];                 \
+        }                                                                               \
+    }                                                                                   \
+    for (i = 0; i < N; i++) {                                                           \
+        for (j = 0; j < N + m; j++) A[i][j] = a[i][j];                                  \
+    }                                                                                   \
+    return info;                                                                        \
+}
+
+/* Cholesky in the order of cholesky_packed(), completely unrolled: every
+   index is a constant, so the factor lives in registers as far as they go.
+   On failure the rows done so far are stored, as the general loop leaves them. */
+#define CHOLESKY_FIXED(N)                                                               \
+static int cholesky_##N(float **A) {                                                    \
+    float l[N][N], sum;                                                                 \
+    int i, j, k, info = 0;                                                              \
+                                                                                        \
+    UNROLL for (i = 0; i < N; i++) {                                                    \
+        UNROLL for (j = 0; j <= i; j++) l[i][j] = A[i][j];                              \
+    }                                                                                   \
+    UNROLL for (i = 0; i < N; i++) {                                                    \
+        UNROLL for (j = 0; j <= i; j++) {                                               \
+            sum = l[i][j];                                                              \
+            UNROLL for (k = 0; k < j; k++) sum -= l[i][k] * l[j][k];                    \
+            if (i == j) {                                                               \
+                if (sum <= 0.0f) { info = i + 1; break; }                               \
+                l[i][i] = sqrtf(sum);                                                   \
+            } else {                                                                    \
+                l[i][j] = sum / l[j][j];                                                \
+            }                                                                           \
+        }                                                                               \
+        if (info) break;                                                                \
+    }                                                                                   \
+    UNROLL for (i = 0; i < N; i++) {                                                    \
+        UNROLL for (j = 0; j <= i; j++) A[i][j] = l[i][j];                              \
+    }                                                                                   \
+    return info;                                                                        \
+}
+
+// forward and back substitution of cholesky_solve(), unrolled, in place on y
+#define CHOLESKY_SOLVE_FIXED(N)                                                         \
+static void cholesky_solve_##N(float **L, float *y) {                                   \
+    float x[N], sum;                                                                    \
+    int i, j;                                                                           \
+                                                                                        \
+    UNROLL for (i = 0; i < N; i++) {                                                    \
+        const float *li = L[i];                                                         \
+        sum = y[i];                                                                     \
+        UNROLL for (j = 0; j < i; j++) sum -= li[j] * x[j];                             \
+        x[i] = sum / li[i];                                                             \
+    }                                                                                   \
+    UNROLL for (i = N - 1; i >= 0; i--) {                                               \
+        sum = x[i];                                                                     \
+        UNROLL for (j = i + 1; j < N; j++) sum -= L[j][i] * x[j];                       \
+        x[i] = sum / L[i][i];                                                           \
+    }                                                                                   \
+    UNROLL for (i = 0; i < N; i++) y[i] = x[i];                                         \
+}
+
+#define FIXED_SIZE(N) GJ_FIXED(N) CHOLESKY_FIXED(N) CHOLESKY_SOLVE_FIXED(N)
+#define FIXED_ENTRY(N) [N] = { N, ROW(N) - N, gj_##N, cholesky_##N, cholesky_solve_##N },
+
+// every size that gets a kernel
+#define FIXED_SIZES(X) X(2) X(3) X(4) X(5) X(6) X(7) X(8) X(9) X(10) X(11) \
+                       X(12) X(13) X(14) X(15) X(16) X(17) X(18) X(19) X(20) // up to FIXED_KERNEL_MAX
+
+FIXED_SIZES(FIXED_SIZE)
+
+static const fixed_kernels fixed_table[] = { FIXED_SIZES(FIXED_ENTRY) };
+
+
+// the kernels for N, or NULL when N has none
+const fixed_kernels *fixed_kernels_for(int n) {
+    if (n < 2 || n > FIXED_MAX_N || n > FIXED_KERNEL_MAX) return NULL;
+    return &fixed_table[n];
+}
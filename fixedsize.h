@@ -0,0 +1,34 @@
+#ifndef FIXEDSIZE_H
+#define FIXEDSIZE_H
+
+/* kernels specialized for one N each, 2 <= N <= FIXED_MAX_N, which
+   gauss_jordan_multi(), cholesky_packed(), cholesky_solve() and
+   cholesky_solve_multi() dispatch to through fixed_kernels_for(n).
+
+   Every size is its own function with N a compile-time constant: the
+   matrix is copied into a local array (the solve reads L in place), the
+   loops have constant trip counts and are unrolled, and nothing goes
+   through float** or checks bounds until the result is copied back.
+   Gauss-Jordan rows are padded to a multiple of 8 floats, so each row
+   operation is a fixed number of full vectors; the padding also takes the
+   right-hand sides, up to max_m of them. */
+
+// sizes with a kernel
+#define FIXED_KERNEL_MAX 20
+
+// largest N dispatched to them; -DFIXED_MAX_N=0 turns them off
+#ifndef FIXED_MAX_N
+#define FIXED_MAX_N FIXED_KERNEL_MAX
+#endif
+
+typedef struct {
+    int n;
+    int max_m;                                  // right-hand sides gj() takes
+    int  (*gj)(float **A, int m);               // as gauss_jordan_multi(), returns 0 or k+1 for a pivot below 1e-12
+    int  (*cholesky)(float **A);                // as cholesky_packed(), lower triangle only
+    void (*cholesky_solve)(float **L, float *y); // y = A^-1 y with the factor from cholesky()
+} fixed_kernels;
+
+const fixed_kernels *fixed_kernels_for(int n);
+
+#endif
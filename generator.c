@@ -0,0 +1,280 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "generator.h"
+
+#define GEN_MAX_THREADS 64
+#define GEN_ROW_BLOCK 16    // rows a thread fills before moving on by the thread count
+
+// independent random streams of one seed
+enum { STREAM_A = 1, STREAM_B, STREAM_U, STREAM_V };
+
+static const char *kind_names[] = { "trefethen", "spd", "diagdom", "general" };
+
+// everything the rows are computed from, shared by the fill threads
+typedef struct {
+    const gen_spec *g;
+    float **A, **B;         // one of the float or the double pair is set
+    double **dA, **dB;
+    int *primes;            // trefethen: the first n primes
+    double *d, *u, *v, *p;  // spd and general, see setup_reflections()
+    double alpha, beta, gamma;
+    int lower;              // A is a packed lower triangle, see gen_fill_lower()
+} gen_ctx;
+
+typedef struct {
+    gen_ctx *ctx;
+    long first, stride;     // in blocks of GEN_ROW_BLOCK rows
+} gen_worker;
+
+
+// uniform in [-1, 1), a hash of its coordinates: splitmix64's finalizer
+static double gen_uniform(unsigned long long seed, int stream, long i, long j) {
+    uint64_t x = seed * 0x9E3779B97F4A7C15ULL + (uint64_t)stream * 0xD1B54A32D192ED03ULL
+               + (uint64_t)i * 0xAEF17502108EF2D9ULL + (uint64_t)j;
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return (double)(x >> 11) * (2.0 / 9007199254740992.0) - 1.0;
+}
+
+// the first n primes from a sieve; the bound on the n-th prime holds for n >= 6
+static int *first_primes(long n) {
+    long limit = (n < 6) ? 15 : (long)(n * (log((double)n) + log(log((double)n)))) + 1, i, j, k = 0;
+    char *composite = calloc((size_t)limit + 1, 1);
+    int *primes = malloc((size_t)n * sizeof(int));
+
+    if (composite == NULL || primes == NULL) {
+        free(composite);
+        free(primes);
+        return NULL;
+    }
+    for (i = 2; i <= limit && k < n; i++) {
+        if (composite[i]) continue;
+        primes[k++] = (int)i;
+        for (j = i * i; j <= limit; j += i) composite[j] = 1;
+    }
+    free(composite);
+    return primes;
+}
+
+static void unit_vector(double *x, long n, unsigned long long seed, int stream) {
+    double norm = 0.0;
+    long i;
+
+    for (i = 0; i < n; i++) { x[i] = gen_uniform(seed, stream, i, 0); norm += x[i] * x[i]; }
+    norm = sqrt(norm);
+    for (i = 0; i < n; i++) x[i] = (norm > 0.0) ? x[i] / norm : (i == 0);
+}
+
+/* the O(n) part of the spd and general matrices, with H_u = I - 2uu^T:
+     spd      A = H_v M H_v, M = H_u D H_u, p = M v, alpha = u^T D u, beta = v^T p
+     general  A = H_u S H_v, gamma = u^T S v
+   d holds the eigenvalues (spd) or singular values (general), 1 down to 1/cond */
+static void setup_reflections(gen_ctx *c) {
+    const gen_spec *g = c->g;
+    long n = g->n, i;
+    double s = 0.0, uv = 0.0;
+
+    for (i = 0; i < n; i++) c->d[i] = (n > 1) ? pow(g->cond, -(double)i / (double)(n - 1)) : 1.0;
+    unit_vector(c->u, n, g->seed, STREAM_U);
+    unit_vector(c->v, n, g->seed, STREAM_V);
+    c->alpha = c->beta = c->gamma = 0.0;
+    for (i = 0; i < n; i++) {
+        c->alpha += c->u[i] * c->d[i] * c->u[i];
+        s += c->u[i] * c->d[i] * c->v[i];
+        uv += c->u[i] * c->v[i];
+    }
+    c->gamma = s;
+    if (g->kind != GEN_SPD) return;
+    for (i = 0; i < n; i++) {
+        c->p[i] = c->d[i] * c->v[i] - 2.0 * s * c->u[i] - 2.0 * uv * c->d[i] * c->u[i] + 4.0 * c->alpha * uv * c->u[i];
+        c->beta += c->v[i] * c->p[i];
+    }
+}
+
+
+static void fill_row(const gen_ctx *c, long i) {
+    const gen_spec *g = c->g;
+    const double *d = c->d, *u = c->u, *v = c->v, *p = c->p;
+    long n = g->n, j, off;
+    long last = c->lower ? i + 1 : n; // columns of row i that are stored
+    double a, sum = 0.0;
+
+    for (j = 0; j < last; j++) {
+        switch (g->kind) {
+        case GEN_TREFETHEN:
+            off = (i > j) ? i - j : j - i;
+            a = (off == 0) ? c->primes[i] : ((off & (off - 1)) == 0);
+            break;
+        case GEN_SPD:
+            a = (i == j) ? d[i] : 0.0;
+            a += -2.0 * u[i] * u[j] * (d[i] + d[j]) + 4.0 * c->alpha * u[i] * u[j];
+            a += -2.0 * v[i] * p[j] - 2.0 * p[i] * v[j] + 4.0 * c->beta * v[i] * v[j];
+            break;
+        case GEN_DIAGDOM: // the diagonal is written after the row sum is known
+            a = (i == j) ? 0.0 : gen_uniform(g->seed, STREAM_A, i, j);
+            sum += fabs(a);
+            break;
+        default:
+            a = (i == j) ? d[i] : 0.0;
+            a += -2.0 * u[i] * u[j] * d[j] - 2.0 * d[i] * v[i] * v[j] + 4.0 * c->gamma * u[i] * v[j];
+            break;
+        }
+        if (c->dA != NULL) c->dA[i][j] = a;
+        else c->A[i][j] = (float)a;
+    }
+    if (g->kind == GEN_DIAGDOM) {
+        if (c->dA != NULL) c->dA[i][i] = sum + 1.0;
+        else c->A[i][i] = (float)(sum + 1.0);
+    }
+
+    for (j = 0; j < g->m; j++) {
+        a = (g->kind == GEN_TREFETHEN) ? 1.0 : gen_uniform(g->seed, STREAM_B, i, j);
+        if (c->dB != NULL) c->dB[i][j] = a;
+        else c->B[i][j] = (float)a;
+    }
+}
+
+static void *fill_rows(void *arg) {
+    gen_worker *w = arg;
+    long n = w->ctx->g->n, blk, i;
+
+    for (blk = w->first * GEN_ROW_BLOCK; blk < n; blk += w->stride * GEN_ROW_BLOCK) {
+        for (i = blk; i < blk + GEN_ROW_BLOCK && i < n; i++) fill_row(w->ctx, i);
+    }
+    return NULL;
+}
+
+static int gen_threads(long n) {
+    const char *env = getenv("GEN_NUM_THREADS");
+    long nthreads = (env != NULL) ? atol(env) : sysconf(_SC_NPROCESSORS_ONLN);
+    long nblocks = (n + GEN_ROW_BLOCK - 1) / GEN_ROW_BLOCK;
+
+    if (nthreads < 1) nthreads = 1;
+    if (nthreads > nblocks) nthreads = nblocks;
+    if (nthreads > GEN_MAX_THREADS) nthreads = GEN_MAX_THREADS;
+    return (int)nthreads;
+}
+
+
+static int gen_run(const gen_spec *g, float **A, float **B, double **dA, double **dB, int lower) {
+    pthread_t tid[GEN_MAX_THREADS];
+    int started[GEN_MAX_THREADS];
+    gen_worker workers[GEN_MAX_THREADS];
+    gen_ctx ctx = { g, A, B, dA, dB, NULL, NULL, NULL, NULL, NULL, 0.0, 0.0, 0.0, lower };
+    double *vecs = NULL;
+    int nthreads, t, status = 0;
+
+    if (g->kind == GEN_TREFETHEN) {
+        if ((ctx.primes = first_primes(g->n)) == NULL) status = -1;
+    } else if (g->kind != GEN_DIAGDOM) {
+        if ((vecs = malloc(4 * (size_t)g->n * sizeof(double))) == NULL) status = -1;
+        else {
+            ctx.d = vecs;
+            ctx.u = vecs + g->n;
+            ctx.v = vecs + 2 * g->n;
+            ctx.p = vecs + 3 * g->n;
+            setup_reflections(&ctx);
+        }
+    }
+    if (status != 0) {
+        fprintf(stderr, "Error: Out of memory generating the %s system.\n", g->name);
+        return -1;
+    }
+
+    // worker 0 runs on the calling thread
+    nthreads = gen_threads(g->n);
+    for (t = 0; t < nthreads; t++) workers[t] = (gen_worker){ &ctx, t, nthreads };
+    for (t = 1; t < nthreads; t++) {
+        started[t] = (pthread_create(&tid[t], NULL, fill_rows, &workers[t]) == 0);
+        if (!started[t]) fill_rows(&workers[t]);
+    }
+    fill_rows(&workers[0]);
+    for (t = 1; t < nthreads; t++) {
+        if (started[t]) pthread_join(tid[t], NULL);
+    }
+
+    free(ctx.primes);
+    free(vecs);
+    return 0;
+}
+
+int gen_fill(const gen_spec *g, float **A, float **B) {
+    return gen_run(g, A, B, NULL, NULL, 0);
+}
+
+int gen_fill_d(const gen_spec *g, double **A, double **B) {
+    return gen_run(g, NULL, NULL, A, B, 0);
+}
+
+/* only the lower triangle of A, into L from tri_matrix(); the symmetric kinds
+   (trefethen, spd) only. Returns 0, or -1 with a message on stderr. */
+int gen_fill_lower(const gen_spec *g, float **L, float **B) {
+    if (g->kind != GEN_TREFETHEN && g->kind != GEN_SPD) {
+        fprintf(stderr, "Error: %s is not symmetric, it cannot be generated as a lower triangle.\n", g->name);
+        return -1;
+    }
+    return gen_run(g, L, B, NULL, NULL, 1);
+}
+
+
+/* <kind>:<N>[,m=<M>][,cond=<c>][,seed=<s>], see generator.h.
+   Returns 0, or -1 with a message on stderr. */
+int gen_parse(const char *text, gen_spec *g) {
+    const char *colon = strchr(text, ':'), *p;
+    char *end;
+    size_t len;
+    int k;
+
+    memset(g, 0, sizeof(*g));
+    g->m = 1;
+    g->cond = 1.0e3;
+    g->seed = 1;
+
+    len = (colon != NULL) ? (size_t)(colon - text) : 0;
+    for (k = 0; k < 4; k++) {
+        if (strlen(kind_names[k]) == len && strncmp(text, kind_names[k], len) == 0) break;
+    }
+    if (k == 4) {
+        fprintf(stderr, "Error: Generator spec '%s' should start with trefethen:, spd:, diagdom: or general:.\n", text);
+        return -1;
+    }
+    g->kind = (gen_kind)k;
+
+    g->n = strtol(colon + 1, &end, 10);
+    for (p = end; *p == ','; p = end) {
+        p++;
+        if (strncmp(p, "m=", 2) == 0) g->m = strtol(p += 2, &end, 10);
+        else if (strncmp(p, "cond=", 5) == 0) g->cond = strtod(p += 5, &end);
+        else if (strncmp(p, "seed=", 5) == 0) g->seed = strtoull(p += 5, &end, 10);
+        else break;
+        if (end == p) break; // option without a number
+    }
+    if (*p != '\0') {
+        fprintf(stderr, "Error: Cannot read generator spec '%s' at '%s'.\n", text, p);
+        return -1;
+    }
+    if (g->n <= 0 || g->n > INT_MAX || g->m <= 0 || g->m > INT_MAX) {
+        fprintf(stderr, "Error: Generator spec '%s' needs N >= 1 and M >= 1.\n", text);
+        return -1;
+    }
+    if (!(g->cond >= 1.0) || isinf(g->cond)) {
+        fprintf(stderr, "Error: Condition number in '%s' must be finite and at least 1.\n", text);
+        return -1;
+    }
+
+    if (g->kind == GEN_SPD || g->kind == GEN_GENERAL) {
+        snprintf(g->name, sizeof(g->name), "%s_%ld_cond%g_seed%llu", kind_names[k], g->n, g->cond, g->seed);
+    } else {
+        snprintf(g->name, sizeof(g->name), "%s_%ld_seed%llu", kind_names[k], g->n, g->seed);
+    }
+    return 0;
+}
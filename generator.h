@@ -0,0 +1,40 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+/* Test systems built in memory instead of read from a file.
+
+   <kind>:<N>[,m=<M>][,cond=<c>][,seed=<s>]
+
+   trefethen   the i-th prime on the diagonal, 1 where |i - j| is a power of
+               two; B = ones, like trefethen_dense.dat
+   spd         Q^T D Q, eigenvalues spaced geometrically from 1 down to 1/cond
+   diagdom     nonsymmetric, entries in [-1, 1], each diagonal entry 1 more
+               than the rest of its row
+   general     U S V^T, nonsymmetric with 2-norm condition number cond
+
+   Q, U and V are products of two Householder reflections, so every entry is
+   a closed-form expression of a few vectors and the eigen/singular values
+   are exact. Random numbers are a hash of (seed, row, column): the system
+   only depends on the spec, not on the number of threads filling it
+   (GEN_NUM_THREADS, default: all online CPUs). B is random in [-1, 1]
+   except for trefethen. Defaults: M = 1, cond = 1e3, seed = 1. */
+
+typedef enum { GEN_TREFETHEN, GEN_SPD, GEN_DIAGDOM, GEN_GENERAL } gen_kind;
+
+typedef struct {
+    gen_kind kind;
+    long n, m;
+    double cond;                // spd and general only
+    unsigned long long seed;
+    char name[64];              // e.g. "spd_1000_seed1", for naming output files
+} gen_spec;
+
+int gen_parse(const char *text, gen_spec *g);
+
+int gen_fill(const gen_spec *g, float **A, float **B);
+
+int gen_fill_d(const gen_spec *g, double **A, double **B);
+
+int gen_fill_lower(const gen_spec *g, float **L, float **B);
+
+#endif
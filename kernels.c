@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "kernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+
+// scalar fallback, the loops gauss_jordan_partial() always used
+
+static void row_axpy_scalar(float *y, const float *x, float a, int n) {
+    for (int j = 0; j < n; j++) y[j] -= a * x[j];
+}
+
+static void row_div_scalar(float *x, float d, int n) {
+    for (int j = 0; j < n; j++) x[j] /= d;
+}
+
+static int col_argmax_scalar(float **A, int col, int lo, int hi) {
+    int max_row = lo;
+    for (int k = lo + 1; k < hi; k++) {
+        if (fabs(A[k][col]) > fabs(A[max_row][col])) max_row = k;
+    }
+    return max_row;
+}
+
+
+#ifdef HAVE_X86_KERNELS
+
+/* pick the first row holding the largest value out of per-lane candidates,
+   then finish the tail with scalar compares (strict '>' keeps the first hit) */
+static int argmax_finish(const float *best, const int *idx, int lanes, float **A, int col, int k, int hi) {
+    int max_row = idx[0];
+    float max_val = best[0];
+    for (int l = 1; l < lanes; l++) {
+        if (best[l] > max_val || (best[l] == max_val && idx[l] < max_row)) {
+            max_val = best[l];
+            max_row = idx[l];
+        }
+    }
+    for (; k < hi; k++) {
+        if (fabsf(A[k][col]) > max_val) {
+            max_val = fabsf(A[k][col]);
+            max_row = k;
+        }
+    }
+    return max_row;
+}
+
+
+// AVX2 + FMA: 8 floats per row op, 4 rows per gather in the pivot search
+
+__attribute__((target("avx2,fma")))
+static void row_axpy_avx2(float *y, const float *x, float a, int n) {
+    __m256 va = _mm256_set1_ps(a);
+    int j = 0;
+    for (; j + 8 <= n; j += 8) {
+        __m256 vy = _mm256_loadu_ps(y + j);
+        _mm256_storeu_ps(y + j, _mm256_fnmadd_ps(va, _mm256_loadu_ps(x + j), vy));
+    }
+    for (; j < n; j++) y[j] -= a * x[j];
+}
+
+__attribute__((target("avx2,fma")))
+static void row_div_avx2(float *x, float d, int n) {
+    __m256 vd = _mm256_set1_ps(d);
+    int j = 0;
+    for (; j + 8 <= n; j += 8) _mm256_storeu_ps(x + j, _mm256_div_ps(_mm256_loadu_ps(x + j), vd));
+    for (; j < n; j++) x[j] /= d;
+}
+
+__attribute__((target("avx2,fma")))
+static int col_argmax_avx2(float **A, int col, int lo, int hi) {
+    // gather |A[k][col]| through the row pointers: the indices are absolute addresses
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m256i offset = _mm256_set1_epi64x((long long)col * (long long)sizeof(float));
+    __m128 best = _mm_set1_ps(-1.0f);
+    __m128i idx = _mm_set1_epi32(lo);
+    __m128i cur = _mm_setr_epi32(lo, lo + 1, lo + 2, lo + 3);
+    const __m128i step = _mm_set1_epi32(4);
+    float best_l[4];
+    int idx_l[4];
+    int k = lo;
+
+    if (hi - lo < 8) return col_argmax_scalar(A, col, lo, hi);
+
+    for (; k + 4 <= hi; k += 4) {
+        __m256i addr = _mm256_add_epi64(_mm256_loadu_si256((const __m256i *)(A + k)), offset);
+        __m128 v = _mm_and_ps(_mm256_i64gather_ps((const float *)0, addr, 1), abs_mask);
+        __m128 gt = _mm_cmp_ps(v, best, _CMP_GT_OQ);
+        best = _mm_blendv_ps(best, v, gt);
+        idx = _mm_blendv_epi8(idx, cur, _mm_castps_si128(gt));
+        cur = _mm_add_epi32(cur, step);
+    }
+    _mm_storeu_ps(best_l, best);
+    _mm_storeu_si128((__m128i *)idx_l, idx);
+    return argmax_finish(best_l, idx_l, 4, A, col, k, hi);
+}
+
+
+// AVX-512: 16 floats per row op with masked tails, 8 rows per gather
+
+__attribute__((target("avx512f,avx2,fma")))
+static void row_axpy_avx512(float *y, const float *x, float a, int n) {
+    __m512 va = _mm512_set1_ps(a);
+    int j = 0;
+    for (; j + 16 <= n; j += 16) {
+        __m512 vy = _mm512_loadu_ps(y + j);
+        _mm512_storeu_ps(y + j, _mm512_fnmadd_ps(va, _mm512_loadu_ps(x + j), vy));
+    }
+    if (j < n) {
+        __mmask16 m = (__mmask16)((1u << (n - j)) - 1);
+        __m512 vy = _mm512_maskz_loadu_ps(m, y + j);
+        _mm512_mask_storeu_ps(y + j, m, _mm512_fnmadd_ps(va, _mm512_maskz_loadu_ps(m, x + j), vy));
+    }
+}
+
+__attribute__((target("avx512f,avx2,fma")))
+static void row_div_avx512(float *x, float d, int n) {
+    __m512 vd = _mm512_set1_ps(d);
+    int j = 0;
+    for (; j + 16 <= n; j += 16) _mm512_storeu_ps(x + j, _mm512_div_ps(_mm512_loadu_ps(x + j), vd));
+    if (j < n) {
+        __mmask16 m = (__mmask16)((1u << (n - j)) - 1);
+        // masked-off lanes divide 1/d so no spurious FP exceptions are raised
+        __m512 vx = _mm512_mask_loadu_ps(_mm512_set1_ps(1.0f), m, x + j);
+        _mm512_mask_storeu_ps(x + j, m, _mm512_div_ps(vx, vd));
+    }
+}
+
+__attribute__((target("avx512f,avx2,fma")))
+static int col_argmax_avx512(float **A, int col, int lo, int hi) {
+    const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    const __m512i offset = _mm512_set1_epi64((long long)col * (long long)sizeof(float));
+    __m256 best = _mm256_set1_ps(-1.0f);
+    __m256i idx = _mm256_set1_epi32(lo);
+    __m256i cur = _mm256_setr_epi32(lo, lo + 1, lo + 2, lo + 3, lo + 4, lo + 5, lo + 6, lo + 7);
+    const __m256i step = _mm256_set1_epi32(8);
+    float best_l[8];
+    int idx_l[8];
+    int k = lo;
+
+    if (hi - lo < 16) return col_argmax_scalar(A, col, lo, hi);
+
+    for (; k + 8 <= hi; k += 8) {
+        __m512i addr = _mm512_add_epi64(_mm512_loadu_si512((const void *)(A + k)), offset);
+        __m256 v = _mm256_and_ps(_mm512_i64gather_ps(addr, (const float *)0, 1), abs_mask);
+        __m256 gt = _mm256_cmp_ps(v, best, _CMP_GT_OQ);
+        best = _mm256_blendv_ps(best, v, gt);
+        idx = _mm256_blendv_epi8(idx, cur, _mm256_castps_si256(gt));
+        cur = _mm256_add_epi32(cur, step);
+    }
+    _mm256_storeu_ps(best_l, best);
+    _mm256_storeu_si256((__m256i *)idx_l, idx);
+    return argmax_finish(best_l, idx_l, 8, A, col, k, hi);
+}
+
+#endif /* HAVE_X86_KERNELS */
+
+
+static const gj_kernels kernels_scalar = { "scalar", row_axpy_scalar, row_div_scalar, col_argmax_scalar };
+#ifdef HAVE_X86_KERNELS
+static const gj_kernels kernels_avx2 = { "avx2", row_axpy_avx2, row_div_avx2, col_argmax_avx2 };
+static const gj_kernels kernels_avx512 = { "avx512", row_axpy_avx512, row_div_avx512, col_argmax_avx512 };
+#endif
+
+static const gj_kernels *selected = NULL;
+static pthread_once_t selected_once = PTHREAD_ONCE_INIT; // the stream workers may all get here first
+
+
+static void kernels_init(void) {
+    const char *env;
+
+    selected = &kernels_scalar;
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    int has_avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    int has_avx512 = has_avx2 && __builtin_cpu_supports("avx512f");
+
+    if (has_avx512) selected = &kernels_avx512;
+    else if (has_avx2) selected = &kernels_avx2;
+
+    // allow forcing a narrower kernel, e.g. to compare against the scalar path
+    env = getenv("GJ_KERNEL");
+    if (env != NULL) {
+        if (strcmp(env, "scalar") == 0) selected = &kernels_scalar;
+        else if (strcmp(env, "avx2") == 0 && has_avx2) selected = &kernels_avx2;
+        else if (strcmp(env, "avx512") == 0 && has_avx512) selected = &kernels_avx512;
+        else fprintf(stderr, "Warning: GJ_KERNEL=%s not available, using %s.\n", env, selected->name);
+    }
+#else
+    env = getenv("GJ_KERNEL");
+    if (env != NULL && strcmp(env, "scalar") != 0) {
+        fprintf(stderr, "Warning: GJ_KERNEL=%s not available, using scalar.\n", env);
+    }
+#endif
+}
+
+const gj_kernels *gj_kernels_select(void) {
+    pthread_once(&selected_once, kernels_init);
+    return selected;
+}
@@ -0,0 +1,17 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+/* row kernels used by the elimination loops in primitives.c.
+   One table per instruction set; gj_kernels_select() picks the widest one the
+   CPU supports at runtime, or the one named by the GJ_KERNEL environment
+   variable (scalar, avx2, avx512). */
+typedef struct {
+    const char *name;
+    void (*row_axpy)(float *y, const float *x, float a, int n); // y[j] -= a * x[j]
+    void (*row_div)(float *x, float d, int n);                  // x[j] /= d
+    int  (*col_argmax)(float **A, int col, int lo, int hi);     // argmax |A[k][col]|, lo <= k < hi
+} gj_kernels;
+
+const gj_kernels *gj_kernels_select(void);
+
+#endif
@@ -2,12 +2,16 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h> 
+#include <float.h>
 #include "primitives.h"   
 #include "util.h" 
+#include "matfile.h"
+#include "datfile.h"
+#include "generator.h"
+#include "verify.h"
+#include "solfile.h"
+#include "banded.h"
 
-#define MAX_SIZE 20       // Max N dimension
-#define MAXSTR 80
-#define TOL 1.0e-6 // tolerance 
 
 
 
@@ -15,169 +19,192 @@
 int main(int argc, char *argv[])
 {
     // declarations
-    int j, k, l;
+    int k, l;
     int n_row,m_col;
-    float **A, **Aug, **A_chol;
-    float *b, *x, *check;
-    char buffer[MAXSTR];
-    FILE *fp;
+    float **A, **Aug;
+    float **B, **X; // right-hand sides and solutions, N x M
     char *input_filename = NULL;
+    matfile mf; // binary input, see matfile.h
+    datfile df; // text input, see datfile.h
+    gen_spec gen; // -gen: system built in memory, see generator.h
+    int binary, generated = 0;
+    arena work; // every matrix of the system, sized once N and M are known
+    verify_mode vmode = VERIFY_FULL;
+    verify_result vr;
+    double vtol;
+    char *output_path = NULL; // -o, default <input>_solution.txt (.bin)
+    sol_format oformat = SOL_TEXT;
+    int append = 0;
+    verbosity vlevel = VERBOSITY_AUTO; // matrix printing, see util.h
+    int band = 1; // --band=off: always Gauss-Jordan
+    band_info bi;
+    band_path path = BAND_DENSE;
 
 
     // check command line arguments 
-    if (argc != 2) {
+    for (k = 1; k < argc; k++) {
+        if (strcmp(argv[k], "-gen") == 0 && k + 1 < argc) {
+            if (gen_parse(argv[++k], &gen) != 0) { nrerror("Invalid generator spec."); }
+            generated = 1;
+            input_filename = gen.name;
+        } else if (strncmp(argv[k], "--verify=", 9) == 0 && verify_parse(argv[k] + 9, &vmode) == 0) {
+            continue;
+        } else if (strncmp(argv[k], "--output=", 9) == 0 && solfile_parse_format(argv[k] + 9, &oformat) == 0) {
+            continue;
+        } else if (strncmp(argv[k], "--verbosity=", 12) == 0 && verbosity_parse(argv[k] + 12, &vlevel) == 0) {
+            continue;
+        } else if (strcmp(argv[k], "--band=auto") == 0 || strcmp(argv[k], "--band=off") == 0) {
+            band = (strcmp(argv[k] + 7, "auto") == 0);
+        } else if (strcmp(argv[k], "--append") == 0) {
+            append = 1;
+        } else if (strcmp(argv[k], "-o") == 0 && k + 1 < argc) {
+            output_path = argv[++k];
+        } else if (argv[k][0] != '-' && input_filename == NULL) {
+            input_filename = argv[k]; // get filename from the command line
+        } else {
+            input_filename = NULL;
+            break;
+        }
+    }
+    if (input_filename == NULL) {
         // print usage instruction to standard error
-        fprintf(stderr, "Usage: %s <matrix_data_file>\n", argv[0]);
+        fprintf(stderr, "Usage: %s [--band=auto|off] [--verify=full|sampled|none] [--verbosity=quiet|summary|full] [-o <file>] [--output=text|binary] [--append] <matrix_data_file>\n", argv[0]);
+        fprintf(stderr, "       %s [--band=auto|off] [--verify=full|sampled|none] [--verbosity=quiet|summary|full] [-o <file>] [--output=text|binary] [--append] -gen <trefethen|spd|diagdom|general>:<N>[,m=<M>][,cond=<c>][,seed=<s>]\n", argv[0]);
         // exit indicating an error
+        fprintf(stderr, "  --band: narrow-band systems are solved by band LU instead (auto, default), or never (off)\n");
         exit(EXIT_FAILURE); // or return 1 (this is a unix thing);
     }
+    set_verbosity(vlevel);
 
-    input_filename = argv[1]; // get filename from the command line
-
-
-    //  allocate memory for matrices an vectors  
-    A = matrix(MAX_SIZE, MAX_SIZE);
-    b = vector(MAX_SIZE);
-    x = vector(MAX_SIZE);
-    Aug = matrix(MAX_SIZE, MAX_SIZE + 1);
-    A_chol = matrix(MAX_SIZE, MAX_SIZE);
-    check = vector(MAX_SIZE);
 
     //  input file 
-    printf("Input file: %s\n", input_filename);
-    if ((fp = fopen(input_filename, "r")) == NULL) { /* Todo: Handle error */ nrerror("..."); }
-    printf("Successfully opened file.\n");
-
-    // consume initial header 
-    if (fgets(buffer, MAXSTR, fp) == NULL) { /* Todo: Handle error */ }
-    if (fgets(buffer, MAXSTR, fp) == NULL) { /* Todo: Handle error */ }
-
-
-    // process the system 
-    printf("\nStarting to read systems from file...\n");
-    if(fscanf(fp, "%d %d", &n_row, &m_col) != 2){}
+    printf(generated ? "Generated system: %s\n" : "Input file: %s\n", input_filename);
+    PROF_BEGIN("input");
+    binary = !generated && matfile_is_binary(input_filename);
+    if (generated) {
+        n_row = (int)gen.n;
+        m_col = (int)gen.m;
+    } else if (binary) {
+        // binary container: dimensions and data come straight from the mapping, nothing to parse
+        if (matfile_open(input_filename, &mf) != 0) { nrerror("Error opening binary matrix file"); }
+        printf("Successfully mapped binary file.\n");
+        printf("\nStarting to read systems from file...\n");
+        n_row = (int)mf.hdr.n;
+        m_col = (int)mf.hdr.m;
+    } else {
+        // text .dat file: mapped and parsed in one pass after the dimensions are known
+        if (datfile_open(input_filename, &df) != 0) { nrerror("Error opening matrix file"); }
+        printf("Successfully opened file.\n");
+
+        // process the system 
+        printf("\nStarting to read systems from file...\n");
+        n_row = df.n;
+        m_col = df.m;
+    }
 
 //  validation and header consumption for A and b 
-    if (n_row <= 0 || n_row > MAX_SIZE) { /* Todo: Handle validation*/ }
-    if (m_col != 1) { /* Todo: handle validation */ }
-    fgets(buffer, MAXSTR, fp); // consume rest of N M line
-    fgets(buffer, MAXSTR, fp); // consume header before A
+    if (n_row <= 0) { nrerror("Invalid dimension N."); }
+    if (m_col <= 0) { nrerror("Invalid number of right-hand sides M."); }
 
-    printf("\n--- Processing System (N=%d) from %s ---\n", n_row, input_filename);
-    printf("Reading Matrix A (%d x %d):\n", n_row, n_row);
-    for (k = 0; k < n_row; k++) { // Read A
-        for (l = 0; l < n_row; l++) {
-            if (fscanf(fp, "%f", &A[k][l]) != 1) { nrerror("Error reading matrix A");}
-        }
-    }
-    fgets(buffer, MAXSTR, fp); // Consume line after A
-    fgets(buffer, MAXSTR, fp); // Consume header before b
+    //  allocate memory for matrices and vectors, all from one block; [A|B] once the band is known
+    arena_init(&work, arena_matrix_size(n_row, n_row, sizeof(float)) + 2 * arena_matrix_size(n_row, m_col, sizeof(float)));
+    A = arena_matrix(&work, n_row, n_row);
+    // B has one column per right-hand side, all solved in one elimination
+    B = arena_matrix(&work, n_row, m_col);
+    X = arena_matrix(&work, n_row, m_col);
 
-    printf("Reading Vector b (%d x 1):\n", n_row);
-    for (k = 0; k < n_row; k++) { // Read b
-        if (fscanf(fp, "%f", &b[k]) != 1) { nrerror("Error reading vector b");}
+    printf("\n--- Processing System (N=%d) from %s ---\n", n_row, input_filename);
+    if (generated) {
+        printf("Generating Matrix A (%d x %d) and B (%d x %d) in memory.\n", n_row, n_row, n_row, m_col);
+        if (gen_fill(&gen, A, B) != 0) { nrerror("Error generating the system"); }
+    } else if (binary) {
+        printf("Copying Matrix A (%d x %d) and B (%d x %d) from the mapping:\n", n_row, n_row, n_row, m_col);
+        matfile_copy(&mf, MATFILE_A, A);
+        matfile_copy(&mf, MATFILE_B, B);
+        matfile_close(&mf);
+    } else {
+        printf("Reading Matrix A (%d x %d) and B (%d x %d):\n", n_row, n_row, n_row, m_col);
+        if (datfile_read(&df, A, B) != 0) { nrerror("Error reading matrices A and B"); }
+        datfile_close(&df);
     }
+    PROF_END("input");
 
     print_matrix(A, n_row,  n_row, "Original A");
-    print_vector(b,  n_row, "Original b");
+    if (m_col == 1) print_vector(B[0], n_row, "Original b"); // a single column is contiguous
+    else print_matrix(B, n_row,  m_col, "Original B");
+
+
+    // bandwidth in one pass: on a narrow band Gauss-Jordan would mostly eliminate zeros
+    if (band) {
+        PROF_BEGIN("bandwidth");
+        band_detect(A, n_row, 0, &bi);
+        path = band_choose(&bi, n_row, 0);
+        PROF_END("bandwidth");
+        printf("Bandwidth: %d below and %d above the diagonal: %s solver.\n", bi.kl, bi.ku, band_path_name(path));
+    }
 
 
     //  solve using selected method 
     int solve_success = 1;
-    // GAUSS_JORDAN
-    printf("\nAttempting Gauss-Jordan Elimination...\n");
-    for (k = 0; k < n_row; k++) {
-        for (l = 0; l < n_row; l++) { Aug[k][l] = A[k][l]; }
-        Aug[k][n_row] = b[k];
+    if (path != BAND_DENSE) {
+        printf("\nAttempting %s...\n", band_path_name(path));
+        PROF_BEGIN("band");
+        int info = band_solve(A, B, X, n_row, m_col, path, &bi, &work);
+        PROF_END("band");
+        if (info != 0) {
+            fprintf(stderr, "ERROR: Matrix A is singular (pivot %d).\n", info - 1);
+            solve_success = 0;
+        } else {
+            printf("Band solve complete (%s).\n", band_path_name(path));
+        }
+    } else {
+        // GAUSS_JORDAN
+        printf("\nAttempting Gauss-Jordan Elimination...\n");
+        Aug = arena_matrix(&work, n_row, n_row + m_col);
+        PROF_BEGIN("convert");
+        for (k = 0; k < n_row; k++) {
+            for (l = 0; l < n_row; l++) { Aug[k][l] = A[k][l]; }
+            for (l = 0; l < m_col; l++) { Aug[k][n_row + l] = B[k][l]; }
+        }
+        PROF_END("convert");
+
+        print_matrix(Aug, n_row,  n_row + m_col, "initial Augmented [A|B]");
+        PROF_BEGIN("eliminate");
+        gauss_jordan_multi(Aug, n_row, m_col); // modifies Aug, might exit
+        PROF_END("eliminate");
+        printf("Gauss-Jordan complete.\n");
+        print_matrix(Aug, n_row, n_row + m_col, "Final Augmented [I|X]");
+        for (k = 0; k < n_row; k++)
+            for (l = 0; l < m_col; l++) X[k][l] = Aug[k][n_row + l];
     }
 
-    print_matrix(Aug, n_row,  n_row + 1, "initial Augmented [A|b]");
-    gauss_jordan_partial(Aug, n_row); // modifies Aug, might exit
-    printf("Gauss-Jordan complete.\n");
-    print_matrix(Aug, n_row, n_row + 1, "Final Augmented [I|x]");
-    for (k = 0; k < n_row; k++)  x[k] = Aug[k][n_row]; 
-
 
     if (solve_success) {
-        print_vector(x, n_row, "Solution x"); 
+        if (m_col == 1) print_vector(X[0], n_row, "Solution x"); 
+        else print_matrix(X, n_row, m_col, "Solution X");
     
         //  write solution to a file 
-        FILE *out_fp = NULL;
-        char output_filename[MAXSTR + 20]; // +20 for suffix and null terminator
-    
-        if (input_filename != NULL) { // again we check the file exists
-            snprintf(output_filename, sizeof(output_filename), "%s_solution.txt", input_filename);
-        } 
-        else {
-            snprintf(output_filename, sizeof(output_filename), "solution_output.txt");
-        }
-    
-        printf("Attempting to write solution to: %s\n", output_filename);
-        out_fp = fopen(output_filename, "w"); 
+        PROF_BEGIN("output");
+        solfile_write(output_path, input_filename, oformat, append, X, n_row, m_col);
+        PROF_END("output");
     
-        if (out_fp == NULL) {
-            fprintf(stderr, "Error: Could not open output file '%s' for writing solution.\n", output_filename);
-        } 
-        else {
-            // since we didn't stop on input_filename error, we are defensively checking
-            fprintf(out_fp, "# Solution vector x for input: %s\n", (input_filename ? input_filename : "N/A"));
-            fprintf(out_fp, "# Number of elements (N_ROW): %d\n", n_row);
-            for (k = 0; k < n_row; k++) {
-                if (fprintf(out_fp, "%.8f\n", x[k]) < 0) {
-                    fprintf(stderr, "Error writing element x[%d] to output file.\n", k);
-                    break;
-                }
-            }
-            fclose(out_fp); 
-            printf("Solution successfully written to %s.\n", output_filename);
-        }
-        // end of writing solution to file 
-    
-        printf("Verifying solution (Calculating A * x)...\n");
-
-        for (k = 0; k < n_row; k++) {
-            check[k] = 0.0;
-            for (j = 0; j < n_row; j++) {
-                check[k] += A[k][j] * x[j]; 
-            }
-        }
-        print_vector(check, n_row, "Calculated A*x");
-        printf("Comparing A*x with original b:\n");
-    
-        int errors = 0;
-        for (k = 0; k < n_row; k++) {
-            if (fabs(check[k] - b[k]) > TOL) {
-                printf("  Mismatch at index [%d]: A*x = %.7g, b = %.7g, Diff = %.7g\n",
-                       k, check[k], b[k], fabs(check[k] - b[k]));
-                errors++;
-            }
-        }
-        if (errors == 0) {
-            printf("  Verification successful (within TOL=%.1e).\n", TOL);
-        } else {
-            printf("  Verification FAILED (%d mismatches).\n", errors);
-        }
+        printf("Verifying solution (Calculating A * X)...\n");
+        PROF_BEGIN("verify");
+        vtol = verify_tol(n_row, FLT_EPSILON);
+        verify(A, B, X, n_row, m_col, vmode, vtol, 0, &vr);
+        PROF_END("verify");
+        verify_print(&vr, vmode, vtol);
     
     } else {
         printf("\nSkipping verification and solution output for this system due to solver incompatibility or failure.\n");
     }
 
     /* check if the file has been consumed completely. */
-    if (!feof(fp)) {
-        fprintf(stderr, "Warning: File processing stopped before reaching end-of-file. Check file format near last processed system.\n");
-    }
-
-    fclose(fp);
     printf("File processing complete for %s.\n", input_filename);
 
     //  free Memory 
     printf("Freeing memory...\n");
-    free_matrix(A);
-    free_vector(b);
-    free_vector(x);
-    free_matrix(Aug );
-    free_matrix(A_chol);
-    free_vector(check);
+    arena_free(&work);
 
     printf("Done.\n");
     return 0;
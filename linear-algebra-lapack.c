@@ -3,286 +3,525 @@
 #include <stdlib.h>
 #include <string.h> 
 #include <math.h>   
+#include <float.h>
 #include "primitives.h"   
 #include "util.h"
+#include "matfile.h"
+#include "datfile.h"
+#include "sparse.h"
+#include "mtxfile.h"
+#include "generator.h"
+#include "verify.h"
+#include "solfile.h"
+#include "taskdag.h"
+#include "backend.h" // LAPACK-style kernels: builtin, LAPACKE or MKL, see the Makefile
 
-#include "mkl_lapacke.h"
 
-
-
-#define MAX_SIZE 5000     // Max 
-#define MAXSTR 80
-#define TOL_FLOAT 1.0e-6  // Tolerance for float comparisons
 #define TOL_DOUBLE 1.0e-9 // Tolerance for double comparisons
+#define PCG_HISTORY_LINES 20 // residual history lines printed per right-hand side
 
 // define solver method
-typedef enum { GAUSS_JORDAN, CHOLESKY_PRIMITIVE, CHOLESKY_LAPACK } SolverMethod;
+typedef enum { GAUSS_JORDAN, CHOLESKY_PRIMITIVE, CHOLESKY_LAPACK, CHOLESKY_TASKS, LU_PRIMITIVE, PCG_SPARSE,
+               MIXED_CHOLESKY, MIXED_LU } SolverMethod;
+
+
+// double-precision solve of AX = B (Cholesky if spd, else LU) on column-major copies from the arena; returns info
+static int lapack_solve_d(const la_backend *la, arena *work, double **A, double **B, double **X, int n, int m, int spd) {
+    mat_desc src = dmatrix_desc(A, n, n);
+    mat_desc a = mat_alloc(work, n, n, MAT_COL_MAJOR, MAT_FLOAT64);
+    mat_desc b = mat_alloc(work, n, m, MAT_COL_MAJOR, MAT_FLOAT64);
+    int *ipiv = arena_ivector(work, n);
+    int info;
+
+    mat_copy(&src, &a);
+    src = dmatrix_desc(B, n, m);
+    mat_copy(&src, &b);
+    if (spd) {
+        info = la->potrf(n, (double *)a.data, (int)a.ld);
+        if (info == 0) info = la->potrs(n, m, (double *)a.data, (int)a.ld, (double *)b.data, (int)b.ld);
+    } else {
+        info = la->getrf(n, (double *)a.data, (int)a.ld, ipiv);
+        if (info == 0) info = la->getrs(n, m, (double *)a.data, (int)a.ld, ipiv, (double *)b.data, (int)b.ld);
+    }
+    if (info == 0) { src = dmatrix_desc(X, n, m); mat_copy(&b, &src); }
+    return info;
+}
 
+// arena bytes the method below takes for an N x N system with M right-hand sides
+static size_t scratch_bytes(SolverMethod method, long n, long m, long pcg_maxit) {
+    size_t bytes = 0;
+    switch (method) {
+        case CHOLESKY_LAPACK: // column-major L and B, each column padded by up to 8 doubles
+        case CHOLESKY_TASKS:  // the same; the tiles are task_potrf()'s own
+            bytes += arena_matrix_size(n, n + 8, sizeof(double)) + arena_matrix_size(m, n + 8, sizeof(double)); break;
+        case CHOLESKY_PRIMITIVE: bytes += arena_tri_matrix_size(n, sizeof(float)) + 2 * arena_matrix_size(n, m, sizeof(float)); break;
+        case LU_PRIMITIVE: bytes += arena_matrix_size(n, n, sizeof(float)) + 2 * arena_matrix_size(n, m, sizeof(float))
+                                    + arena_matrix_size(1, n, sizeof(int)); break;
+        case PCG_SPARSE: bytes += 2 * arena_matrix_size(1, n, sizeof(double)) + arena_matrix_size(1, pcg_maxit + 1, sizeof(double)); break;
+        case GAUSS_JORDAN: bytes += arena_matrix_size(n, n + m, sizeof(float)); break;
+        default: break; // the mixed-precision solvers allocate their own
+    }
+    return bytes;
+}
+
+// print about PCG_HISTORY_LINES entries of a PCG residual history, always the last one
+static void print_pcg_history(const pcg_stats *ps) {
+    int step = (ps->iterations + PCG_HISTORY_LINES - 1) / PCG_HISTORY_LINES;
+    if (step < 1) step = 1;
+    for (int i = 0; i <= ps->iterations; i++) {
+        if (i % step == 0 || i == ps->iterations) printf("    iteration %5d: ||r||/||b|| = %.3e\n", i, ps->history[i]);
+    }
+}
 
 
 
 // --- Main function modified ---
 int main(int argc, char *argv[])
 {
-    int j, k, l;
+    int k, l;
     int n_row, m_col;
 
     // read input into double precision structures
     double **A; 
-    double *b;
-    double *x;
-    double *check; 
+    double **B; // N x M right-hand sides
+    double **X; // N x M solutions
 
     // for using primitive cholesky method
     float **A_chol_primitive; 
-    float *b_primitive; 
-    float *x_primitive;
+    float **B_primitive; 
+    float **X_primitive;
 
-    double **A_chol_lapack; 
+    mat_desc A_desc, L_desc, B_desc, X_desc; // contiguous column-major operands for LAPACK
 
     float **Aug; 
 
-    // temporary 1D arrays for LAPACK (contiguous memory)
-    double *A_lapack_1d; 
-    double *b_lapack_1d; 
-
-    char buffer[MAXSTR];
-    FILE *fp;
+    // for using primitive LU method
+    float **A_lu;
+    int *perm;
+
+    matfile mf; // binary input, see matfile.h
+    datfile df; // text input, see datfile.h
+    csr_matrix csr; // Matrix Market input, see mtxfile.h; also the PCG operand
+    int have_csr = 0;
+    gen_spec gen; // -gen: system built in memory, see generator.h
+    int generated = 0;
+    arena work; // working copies of the solvers, see scratch_bytes()
+    int binary;
     char *input_filename = NULL;
     SolverMethod method = GAUSS_JORDAN; // default method
-    lapack_int info; // LAPACK return code
+    int info; // LAPACK-style return code
+    int symmetric;
+    verify_mode vmode = VERIFY_FULL;
+    verify_result vr;
+    double vtol;
+    char *output_path = NULL; // -o, default <input>_solution.txt (.bin)
+    sol_format oformat = SOL_TEXT;
+    int append = 0;
+    verbosity vlevel = VERBOSITY_AUTO; // matrix printing, see util.h
+    const la_backend *la = la_backend_select();
+    int nthreads = 0; // Gauss-Jordan threads, 0: let gauss_jordan_parallel() decide
+
+    // for the sparse PCG method
+    pcg_precond pc = PRECOND_IC0;
+    double pcg_tol = 1.0e-10;
+    int pcg_maxit = 1000;
+    pcg_stats ps;
+
+    // for the mixed-precision methods
+    refine_stats rs;
+    double *b_col, *x_col;
 
     // --- parse command line arguments ---
     if (argc < 2) {
-        fprintf(stderr, "Usage: %s [-g | -c | -cl] <matrix_data_file>\n", argv[0]);
+        fprintf(stderr, "Usage: %s [-g | -lu | -c | -cl | -ct | -mc | -mlu | -pcg] [-t <threads>] [-pc <jacobi|ic0|none>] [-tol <x>] [-maxit <n>] [--verify=full|sampled|none] [--verbosity=quiet|summary|full] [-o <file>] [--output=text|binary] [--append] <matrix_data_file | -gen <spec>>\n", argv[0]);
         fprintf(stderr, "  -g : Use Gauss-Jordan (float)\n");
+        fprintf(stderr, "  -lu: Use Custom LU with partial pivoting (float)\n");
         fprintf(stderr, "  -c : Use Custom Cholesky (float)\n");
-        fprintf(stderr, "  -cl: Use LAPACK Cholesky (double)\n");
+        fprintf(stderr, "  -cl: Use LAPACK Cholesky (double), backend from $LA_BACKEND (builtin, lapacke or mkl)\n");
+        fprintf(stderr, "  -ct: Use tiled Cholesky (double) scheduled as a task DAG on a work-stealing pool, solved by the backend's potrs\n");
+        fprintf(stderr, "  -mc: Use Custom Cholesky (float) refined to double accuracy\n");
+        fprintf(stderr, "  -mlu: Use Custom LU (float) refined to double accuracy\n");
+        fprintf(stderr, "  -pcg: Use preconditioned conjugate gradients on sparse storage (double)\n");
+        fprintf(stderr, "  -t : Threads for Gauss-Jordan (default: $GJ_NUM_THREADS, then $OMP_NUM_THREADS) and -ct (default: $TASK_NUM_THREADS, then all CPUs)\n");
+        fprintf(stderr, "  -pc: PCG preconditioner (default: ic0, Jacobi if IC(0) breaks down)\n");
+        fprintf(stderr, "  -tol, -maxit: PCG stops at ||b - Ax|| <= tol * ||b|| (default 1e-10) or after maxit iterations (default 1000)\n");
+        fprintf(stderr, "  matrix_data_file: text .dat, binary (see matconvert) or Matrix Market .mtx (b = ones)\n");
+        fprintf(stderr, "  --verify: backward error over all rows (default), %d sampled rows, or no check\n", VERIFY_SAMPLE_ROWS);
+        fprintf(stderr, "  -o, --output: solution file (default: <input>_solution.txt, .bin) in shortest round-trip text or the binary container\n");
+        fprintf(stderr, "  --verbosity: matrices printed not at all, as norms and corners, or in full (default: full up to %d rows, summary above)\n", PRINT_FULL_MAX);
+        fprintf(stderr, "  --append: add to an existing solution file instead of replacing it\n");
+        fprintf(stderr, "  -gen: <trefethen|spd|diagdom|general>:<N>[,m=<M>][,cond=<c>][,seed=<s>] instead of a file\n");
         exit(EXIT_FAILURE);
     }
 
-    // check for optional flag
-    if (argc > 2  && (argv[1][1] == 'g' || argv[1][1] == 'c')) {
-        if (strcmp(argv[1], "-c") == 0) {
+    for (k = 1; k < argc; k++) {
+        if (strcmp(argv[k], "-c") == 0) {
             method = CHOLESKY_PRIMITIVE;
-        } else if (strcmp(argv[1], "-cl") == 0) {
+        } else if (strcmp(argv[k], "-cl") == 0) {
             method = CHOLESKY_LAPACK;
-        } else if (strcmp(argv[1], "-g") == 0) {
+        } else if (strcmp(argv[k], "-ct") == 0) {
+            method = CHOLESKY_TASKS;
+        } else if (strcmp(argv[k], "-g") == 0) {
             method = GAUSS_JORDAN;
+        } else if (strcmp(argv[k], "-lu") == 0) {
+            method = LU_PRIMITIVE;
+        } else if (strcmp(argv[k], "-mc") == 0) {
+            method = MIXED_CHOLESKY;
+        } else if (strcmp(argv[k], "-mlu") == 0) {
+            method = MIXED_LU;
+        } else if (strcmp(argv[k], "-pcg") == 0) {
+            method = PCG_SPARSE;
+        } else if (strcmp(argv[k], "-t") == 0 && k + 1 < argc) {
+            nthreads = atoi(argv[++k]);
+        } else if (strcmp(argv[k], "-pc") == 0 && k + 1 < argc) {
+            k++;
+            if (strcmp(argv[k], "jacobi") == 0) pc = PRECOND_JACOBI;
+            else if (strcmp(argv[k], "ic0") == 0) pc = PRECOND_IC0;
+            else if (strcmp(argv[k], "none") == 0) pc = PRECOND_NONE;
+            else fprintf(stderr, "Warning: Unknown preconditioner '%s'. Using IC(0).\n", argv[k]);
+        } else if (strcmp(argv[k], "-tol") == 0 && k + 1 < argc) {
+            pcg_tol = atof(argv[++k]);
+        } else if (strcmp(argv[k], "-maxit") == 0 && k + 1 < argc) {
+            pcg_maxit = atoi(argv[++k]);
+        } else if (strncmp(argv[k], "--verify=", 9) == 0) {
+            if (verify_parse(argv[k] + 9, &vmode) != 0) fprintf(stderr, "Warning: Unknown verification '%s'. Using full.\n", argv[k] + 9);
+        } else if (strncmp(argv[k], "--output=", 9) == 0) {
+            if (solfile_parse_format(argv[k] + 9, &oformat) != 0) fprintf(stderr, "Warning: Unknown output format '%s'. Using text.\n", argv[k] + 9);
+        } else if (strncmp(argv[k], "--verbosity=", 12) == 0) {
+            if (verbosity_parse(argv[k] + 12, &vlevel) != 0) fprintf(stderr, "Warning: Unknown verbosity '%s'. Using auto.\n", argv[k] + 12);
+        } else if (strcmp(argv[k], "--append") == 0) {
+            append = 1;
+        } else if (strcmp(argv[k], "-o") == 0 && k + 1 < argc) {
+            output_path = argv[++k];
+        } else if (strcmp(argv[k], "-gen") == 0 && k + 1 < argc) {
+            if (gen_parse(argv[++k], &gen) != 0) { nrerror("Invalid generator spec."); }
+            generated = 1;
+            input_filename = gen.name; // names the solution file
+        } else if (argv[k][0] == '-') {
+            fprintf(stderr, "Warning: Unrecognized flag '%s' ignored.\n", argv[k]);
+        } else if (input_filename == NULL) {
+            input_filename = argv[k];
         } else {
-             // Treat as filename if flag is unrecognized after '-'
-             input_filename = argv[1];
-              fprintf(stderr, "Warning: Unrecognized flag '%s'. Defaulting to Gauss-Jordan.\n", argv[1]);
-              method = GAUSS_JORDAN;
-              if(argc > 2) input_filename = argv[2]; 
-               else { fprintf(stderr,"Error: Missing filename after potentially invalid flag.\n"); exit(EXIT_FAILURE);}
-
+            fprintf(stderr, "Warning: Extra command line argument '%s' ignored.\n", argv[k]);
         }
-         if(input_filename == NULL) input_filename = argv[2]; // Filename is the third argument if flag was valid
-
-         if (argc > 3) fprintf(stderr, "Warning: Extra command line arguments ignored.\n");
-    } else {
-        // No flag or unrecognized flag, assume filename is the second argument
-        input_filename = argv[1];
-        method = GAUSS_JORDAN; // Default if no flag
-        if (argc > 2) fprintf(stderr, "Warning: Arguments after filename ignored. Use -g/-c/-cl flags.\n");
     }
-
-
-    // --- allocate memory for matrices and vectors ---
-    A = dmatrix(MAX_SIZE,  MAX_SIZE);
-    b = dvector(MAX_SIZE);
-    x = dvector(MAX_SIZE);        
-    check = dvector(MAX_SIZE);    
+    if (input_filename == NULL) { nrerror("Missing matrix data file."); }
+    set_verbosity(vlevel);
+#ifndef _OPENMP
+    if (nthreads > 1 && method == GAUSS_JORDAN) {
+        fprintf(stderr, "Warning: this build has no OpenMP, -t ignored for Gauss-Jordan (see make omp).\n");
+    }
+#endif
 
 
     // --- open the specified input file ---
-    printf("Input file: %s\n", input_filename);
+    printf(generated ? "Generated system: %s\n" : "Input file: %s\n", input_filename);
     const char* method_str = "Unknown";
     switch(method) {
         case GAUSS_JORDAN: method_str = "Gauss-Jordan (Float)"; break;
         case CHOLESKY_PRIMITIVE: method_str = "Cholesky (Custom Float)"; break;
         case CHOLESKY_LAPACK: method_str = "Cholesky (LAPACK Double)"; break;
+        case CHOLESKY_TASKS: method_str = "Cholesky (Task-DAG Tiles Double)"; break;
+        case LU_PRIMITIVE: method_str = "LU (Custom Float)"; break;
+        case PCG_SPARSE: method_str = "PCG (Sparse Double)"; break;
+        case MIXED_CHOLESKY: method_str = "Cholesky (Float, Refined to Double)"; break;
+        case MIXED_LU: method_str = "LU (Float, Refined to Double)"; break;
     }
     printf("Using solver: %s\n", method_str);
-    if ((fp = fopen(input_filename, "r")) == NULL) { nrerror("File open error"); }
-    printf("Successfully opened file.\n");
-
-    //consume initial header lines 
-    printf("Skipping initial header lines...\n");
-    if (fgets(buffer, MAXSTR, fp) == NULL) { nrerror("Error reading first header or empty file."); }
-    if (fgets(buffer, MAXSTR, fp) == NULL) { nrerror("Error reading second header or file too short."); }
-
-    //  read dimensions N M 
-    if (fscanf(fp, " %d %d", &n_row, &m_col) != 2) {
-        nrerror("Error reading matrix dimensions (N M) for the first system.");
-    }
-
-    //  validation 
-    if (n_row <= 0 || n_row > MAX_SIZE) {
-        fprintf(stderr, "Error: Invalid dimension N=%d (Max N=%d).\n", n_row, MAX_SIZE);
-        fclose(fp); // Close file before exiting
-        exit(EXIT_FAILURE);
-    }
-    if (m_col != 1) {
-        fprintf(stderr, "Warning: File specifies M=%d, but expecting M=1 for Ax=b. Proceeding anyway.\n", m_col);
-    }
-
-    // consume headers/lines before A 
-    fgets(buffer, MAXSTR, fp); // consume rest of N M line
-    fgets(buffer, MAXSTR, fp); // consume header before A
-
-    //  read Matrix A (into double) 
-    printf("Reading Matrix A (%d x %d) as double:\n", n_row, n_row);
-    for (k = 0; k < n_row; k++) {
-        for (l = 0; l < n_row; l++) {
-            if (fscanf(fp, "%lf", &A[k][l]) != 1) { nrerror("Error reading matrix A data");}
+    printf("Linear algebra backend: %s\n", la->name);
+    PROF_BEGIN("input");
+    binary = !generated && matfile_is_binary(input_filename);
+    if (generated) {
+        n_row = (int)gen.n;
+        m_col = (int)gen.m;
+        A = dmatrix(n_row, n_row);
+        B = dmatrix(n_row, m_col);
+        X = dmatrix(n_row, m_col);
+        printf("Generating Matrix A (%d x %d) and B (%d x %d) in memory.\n", n_row, n_row, n_row, m_col);
+        if (gen_fill_d(&gen, A, B) != 0) { nrerror("Error generating the system"); }
+    } else if (binary) {
+        // binary container: A is used in place when the file is float64 row-major
+        if (matfile_open(input_filename, &mf) != 0) { nrerror("Error opening binary matrix file"); }
+        printf("Successfully mapped binary file.\n");
+        n_row = (int)mf.hdr.n;
+        m_col = (int)mf.hdr.m;
+        B = dmatrix(n_row, m_col);
+        X = dmatrix(n_row, m_col);
+
+        A_desc = matfile_desc(&mf, MATFILE_A);
+        if ((A = matfile_dview(&mf, MATFILE_A)) != NULL) {
+            printf("Mapping Matrix A (%d x %d) without copying.\n", n_row, n_row);
+        } else if ((method == CHOLESKY_LAPACK || method == CHOLESKY_TASKS) && A_desc.type == MAT_FLOAT64) {
+            // column-major A read as rows is A^T, which is A itself for the symmetric
+            // matrices -cl accepts (checked below)
+            printf("Mapping column-major Matrix A (%d x %d) without copying.\n", n_row, n_row);
+            A = dmatrix_view((double *)A_desc.data, n_row, n_row);
+        } else {
+            printf("Converting Matrix A (%d x %d) to double:\n", n_row, n_row);
+            A = dmatrix(n_row, n_row);
+            matfile_copy_d(&mf, MATFILE_A, A);
         }
+        printf("Converting Matrix B (%d x %d) to double:\n", n_row, m_col);
+        matfile_copy_d(&mf, MATFILE_B, B);
+    } else if (mtxfile_is_matrix_market(input_filename)) {
+        // sparse input is assembled as CSR; PCG keeps it, the dense solvers get a dense copy
+        if (mtxfile_read(input_filename, &csr) != 0) { nrerror("Error reading Matrix Market file"); }
+        if (csr.n_rows != csr.n_cols) { nrerror("Matrix Market matrix is not square."); }
+        n_row = (int)csr.n_rows;
+        m_col = 1; // .mtx files hold A only: solve for b = ones
+        printf("Read sparse Matrix A (%d x %d, %ld entries), using b = ones.\n", n_row, n_row, csr.nnz);
+        if (method == PCG_SPARSE) {
+            A = NULL; // nothing dense is allocated
+            have_csr = 1;
+        } else {
+            A = csr_to_dmatrix(&csr);
+            free_csr(&csr);
+        }
+        B = dmatrix(n_row, m_col);
+        X = dmatrix(n_row, m_col);
+        for (k = 0; k < n_row; k++) B[k][0] = 1.0;
+    } else {
+        // text .dat file: mapped, then parsed straight into A and B
+        if (datfile_open(input_filename, &df) != 0) { nrerror("Error opening matrix file"); }
+        printf("Successfully opened file.\n");
+        n_row = df.n;
+        m_col = df.m;
+        A = dmatrix(n_row, n_row);
+        B = dmatrix(n_row, m_col);
+        X = dmatrix(n_row, m_col);
+
+        printf("Reading Matrix A (%d x %d) and B (%d x %d) as double:\n", n_row, n_row, n_row, m_col);
+        if (datfile_read_d(&df, A, B) != 0) { nrerror("Error reading matrix data"); }
+        datfile_close(&df);
     }
-
-    //  consume headers/lines before b 
-    fgets(buffer, MAXSTR, fp); // consume line after A data
-    fgets(buffer, MAXSTR, fp); // consume header before b
-
-    printf("Reading Vector b (%d x 1) as double:\n", n_row);
-    for (k = 0; k < n_row; k++) {
-         if (fscanf(fp, "%lf", &b[k]) != 1) { nrerror("Error reading vector b data");}
-         // consume rest of line in case M > 1 was specified
-         while (fgetc(fp) != '\n' && !feof(fp));
-    }
-
-    fclose(fp); // Close the file, we've read all we need
+    PROF_END("input");
     printf("Finished reading data from file.\n");
+    // working copies for the chosen method, sized from N and M and released together
+    arena_init(&work, scratch_bytes(method, n_row, m_col, pcg_maxit));
 
-    //print_nr_dmatrix(A, 1, n, 1, n, "Original A (Double)");
-    //print_nr_dvector(b, 1, n, "Original b (Double)");
+    if (A != NULL) print_dmatrix(A, n_row, n_row, "Original A");
+    print_dmatrix(B, n_row, m_col, "Original B");
 
     int solve_success = 1;
 
-    if (method == CHOLESKY_LAPACK) {
-        // allocate double copy based on actual size n
-        A_chol_lapack = dmatrix(n_row,  n_row);
-        for(k=0; k<n_row; ++k) for(l=0; l<n_row; ++l) A_chol_lapack[k][l] = A[k][l];
-
-        printf("\nAttempting Cholesky Decomposition using LAPACKE_dpotrf...\n");
-        if (!is_symmetric_double(A_chol_lapack, n_row)) {
+    if (method == CHOLESKY_LAPACK || method == CHOLESKY_TASKS) {
+        if (method == CHOLESKY_TASKS) printf("\nAttempting tiled Cholesky Decomposition on %d task thread(s)...\n", task_threads(nthreads));
+        else printf("\nAttempting Cholesky Decomposition using %s potrf...\n", la->name);
+        PROF_BEGIN("symmetry");
+        symmetric = is_symmetric_double(A, n_row);
+        PROF_END("symmetry");
+        if (!symmetric) {
             fprintf(stderr, "ERROR: Matrix A is not symmetric. Cholesky method cannot be used.\n");
             solve_success = 0;
-            // free memory allocated ONLY for this block if failing early
-            free_dmatrix(A_chol_lapack); A_chol_lapack = NULL;
         } else {
             printf("Matrix appears symmetric. Proceeding with LAPACK.\n");
-            // Allocate 1D arrays
-            A_lapack_1d = (double*)malloc(n_row * n_row * sizeof(double));
-            b_lapack_1d = (double*)malloc(n_row * sizeof(double));
-            if (!A_lapack_1d || !b_lapack_1d) nrerror("Memory allocation failed for LAPACK arrays");
-
-            // copy to 1D arrays
-            for (k = 0; k < n_row; k++) for (l = 0; l < n_row; l++) A_lapack_1d[k  * n_row + l ] = A_chol_lapack[k][l];
-            for (k = 0; k < n_row; k++) b_lapack_1d[k] = b[k];
-
-            // call LAPACKE_dpotrf, which factorises A = U^T * U
-            info = LAPACKE_dpotrf(LAPACK_ROW_MAJOR, 'U', n_row, A_lapack_1d, n_row);
+            // A is symmetric, so its row-major storage already is its column-major storage:
+            // the one copy the factorization overwrites is a memcpy per column, and the
+            // backend works in LAPACK's native column-major layout
+            PROF_BEGIN("convert");
+            A_desc = mat_transpose(dmatrix_desc(A, n_row, n_row));
+            L_desc = mat_alloc(&work, n_row, n_row, MAT_COL_MAJOR, MAT_FLOAT64);
+            mat_copy(&A_desc, &L_desc);
+            B_desc = mat_alloc(&work, n_row, m_col, MAT_COL_MAJOR, MAT_FLOAT64);
+            X_desc = dmatrix_desc(B, n_row, m_col);
+            mat_copy(&X_desc, &B_desc); // N x M only
+            PROF_END("convert");
+
+            // potrf factorises A = L * L^T; -ct runs its tiles as tasks, same result and layout
+            PROF_BEGIN("factor");
+            if (method == CHOLESKY_TASKS) info = task_potrf(n_row, (double *)L_desc.data, (int)L_desc.ld, nthreads);
+            else info = la->potrf(n_row, (double *)L_desc.data, (int)L_desc.ld);
+            PROF_END("factor");
             if (info != 0) { /* error handling */ solve_success = 0; }
             else {
-                // call LAPACKE_dpotrs, which solves Ax =b given A = U^T * U.
-                info = LAPACKE_dpotrs(/* TODO: fill in the arguments */);
+                // potrs solves AX = B for all M columns given A = L * L^T.
+                PROF_BEGIN("solve");
+                info = la->potrs(n_row, m_col, (double *)L_desc.data, (int)L_desc.ld, (double *)B_desc.data, (int)B_desc.ld);
+                PROF_END("solve");
                 if (info != 0) { /* error handling */ solve_success = 0; }
-                else { /* copy solution */ for (k = 0; k < n_row; k++) x[k] = b_lapack_1d[k]; }
+                else { /* copy solution */ X_desc = dmatrix_desc(X, n_row, m_col); mat_copy(&B_desc, &X_desc); }
             }
-            // Free 1D arrays
-            free(A_lapack_1d); A_lapack_1d = NULL; //good practice to set to NULL after free
-            free(b_lapack_1d); b_lapack_1d = NULL;
-            free_dmatrix(A_chol_lapack); A_chol_lapack = NULL;
         }
 
     } 
     else if (method == CHOLESKY_PRIMITIVE) {
 
-        A_chol_primitive = matrix(n_row,  n_row);
-        b_primitive = vector(n_row);
-        x_primitive = vector(n_row);
+        A_chol_primitive = arena_tri_matrix(&work, n_row); // lower triangle only
+        B_primitive = arena_matrix(&work, n_row, m_col);
+        X_primitive = arena_matrix(&work, n_row, m_col);
 
         // copy double input to float structures
-        for(k=0; k<n_row; ++k) b_primitive[k] = (float)b[k];
-        for(k=0; k<n_row; ++k) for(l=0; l<n_row; ++l) A_chol_primitive[k][l] = (float)A[k][l];
+        PROF_BEGIN("convert");
+        for(k=0; k<n_row; ++k) for(l=0; l<m_col; ++l) B_primitive[k][l] = (float)B[k][l];
+        symmetric = pack_lower_d(A, A_chol_primitive, n_row); // symmetry checked while packing
+        PROF_END("convert");
 
         printf("\nAttempting Custom Cholesky Decomposition (Float)...\n");
-        if (!is_symmetric(A_chol_primitive, n_row)) { 
+        if (!symmetric) { 
             fprintf(stderr, "ERROR: Matrix A is not symmetric...\n");
             solve_success = 0;
-            // free memory allocated ONLY for this block if failing early
-            free_matrix(A_chol_primitive); A_chol_primitive = NULL;
-            free_vector(b_primitive); b_primitive = NULL; 
-            free_vector(x_primitive); x_primitive= NULL; 
         } 
         else {
             printf("Matrix appears symmetric. Proceeding...\n");
-            cholesky(A_chol_primitive, n_row);
+            PROF_BEGIN("factor");
+            int info = cholesky_packed(A_chol_primitive, n_row);
+            PROF_END("factor");
+            if (info != 0) nrerror("Matrix is not positive-definite");
             // print_nr_matrix(a_chol_custom, 1, n, 1, n, "Decomposed A (Float)");
-            cholesky_solve(A_chol_primitive, b_primitive, x_primitive, n_row);
-            for(k=0; k<n_row; ++k) x[k] = (double)x_primitive[k]; // copy solution to double x
+            // factor once, then solve all M columns against the same L
+            PROF_BEGIN("solve");
+            cholesky_solve_multi(A_chol_primitive, B_primitive, X_primitive, n_row, m_col);
+            PROF_END("solve");
+            for(k=0; k<n_row; ++k) for(l=0; l<m_col; ++l) X[k][l] = (double)X_primitive[k][l]; // copy solution to double X
+        }
+
+    } else if (method == LU_PRIMITIVE) {
+
+        A_lu = arena_matrix(&work, n_row, n_row);
+        perm = arena_ivector(&work, n_row);
+        B_primitive = arena_matrix(&work, n_row, m_col);
+        X_primitive = arena_matrix(&work, n_row, m_col);
+
+        // copy double input to float structures
+        PROF_BEGIN("convert");
+        for(k=0; k<n_row; ++k) for(l=0; l<m_col; ++l) B_primitive[k][l] = (float)B[k][l];
+        for(k=0; k<n_row; ++k) for(l=0; l<n_row; ++l) A_lu[k][l] = (float)A[k][l];
+        PROF_END("convert");
+
+        printf("\nAttempting Custom LU Decomposition (Float)...\n");
+        PROF_BEGIN("factor");
+        info = lu_factor(A_lu, n_row, perm); // swaps the row pointers of A_lu
+        PROF_END("factor");
+        if (info != 0) {
+            fprintf(stderr, "ERROR: Matrix A is singular (zero pivot in column %d).\n", (int)info - 1);
+            solve_success = 0;
+        } else {
+            PROF_BEGIN("solve");
+            lu_solve_multi(A_lu, perm, B_primitive, X_primitive, n_row, m_col);
+            PROF_END("solve");
+            for(k=0; k<n_row; ++k) for(l=0; l<m_col; ++l) X[k][l] = (double)X_primitive[k][l]; // copy solution to double X
+        }
 
-            // Free memory after successful use
-            free_matrix(A_chol_primitive); A_chol_primitive = NULL;
-            free_vector(b_primitive); b_primitive = NULL; 
-            free_vector(x_primitive); x_primitive = NULL; 
+    } else if (method == MIXED_CHOLESKY || method == MIXED_LU) {
+
+        printf("\nAttempting Mixed-Precision %s (Float Factor, Double Residuals)...\n", method == MIXED_LU ? "LU" : "Cholesky");
+        PROF_BEGIN("symmetry");
+        symmetric = (method == MIXED_LU) || is_symmetric_double(A, n_row);
+        PROF_END("symmetry");
+        if (!symmetric) {
+            fprintf(stderr, "ERROR: Matrix A is not symmetric. Cholesky method cannot be used.\n");
+            solve_success = 0;
+        } else {
+            PROF_BEGIN("refine");
+            info = refine_solve(A, B, X, n_row, m_col, method == MIXED_LU, REFINE_MAX_ITER, &rs);
+            PROF_END("refine");
+            if (info == 0) {
+                printf("Converged after %d refinement step(s), backward error %.3e.\n", rs.iterations, rs.backward_error);
+            } else {
+                if (info < 0) printf("Float factorization failed, using a double factorization instead.\n");
+                else printf("Refinement stalled after %d step(s) at backward error %.3e, using a double factorization instead.\n",
+                            rs.iterations, rs.backward_error);
+                PROF_BEGIN("fallback");
+                info = lapack_solve_d(la, &work, A, B, X, n_row, m_col, method == MIXED_CHOLESKY);
+                PROF_END("fallback");
+                if (info != 0) {
+                    fprintf(stderr, "ERROR: %s double factorization failed (info = %d).\n", la->name, info);
+                    solve_success = 0;
+                }
+            }
+        }
+
+    } else if (method == PCG_SPARSE) {
+
+        if (!have_csr) { // dense input: drop the zeros
+            PROF_BEGIN("convert");
+            if (dmatrix_to_csr(A, n_row, n_row, &csr) != 0) { nrerror("Error converting A to CSR"); }
+            PROF_END("convert");
+            have_csr = 1;
+        }
+        printf("\nAttempting Preconditioned Conjugate Gradients (Double, %ld entries)...\n", csr.nnz);
+        PROF_BEGIN("symmetry");
+        symmetric = csr_is_symmetric(&csr, TOL_DOUBLE);
+        PROF_END("symmetry");
+        if (!symmetric) {
+            fprintf(stderr, "ERROR: Matrix A is not symmetric. PCG cannot be used.\n");
+            solve_success = 0;
+        } else {
+            printf("Matrix appears symmetric. Proceeding with tol %.1e, at most %d iterations.\n", pcg_tol, pcg_maxit);
+            b_col = arena_dvector(&work, n_row);
+            x_col = arena_dvector(&work, n_row);
+            ps.history = arena_dvector(&work, (long)pcg_maxit + 1);
+            for (l = 0; l < m_col && solve_success; l++) {
+                for (k = 0; k < n_row; k++) { b_col[k] = B[k][l]; x_col[k] = 0.0; }
+                PROF_BEGIN("solve");
+                info = pcg_solve(&csr, b_col, x_col, pc, pcg_tol, pcg_maxit, &ps);
+                PROF_END("solve");
+                if (info < 0) { solve_success = 0; break; }
+                printf("  Column %d: %s after %d iterations (%s), ||r||/||b|| = %.3e\n", l,
+                       info == 0 ? "converged" : "NOT converged", ps.iterations,
+                       ps.precond == PRECOND_IC0 ? "IC(0)" : ps.precond == PRECOND_JACOBI ? "Jacobi" : "no preconditioner",
+                       ps.residual);
+                print_pcg_history(&ps);
+                if (info != 0) solve_success = 0;
+                for (k = 0; k < n_row; k++) X[k][l] = x_col[k];
+            }
         }
 
     } else { // GJ
         // allocate float augmented matrix based on actual size n
-         Aug = matrix(n_row,  n_row + 1);
+         Aug = arena_matrix(&work, n_row,  n_row + m_col);
 
          printf("\nAttempting Gauss-Jordan Elimination (Float)...\n");
          // Copy double input to float Aug matrix
+         PROF_BEGIN("convert");
          for (k = 0; k < n_row; k++) {
              for (l = 0; l < n_row; l++) { Aug[k][l] = (float)A[k][l]; }
-             Aug[k][n_row] = (float)b[k];
+             for (l = 0; l < m_col; l++) { Aug[k][n_row + l] = (float)B[k][l]; }
          }
+         PROF_END("convert");
          // print_nr_matrix(Aug, 1, n, 1, n + 1, "Initial Aug (Float)");
 
-         gauss_jordan_partial(Aug, n_row); // Modifies Aug
+         PROF_BEGIN("eliminate");
+         gauss_jordan_parallel(Aug, n_row, m_col, nthreads); // Modifies Aug
+         PROF_END("eliminate");
 
          printf("Gauss-Jordan complete.\n");
          // print_nr_matrix(Aug, 1, n, 1, n + 1, "Final Aug (Float)");
 
-         // extract solution x (convert float result back to double)
+         // extract solution X (convert float result back to double)
          for (k = 0; k < n_row; k++) {
-             x[k] = (double)Aug[k][n_row];
+             for (l = 0; l < m_col; l++) { X[k][l] = (double)Aug[k][n_row + l]; }
          }
-         // free float augmented matrix
-         free_matrix(Aug); Aug = NULL;
     } // end of solver methods
 
     //  print and verify solution
     if (solve_success) {
-         //print_nr_dvector(x, 1, n, "Solution x (Double)"); 
-         printf("Verifying solution (Calculating A * x)...\n");
-         for (k = 0; k < n_row; k++) { 
-             check[k] = 0.0;
-             for (j = 0; j < n_row; j++) { check[k] += A[k][j] * x[j]; }
-         }
-         //print_nr_dvector(check, 1, n, "Calculated A*x (Double)"); 
-         printf("Comparing A*x with original b:\n");
-         int errors = 0;
-         for (k = 0; k < n_row; k++) {
-              if (fabs(check[k] - b[k]) > TOL_FLOAT) { 
-                  printf("  Mismatch at index [%d]: Expected %.6e, Got %.6e (Diff: %.4e)\n",
-                         k, b[k], check[k], check[k] - b[k]); errors++;
-              }
-         }
-         if (errors == 0) { printf("  Verification successful (within tolerance %.1e).\n", TOL_DOUBLE); }
-         else { printf("  Verification FAILED with %d mismatches.\n", errors); }
+         print_dmatrix(X, n_row, m_col, "Solution X");
+         PROF_BEGIN("output");
+         solfile_write_d(output_path, input_filename, oformat, append, X, n_row, m_col);
+         PROF_END("output");
+         // the float solvers are held to float accuracy, PCG to its own stopping tolerance
+         if (method == GAUSS_JORDAN || method == CHOLESKY_PRIMITIVE || method == LU_PRIMITIVE) vtol = verify_tol(n_row, FLT_EPSILON);
+         else vtol = verify_tol(n_row, DBL_EPSILON);
+         if (method == PCG_SPARSE && pcg_tol > vtol) vtol = pcg_tol;
+         printf("Verifying solution (Calculating A * X)...\n");
+         PROF_BEGIN("verify");
+         if (have_csr) verify_csr(&csr, B, X, m_col, vmode, vtol, &vr); // same product, sparse
+         else verify_d(A, B, X, n_row, m_col, vmode, vtol, 0, &vr);
+         PROF_END("verify");
+         verify_print(&vr, vmode, vtol);
     } else {
          printf("\nSkipping verification due to solver incompatibility or failure.\n");
     }
 
   
     printf("Freeing memory...\n");
-    free_dmatrix(A); 
-    free_dvector(b); 
-    free_dvector(x);       
-    free_dvector(check); 
+    if (A != NULL) free_dmatrix(A); // a view into the mapping only drops its row pointers
+    if (have_csr) free_csr(&csr);
+    if (binary) matfile_close(&mf);
+    free_dmatrix(B); 
+    free_dmatrix(X);       
+    arena_free(&work); // every working copy above
 
     printf("Done.\n");
     return 0;
@@ -2,142 +2,604 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h> 
+#include <float.h>
+#include <unistd.h>
 #include "primitives.h"   
 #include "util.h"
+#include "matfile.h"
+#include "datfile.h"
+#include "pipeline.h"
+#include "generator.h"
+#include "verify.h"
+#include "solfile.h"
+#include "banded.h"
+#include "batch.h"
 
-#define MAX_SIZE 20       // Max N dimension
-#define MAXSTR 80
-#define TOL 1.0e-6  // Tolerance for verification
-#define TOL_DOUBLE 1.0e-9
 
 
 // define solver method
-typedef enum { GAUSS_JORDAN, CHOLESKY } SolverMethod;
+typedef enum { GAUSS_JORDAN, CHOLESKY, LU } SolverMethod;
+
+
+// shared by the streaming callbacks
+typedef struct {
+    SolverMethod method;
+    int nthreads;   // Gauss-Jordan threads inside each worker
+    verify_mode vmode;
+    int packed;     // Cholesky on the packed lower triangle, see pipeline_run()
+    int band;       // narrow-band systems go to the band solvers, see banded.h
+    solfile out;    // every system goes to one indexed file
+    int out_open;
+} StreamContext;
+
+
+// solve one system of the stream with working copies from the worker's arena (runs on a worker thread)
+static int stream_solve(pipe_system *sys, void *arg) {
+    StreamContext *ctx = arg;
+    int n = sys->n, m = sys->m, k, l, info = 0;
+    float **W;
+    verify_result vr;
+    int *perm;
+    band_info bi;
+    band_path path = BAND_DENSE;
+
+    if (ctx->method == CHOLESKY && !(ctx->packed ? sys->symmetric : is_symmetric(sys->A, n))) return 1; // packed: checked while reading
+    if (ctx->band) {
+        band_detect(sys->A, n, ctx->method == CHOLESKY, &bi);
+        path = band_choose(&bi, n, ctx->method == CHOLESKY);
+    }
+
+    if (path != BAND_DENSE) {
+        info = band_solve(sys->A, sys->B, sys->X, n, m, path, &bi, sys->work);
+        if (info != 0) return info;
+    } else if (ctx->method == CHOLESKY && ctx->packed) {
+        W = arena_tri_matrix(sys->work, n);
+        memcpy(W[0], sys->A[0], (size_t)n * (n + 1) / 2 * sizeof(float));
+        if (cholesky_packed(W, n) != 0) return 1;
+        cholesky_solve_multi(W, sys->B, sys->X, n, m);
+    } else if (ctx->method == CHOLESKY) {
+        W = arena_matrix(sys->work, n, n);
+        for (k = 0; k < n; k++) for (l = 0; l < n; l++) W[k][l] = sys->A[k][l];
+        if (cholesky_factor(W, n) != 0) return 1;
+        cholesky_solve_multi(W, sys->B, sys->X, n, m);
+    } else if (ctx->method == LU) {
+        W = arena_matrix(sys->work, n, n);
+        perm = arena_ivector(sys->work, n);
+        for (k = 0; k < n; k++) for (l = 0; l < n; l++) W[k][l] = sys->A[k][l];
+        info = lu_factor(W, n, perm);
+        if (info != 0) return info;
+        lu_solve_multi(W, perm, sys->B, sys->X, n, m);
+    } else {
+        W = arena_matrix(sys->work, n, n + m);
+        for (k = 0; k < n; k++) {
+            for (l = 0; l < n; l++) { W[k][l] = sys->A[k][l]; }
+            for (l = 0; l < m; l++) { W[k][n + l] = sys->B[k][l]; }
+        }
+        info = gauss_jordan_parallel_info(W, n, m, ctx->nthreads);
+        if (info != 0) return info;
+        for (k = 0; k < n; k++) for (l = 0; l < m; l++) sys->X[k][l] = W[k][n + l];
+    }
+
+    // verification, same tolerance as the single-system path; one thread, the workers fill the cores
+    if (ctx->packed) verify_sym(sys->A, sys->B, sys->X, n, m, ctx->vmode, verify_tol(n, FLT_EPSILON), &vr);
+    else verify(sys->A, sys->B, sys->X, n, m, ctx->vmode, verify_tol(n, FLT_EPSILON), 1, &vr);
+    sys->errors = !vr.passed;
+    return 0;
+}
+
+// write one finished system (runs on the writer thread, in file order)
+static void stream_emit(const pipe_system *sys, void *arg) {
+    StreamContext *ctx = arg;
+
+    if (sys->status == 0 && ctx->out_open) solfile_add(&ctx->out, sys->X, sys->n, sys->m, sys->index);
+    printf("System %ld: N=%d M=%d  read %.3f ms  solve %.3f ms  (%.1f systems/s)  %s\n",
+           sys->index, sys->n, sys->m, 1.0e3 * sys->t_read, 1.0e3 * sys->t_solve,
+           (sys->t_solve > 0.0) ? 1.0 / sys->t_solve : 0.0,
+           (sys->status != 0) ? "solver FAILED" : (sys->errors > 0) ? "verification FAILED" : "verified");
+}
+
+// solve every system in a text .dat file through the read / solve / write pipeline
+static int run_stream(const char *input_filename, SolverMethod method, int packed, int band, int nthreads, int nworkers, verify_mode vmode,
+                      const char *output_path, sol_format oformat, int append) {
+    StreamContext ctx;
+    pipe_stats stats;
+    datfile df;
+    int status;
+
+    if (matfile_is_binary(input_filename)) {
+        fprintf(stderr, "Error: Streaming needs a text .dat file, binary files hold a single system.\n");
+        return -1;
+    }
+    if (datfile_open(input_filename, &df) != 0) return -1;
+    if (nworkers <= 0) nworkers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    ctx.method = method;
+    ctx.nthreads = (nthreads > 0) ? nthreads : 1; // the workers already keep the cores busy
+    ctx.vmode = vmode;
+    ctx.packed = packed;
+    ctx.band = band;
+    ctx.out_open = (solfile_open(&ctx.out, output_path, input_filename, oformat, append) == 0);
+
+    printf("\nStreaming systems from %s with %d worker(s)...\n", input_filename, nworkers);
+    PROF_BEGIN("stream"); // read, solve and write overlap, see the per-system lines
+    status = pipeline_run(&df, nworkers, 2 * nworkers + 2, packed, stream_solve, stream_emit, &ctx, &stats);
+    PROF_END("stream");
+    datfile_close(&df);
+    if (ctx.out_open && solfile_close(&ctx.out) == 0) printf("Solutions successfully written to %s.\n", ctx.out.path);
+
+    printf("\nProcessed %ld system(s), %ld failed, in %.3f s: %.1f systems/s.\n",
+           stats.systems, stats.failed, stats.seconds,
+           (stats.seconds > 0.0) ? (double)stats.systems / stats.seconds : 0.0);
+    return status;
+}
+
+
+/* solve every system in a text .dat file in batches of consecutive systems
+   with the same N and M, interleaved across SIMD lanes (see batch.h): no
+   per-system allocation, and the solver runs BATCH_LANES systems at once */
+/* one system too large for --batch, read and solved alone the way the
+   stream solves it. Returns 0 if it verified, 1 if it failed, -1 if it
+   could not be read. */
+static int batch_scalar(datfile *df, long index, StreamContext *ctx) {
+    arena work;
+    pipe_system sys;
+    double t0;
+    int n = df->n, m = df->m;
+
+    memset(&sys, 0, sizeof(sys));
+    arena_init(&work, arena_matrix_size(n, n, sizeof(float)) + 2 * arena_matrix_size(n, m, sizeof(float)));
+    sys.index = index;
+    sys.n = n;
+    sys.m = m;
+    sys.A = arena_matrix(&work, n, n);
+    sys.B = arena_matrix(&work, n, m);
+    sys.X = arena_matrix(&work, n, m);
+    sys.work = &work;
+
+    t0 = wall_time();
+    if (datfile_read(df, sys.A, sys.B) != 0) {
+        fprintf(stderr, "Error: Could not read system %ld, stopping.\n", index);
+        arena_free(&work);
+        return -1;
+    }
+    sys.t_read = wall_time() - t0;
+    t0 = wall_time();
+    sys.status = stream_solve(&sys, ctx);
+    sys.t_solve = wall_time() - t0;
+    stream_emit(&sys, ctx);
+    arena_free(&work);
+    return (sys.status != 0 || sys.errors > 0);
+}
+
+static int run_batch(const char *input_filename, SolverMethod method, int band, int nthreads, verify_mode vmode,
+                     const char *output_path, sol_format oformat, int append) {
+    datfile df;
+    StreamContext ctx = { method, nthreads, vmode, 0, band, { 0 }, 0 }; // for the systems above BATCH_MAX_N
+    arena work;
+    batch bt;
+    verify_result vr;
+    float **A, **B, **X;
+    int n, m, more = 1, status = 0, *rejected;
+    long first = 0, count, s, bad, failed = 0;
+    double t0, t_read, t_solve, t_start, solve_total = 0.0;
+
+    if (matfile_is_binary(input_filename)) {
+        fprintf(stderr, "Error: Batching needs a text .dat file, binary files hold a single system.\n");
+        return -1;
+    }
+    if (datfile_open(input_filename, &df) != 0) return -1;
+    ctx.out_open = (solfile_open(&ctx.out, output_path, input_filename, oformat, append) == 0);
+
+    printf("\nSolving systems from %s in batches of up to %d, %d per vector...\n", input_filename, BATCH_SYSTEMS, BATCH_LANES);
+    t_start = wall_time();
+    while (more == 1) {
+        n = df.n;
+        m = df.m;
+        if (n > BATCH_MAX_N) { // too large for a batch: on its own, then carry on
+            printf("System %ld has N=%d, above the batch limit %d: scalar path.\n", first, n, BATCH_MAX_N);
+            PROF_BEGIN("scalar");
+            bad = batch_scalar(&df, first, &ctx);
+            PROF_END("scalar");
+            if (bad < 0) { status = -1; break; }
+            first++;
+            failed += bad;
+            if ((more = datfile_next(&df)) < 0) status = -1;
+            continue;
+        }
+        arena_init(&work, arena_batch_size(n, m, BATCH_SYSTEMS) + arena_matrix_size(n, n, sizeof(float))
+                          + 2 * arena_matrix_size(n, m, sizeof(float)) + arena_matrix_size(1, BATCH_SYSTEMS, sizeof(int)));
+        arena_batch(&work, &bt, n, m, BATCH_SYSTEMS);
+        A = arena_matrix(&work, n, n);
+        B = arena_matrix(&work, n, m);
+        X = arena_matrix(&work, n, m);
+        rejected = arena_ivector(&work, BATCH_SYSTEMS);
+
+        // consecutive systems of the same size, up to a full batch
+        PROF_BEGIN("read");
+        t0 = wall_time();
+        for (count = 0; count < BATCH_SYSTEMS && more == 1 && df.n == n && df.m == m; count++) {
+            if (datfile_read(&df, A, B) != 0) {
+                fprintf(stderr, "Error: Could not read system %ld, stopping.\n", first + count);
+                status = -1;
+                more = -1;
+                break;
+            }
+            rejected[count] = (method == CHOLESKY && !is_symmetric(A, n));
+            batch_set(&bt, count, A, B);
+            if ((more = datfile_next(&df)) < 0) status = -1;
+        }
+        batch_resize(&bt, count);
+        t_read = wall_time() - t0;
+        PROF_END("read");
+
+        PROF_BEGIN("solve");
+        t0 = wall_time();
+        bad = (method == CHOLESKY) ? batch_cholesky_solve(&bt) : batch_gj_solve(&bt);
+        t_solve = wall_time() - t0;
+        PROF_END("solve");
+        solve_total += t_solve;
+
+        // same check and output as the stream, system by system
+        PROF_BEGIN("verify");
+        for (s = 0; s < count; s++) {
+            if (bt.info[s] != 0 || rejected[s]) {
+                bad += (bt.info[s] == 0);
+                continue;
+            }
+            batch_get(&bt, s, (vmode == VERIFY_NONE) ? NULL : A, (vmode == VERIFY_NONE) ? NULL : B, X);
+            verify(A, B, X, n, m, vmode, verify_tol(n, FLT_EPSILON), 1, &vr);
+            bad += !vr.passed;
+            if (ctx.out_open) solfile_add(&ctx.out, X, n, m, first + s);
+        }
+        PROF_END("verify");
+
+        printf("Systems %ld-%ld: N=%d M=%d  read %.3f ms  solve %.3f ms  (%.1f systems/s)  %ld failed\n",
+               first, first + count - 1, n, m, 1.0e3 * t_read, 1.0e3 * t_solve,
+               (t_solve > 0.0) ? (double)count / t_solve : 0.0, bad);
+        first += count;
+        failed += bad;
+        arena_free(&work);
+    }
+    datfile_close(&df);
+    if (ctx.out_open && solfile_close(&ctx.out) == 0) printf("Solutions successfully written to %s.\n", ctx.out.path);
+
+    t0 = wall_time() - t_start;
+    printf("\nProcessed %ld system(s), %ld failed, in %.3f s: %.1f systems/s (%.1f systems/s in the solver).\n",
+           first, failed, t0, (t0 > 0.0) ? (double)first / t0 : 0.0, (solve_total > 0.0) ? (double)first / solve_total : 0.0);
+    return status;
+}
 
 
 //  Main function modified 
 int main(int argc, char *argv[])
 {
 
-    int j, k, l;
+    int k, l;
     int n_row, m_col;
-    float **A, **Aug, **A_chol;  // matrices for A, Augmented, and Cholesky
-    float *b, *x, *check; // vectors for b, x, and check
-    char buffer[MAXSTR];
-    FILE *fp;
+    float **A, **Aug, **A_chol, **A_lu;  // matrices for A, Augmented, Cholesky and LU
+    float **B, **X; // right-hand sides and solutions, N x M
+    int *perm; // row permutation of the LU factors
     char *input_filename = NULL;
+    matfile mf; // binary input, see matfile.h
+    datfile df; // text input, see datfile.h
+    gen_spec gen; // -gen: system built in memory, see generator.h
+    int binary, generated = 0;
     SolverMethod method = GAUSS_JORDAN;
+    int nthreads = 0; // 0: let gauss_jordan_parallel() decide
+    int stream = 0, nworkers = 0; // -s: every system in the file, -w solver threads
+    int batched = 0; // --batch: every system in the file, BATCH_LANES at a time
+    int packed = 0, symmetric = 1; // --packed: A kept as its lower triangle, checked while reading
+    int band = 1; // --band=off: always the dense solvers
+    band_info bi;
+    band_path path = BAND_DENSE;
+    arena work; // every matrix of the system, sized once N and M are known
+    verify_mode vmode = VERIFY_FULL;
+    verify_result vr;
+    double vtol;
+    char *output_path = NULL; // -o, default <input>_solution.txt (.bin)
+    sol_format oformat = SOL_TEXT;
+    int append = 0;
+    verbosity vlevel = VERBOSITY_AUTO; // matrix printing, see util.h
 
     //  parse command line Arguments 
-     if (argc < 2) { /* TODO: Usage */ exit(EXIT_FAILURE); }
-
-     // check for optional flag -g or -c
-     if (argc > 2 && (strcmp(argv[1], "-c") == 0 || strcmp(argv[1], "-g") == 0)) {
-        /* TODO: parse command-line argument options*/
-     } 
-     else {
-         input_filename = argv[1]; 
-         if (argc > 2) fprintf(stderr, "Warning: Treating '%s' as filename. Use -g or -c flag.\n", argv[1]);
-     }
-
-
-    //  allocate memory for matrices vectors  
-    A = matrix(MAX_SIZE,  MAX_SIZE);
-    b = vector(MAX_SIZE);
-    x = vector(MAX_SIZE);
-    Aug = matrix(MAX_SIZE, MAX_SIZE + 1);
-    A_chol = matrix(MAX_SIZE, MAX_SIZE);
-    check = vector(MAX_SIZE);
-
-    //  open the specified input file 
-    printf("Input file: %s\n", input_filename);
-    printf("Using solver: %s\n", (method == CHOLESKY) ? "Cholesky" : "Gauss-Jordan");
-    if ((fp = fopen(input_filename, "r")) == NULL) { /* error */ nrerror("..."); }
-    printf("Successfully opened file.\n");
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s [-g | -c [--packed] | -lu] [-t <threads>] [-s [-w <workers>] | --batch] [--band=auto|off] [--verify=full|sampled|none] [--verbosity=quiet|summary|full] [-o <file>] [--output=text|binary] [--append] <matrix_data_file | -gen <spec>>\n", argv[0]);
+        fprintf(stderr, "  -g : Use Gauss-Jordan (default)\n");
+        fprintf(stderr, "  -c : Use Cholesky (symmetric positive definite A)\n");
+        fprintf(stderr, "  -lu: Use LU with partial pivoting (general A, factor once and solve)\n");
+        fprintf(stderr, "  -t : Threads for Gauss-Jordan (default: $GJ_NUM_THREADS, then $OMP_NUM_THREADS)\n");
+        fprintf(stderr, "  --packed: with -c, keep only the lower triangle of A (n(n+1)/2 floats), checked for symmetry while reading\n");
+        fprintf(stderr, "  -s : Stream every system in the file (default: the first one only)\n");
+        fprintf(stderr, "  -w : Solver threads when streaming (default: number of CPUs)\n");
+        fprintf(stderr, "  --batch: Solve every system in the file (-g or -c); runs of the same size N <= %d go %d per SIMD vector, larger systems one at a time\n", BATCH_MAX_N, BATCH_LANES);
+        fprintf(stderr, "  --band: detect the bandwidth after reading and solve narrow-band systems with band LU or band/skyline Cholesky (auto, default), or never (off)\n");
+        fprintf(stderr, "  --verify: backward error over all rows (default), %d sampled rows, or no check\n", VERIFY_SAMPLE_ROWS);
+        fprintf(stderr, "  -o, --output: solution file (default: <input>_solution.txt, .bin) in shortest round-trip text or the binary container;\n");
+        fprintf(stderr, "      with -s every system goes to this one file, indexed by system\n");
+        fprintf(stderr, "  --verbosity: matrices printed not at all, as norms and corners, or in full (default: full up to %d rows, summary above)\n", PRINT_FULL_MAX);
+        fprintf(stderr, "  --append: add to an existing solution file instead of replacing it\n");
+        fprintf(stderr, "  -gen: <trefethen|spd|diagdom|general>:<N>[,m=<M>][,cond=<c>][,seed=<s>] instead of a file\n");
+        exit(EXIT_FAILURE);
+    }
 
+    for (k = 1; k < argc; k++) {
+        if (strcmp(argv[k], "-c") == 0) {
+            method = CHOLESKY;
+        } else if (strcmp(argv[k], "-g") == 0) {
+            method = GAUSS_JORDAN;
+        } else if (strcmp(argv[k], "-lu") == 0) {
+            method = LU;
+        } else if (strcmp(argv[k], "-t") == 0 && k + 1 < argc) {
+            nthreads = atoi(argv[++k]);
+        } else if (strcmp(argv[k], "--packed") == 0) {
+            packed = 1;
+        } else if (strcmp(argv[k], "--band=auto") == 0 || strcmp(argv[k], "--band=off") == 0) {
+            band = (strcmp(argv[k] + 7, "auto") == 0);
+        } else if (strcmp(argv[k], "-s") == 0) {
+            stream = 1;
+        } else if (strcmp(argv[k], "--batch") == 0) {
+            batched = 1;
+        } else if (strcmp(argv[k], "-w") == 0 && k + 1 < argc) {
+            nworkers = atoi(argv[++k]);
+        } else if (strncmp(argv[k], "--verify=", 9) == 0) {
+            if (verify_parse(argv[k] + 9, &vmode) != 0) fprintf(stderr, "Warning: Unknown verification '%s'. Using full.\n", argv[k] + 9);
+        } else if (strncmp(argv[k], "--output=", 9) == 0) {
+            if (solfile_parse_format(argv[k] + 9, &oformat) != 0) fprintf(stderr, "Warning: Unknown output format '%s'. Using text.\n", argv[k] + 9);
+        } else if (strncmp(argv[k], "--verbosity=", 12) == 0) {
+            if (verbosity_parse(argv[k] + 12, &vlevel) != 0) fprintf(stderr, "Warning: Unknown verbosity '%s'. Using auto.\n", argv[k] + 12);
+        } else if (strcmp(argv[k], "--append") == 0) {
+            append = 1;
+        } else if (strcmp(argv[k], "-o") == 0 && k + 1 < argc) {
+            output_path = argv[++k];
+        } else if (strcmp(argv[k], "-gen") == 0 && k + 1 < argc) {
+            if (gen_parse(argv[++k], &gen) != 0) { nrerror("Invalid generator spec."); }
+            generated = 1;
+            input_filename = gen.name; // names the solution file
+        } else if (argv[k][0] == '-') {
+            fprintf(stderr, "Warning: Unrecognized flag '%s' ignored.\n", argv[k]);
+        } else if (input_filename == NULL) {
+            input_filename = argv[k];
+        } else {
+            fprintf(stderr, "Warning: Extra argument '%s' ignored.\n", argv[k]);
+        }
+    }
+    if (input_filename == NULL) { nrerror("Missing matrix data file."); }
+    set_verbosity(vlevel);
+#ifndef _OPENMP
+    if (nthreads > 1 && method == GAUSS_JORDAN && !batched) {
+        fprintf(stderr, "Warning: this build has no OpenMP, -t ignored for Gauss-Jordan (see make omp).\n");
+    }
+#endif
+    if (packed && method != CHOLESKY) {
+        fprintf(stderr, "Warning: --packed only applies to Cholesky (-c), ignored.\n");
+        packed = 0;
+    }
 
-    if (fgets(buffer, MAXSTR, fp) == NULL) { /* Todo: Handle error */ }
-    if (fgets(buffer, MAXSTR, fp) == NULL) { /* Todo: Handle error */ }
+    if (stream && generated) { nrerror("Streaming needs a .dat file, -gen makes a single system."); }
+    if (batched && generated) { nrerror("Batching needs a .dat file, -gen makes a single system."); }
+    if (batched) {
+        if (method == LU) {
+            fprintf(stderr, "Warning: --batch solves general systems by Gauss-Jordan, -lu ignored.\n");
+            method = GAUSS_JORDAN;
+        }
+        if (packed || stream) fprintf(stderr, "Warning: --batch reads full matrices one at a time, --packed and -s ignored.\n");
+        printf("Input file: %s\n", input_filename);
+        printf("Using solver: batched %s\n", (method == CHOLESKY) ? "Cholesky" : "Gauss-Jordan");
+        return (run_batch(input_filename, method, band, nthreads, vmode, output_path, oformat, append) == 0) ? 0 : EXIT_FAILURE;
+    }
+    if (stream) {
+        printf("Input file: %s\n", input_filename);
+        printf("Using solver: %s\n", (method == CHOLESKY) ? "Cholesky" : (method == LU) ? "LU" : "Gauss-Jordan");
+        return (run_stream(input_filename, method, packed, band, nthreads, nworkers, vmode, output_path, oformat, append) == 0) ? 0 : EXIT_FAILURE;
+    }
 
 
-    // process the system 
-    printf("\nStarting to read systems from file...\n");
-    if(fscanf(fp, "%d %d", &n_row, &m_col) != 2) {}
+    //  open the specified input file 
+    printf(generated ? "Generated system: %s\n" : "Input file: %s\n", input_filename);
+    printf("Using solver: %s\n", (method == CHOLESKY) ? "Cholesky" : (method == LU) ? "LU" : "Gauss-Jordan");
+    PROF_BEGIN("input");
+    binary = !generated && matfile_is_binary(input_filename);
+    if (generated) {
+        n_row = (int)gen.n;
+        m_col = (int)gen.m;
+    } else if (binary) {
+        // binary container: dimensions and data come straight from the mapping, nothing to parse
+        if (matfile_open(input_filename, &mf) != 0) { nrerror("Error opening binary matrix file"); }
+        printf("Successfully mapped binary file.\n");
+        printf("\nStarting to read systems from file...\n");
+        n_row = (int)mf.hdr.n;
+        m_col = (int)mf.hdr.m;
+    } else {
+        // text .dat file: mapped and parsed in one pass after the dimensions are known
+        if (datfile_open(input_filename, &df) != 0) { nrerror("Error opening matrix file"); }
+        printf("Successfully opened file.\n");
+
+        // process the system 
+        printf("\nStarting to read systems from file...\n");
+        n_row = df.n;
+        m_col = df.m;
+    }
 
     //  validation and header consumption for A and b 
-    if (n_row <= 0 || n_row > MAX_SIZE) { /* Todo: Handle validation */ }
-    if (m_col != 1) { /* Todo: handle validation */ }
-    fgets(buffer, MAXSTR, fp); // consume rest of N M line
-    fgets(buffer, MAXSTR, fp); // consume header before A
+    if (n_row <= 0) { nrerror("Invalid dimension N."); }
+    if (m_col <= 0) { nrerror("Invalid number of right-hand sides M."); }
+
+    //  allocate the system from one block; the working copies follow once the band is known
+    arena_init(&work, (packed ? arena_tri_matrix_size(n_row, sizeof(float)) : arena_matrix_size(n_row, n_row, sizeof(float)))
+                      + 2 * arena_matrix_size(n_row, m_col, sizeof(float)));
+    A = packed ? arena_tri_matrix(&work, n_row) : arena_matrix(&work, n_row, n_row);
+    // every method factors (or eliminates) A once for all M right-hand sides
+    B = arena_matrix(&work, n_row, m_col);
+    X = arena_matrix(&work, n_row, m_col);
 
     printf("\n--- Processing System (N=%d) from %s ---\n", n_row, input_filename);
-    printf("Reading Matrix A (%d x %d):\n", n_row, n_row);
-    for (k = 0; k < n_row; k++) { // 
-        for (l = 0; l < n_row; l++) {
-            if (fscanf(fp, "%f", &A[k][l]) != 1) { nrerror("Error reading matrix A");}
-            A_chol[k][l] = A[k][l]; // copy A
+    if (generated) {
+        printf("Generating Matrix A (%d x %d) and B (%d x %d) in memory.\n", n_row, n_row, n_row, m_col);
+        if ((packed ? gen_fill_lower(&gen, A, B) : gen_fill(&gen, A, B)) != 0) { nrerror("Error generating the system"); }
+    } else if (binary) {
+        printf("Copying Matrix A (%d x %d) and B (%d x %d) from the mapping:\n", n_row, n_row, n_row, m_col);
+        if (packed) symmetric = matfile_copy_sym(&mf, A);
+        else matfile_copy(&mf, MATFILE_A, A);
+        matfile_copy(&mf, MATFILE_B, B);
+        matfile_close(&mf);
+    } else {
+        printf("Reading Matrix A (%d x %d) and B (%d x %d)%s:\n", n_row, n_row, n_row, m_col, packed ? ", lower triangle of A only" : "");
+        if ((packed ? datfile_read_sym(&df, A, B, &symmetric) : datfile_read(&df, A, B)) != 0) { nrerror("Error reading matrices A and B"); }
+        if (datfile_next(&df) == 1) {
+            printf("Note: %s holds more systems, use -s to solve all of them.\n", input_filename);
         }
+        datfile_close(&df);
+    }
+    PROF_END("input");
+
+    // bandwidth and envelope in one pass: narrow bands skip the dense working copies
+    if (band) {
+        PROF_BEGIN("bandwidth");
+        band_detect(A, n_row, method == CHOLESKY, &bi);
+        path = band_choose(&bi, n_row, method == CHOLESKY);
+        PROF_END("bandwidth");
+        printf("Bandwidth: %d below and %d above the diagonal, envelope %ld entries: %s solver.\n",
+               bi.kl, bi.ku, bi.profile, band_path_name(path));
+    }
+    // only the working copy the method factors; Gauss-Jordan builds [A | B] in Aug below
+    A_chol = A_lu = Aug = NULL;
+    perm = NULL;
+    if (path == BAND_DENSE && packed) {
+        A_chol = arena_tri_matrix(&work, n_row);
+    } else if (path == BAND_DENSE && method == CHOLESKY) {
+        A_chol = arena_matrix(&work, n_row, n_row);
+    } else if (path == BAND_DENSE && method == LU) {
+        A_lu = arena_matrix(&work, n_row, n_row);
+        perm = arena_ivector(&work, n_row);
+    } else if (path == BAND_DENSE) {
+        Aug = arena_matrix(&work, n_row, n_row + m_col);
     }
-    fgets(buffer, MAXSTR, fp); // consume line after A
-    fgets(buffer, MAXSTR, fp); // consume header before b
 
-    printf("Reading Vector b (%d x 1):\n", n_row);
-    for (k = 0; k < n_row; k++) { // 
-        if (fscanf(fp, "%f", &b[k]) != 1) { nrerror("Error reading vector b");}
+    if (A_chol != NULL || A_lu != NULL) { // band_solve() copies the band itself
+        PROF_BEGIN("convert");
+        if (packed) {
+            memcpy(A_chol[0], A[0], (size_t)n_row * (n_row + 1) / 2 * sizeof(float)); // the rows are one block
+        } else {
+            float **W = (A_chol != NULL) ? A_chol : A_lu;
+            for (k = 0; k < n_row; k++) memcpy(W[k], A[k], (size_t)n_row * sizeof(float));
+        }
+        PROF_END("convert");
     }
 
-    print_matrix(A, n_row,  n_row, "Original A");
-    print_vector(b,  n_row, "Original b");
+    if (packed) print_tri_matrix(A, n_row, 1, "Original A");
+    else print_matrix(A, n_row,  n_row, "Original A");
+    print_matrix(B, n_row,  m_col, "Original B");
 
 
     // solve using selected method 
     int solve_success = 1;
-    if (method == CHOLESKY) {
+    if (path != BAND_DENSE) {
+        printf("\nAttempting %s...\n", band_path_name(path));
+        if (method == CHOLESKY && !(packed ? symmetric : is_symmetric(A, n_row))) { // packed: found while reading
+            fprintf(stderr, "ERROR: Matrix A is not symmetric. Cholesky method cannot be used.\n");
+            solve_success = 0;
+        } else {
+            PROF_BEGIN("band");
+            int info = band_solve(A, B, X, n_row, m_col, path, &bi, &work);
+            PROF_END("band");
+            if (info != 0) {
+                fprintf(stderr, "ERROR: Matrix A is %s (pivot %d). The %s solver cannot be used.\n",
+                        (method == CHOLESKY) ? "not positive definite" : "singular", info - 1, band_path_name(path));
+                solve_success = 0;
+            } else {
+                printf("Band solve complete (%s).\n", band_path_name(path));
+            }
+        }
+    } else if (method == CHOLESKY && packed) {
+        printf("\nAttempting Cholesky Decomposition on packed storage...\n");
+        if (!symmetric) { // found while reading
+            fprintf(stderr, "ERROR: Matrix A is not symmetric. Cholesky method cannot be used.\n");
+            solve_success = 0;
+        } else {
+            printf("Matrix is symmetric. Proceeding with Cholesky.\n");
+            PROF_BEGIN("factor");
+            int info = cholesky_packed(A_chol, n_row);
+            PROF_END("factor");
+            if (info != 0) {
+                fprintf(stderr, "ERROR: Matrix A is not positive definite (pivot %d). Cholesky method cannot be used.\n", info - 1);
+                solve_success = 0;
+            } else {
+                printf("Cholesky decomposition successful.\n");
+                print_tri_matrix(A_chol, n_row, 0, "Decomposed A (L factor)");
+                PROF_BEGIN("solve");
+                cholesky_solve_multi(A_chol, B, X, n_row, m_col);
+                PROF_END("solve");
+                printf("Cholesky solve complete.\n");
+            }
+        }
+    } else if (method == CHOLESKY) {
         printf("\nAttempting Cholesky Decomposition...\n");
-        if (!is_symmetric(A, n_row)) {
+        PROF_BEGIN("symmetry");
+        solve_success = is_symmetric(A, n_row);
+        PROF_END("symmetry");
+        if (!solve_success) {
             fprintf(stderr, "ERROR: Matrix A is not symmetric. Cholesky method cannot be used.\n");
             solve_success = 0; 
         } else {
             printf("Matrix is symmetric. Proceeding with Cholesky.\n");
 
+            PROF_BEGIN("factor");
             cholesky(A_chol, n_row); 
+            PROF_END("factor");
             printf("Cholesky decomposition successful.\n");
             print_matrix(A_chol, n_row, n_row, "Decomposed A (L factor)");
-            cholesky_solve(A_chol, b, x, n_row); // solve using decomposed matrix
+            PROF_BEGIN("solve");
+            cholesky_solve_multi(A_chol, B, X, n_row, m_col); // solve all columns using decomposed matrix
+            PROF_END("solve");
             printf("Cholesky solve complete.\n");
         }
+    } else if (method == LU) {
+        printf("\nAttempting LU Decomposition...\n");
+        PROF_BEGIN("factor");
+        int info = lu_factor(A_lu, n_row, perm); // swaps the row pointers of A_lu
+        PROF_END("factor");
+        if (info != 0) {
+            fprintf(stderr, "ERROR: Matrix A is singular (zero pivot in column %d). LU method cannot be used.\n", info - 1);
+            solve_success = 0;
+        } else {
+            printf("LU decomposition successful.\n");
+            print_matrix(A_lu, n_row, n_row, "Decomposed A (L\\U factors)");
+            PROF_BEGIN("solve");
+            lu_solve_multi(A_lu, perm, B, X, n_row, m_col); // all columns against the same factors
+            PROF_END("solve");
+            printf("LU solve complete.\n");
+        }
     } else { // Gauss-Jordan solver
 
             printf("\nAttempting Gauss-Jordan Elimination...\n");
             for (k = 0; k < n_row; k++) {
                 for (l = 0; l < n_row; l++) { Aug[k][l] = A[k][l]; }
-                Aug[k][n_row] = b[k];
+                for (l = 0; l < m_col; l++) { Aug[k][n_row + l] = B[k][l]; }
             }
-            print_matrix(Aug, n_row, n_row + 1, "Initial Augmented [A|b]");
-            gauss_jordan_partial(Aug, n_row); 
+            print_matrix(Aug, n_row, n_row + m_col, "Initial Augmented [A|B]");
+            PROF_BEGIN("eliminate");
+            gauss_jordan_parallel(Aug, n_row, m_col, nthreads); 
+            PROF_END("eliminate");
             printf("Gauss-Jordan complete.\n");
-            print_matrix(Aug, n_row, n_row + 1, "Final Augmented [I|x]");
-            for (k = 0; k < n_row; k++) { x[k] = Aug[k][n_row]; }
+            print_matrix(Aug, n_row, n_row + m_col, "Final Augmented [I|X]");
+            for (k = 0; k < n_row; k++) {
+                for (l = 0; l < m_col; l++) { X[k][l] = Aug[k][n_row + l]; }
+            }
     }
 
     //   verify solution 
     if (solve_success) {
-            print_vector(x,  n_row, "Solution x");
-            printf("Verifying solution (Calculating A * x)...\n");
-            for (k = 0; k < n_row; k++) {
-                check[k] = 0.0;
-                for (j = 0; j < n_row; j++) { check[k] += A[k][j] * x[j]; }
-            }
-            print_vector(check, n_row, "Calculated A*x");
-            printf("Comparing A*x with original b:\n");
-            int errors = 0;
-            for (k = 0; k < n_row; k++) {
-                if (fabs(check[k] - b[k]) > TOL) {
-                    printf("  Mismatch at index [%d]: ...\n", k); errors++;
-                }
-            }
-            if (errors == 0) { printf("  Verification successful...\n"); }
-            else { printf("  Verification FAILED...\n"); }
+            print_matrix(X,  n_row, m_col, "Solution X");
+            PROF_BEGIN("output");
+            solfile_write(output_path, input_filename, oformat, append, X, n_row, m_col);
+            PROF_END("output");
+            printf("Verifying solution (Calculating A * X)...\n");
+            PROF_BEGIN("verify");
+            vtol = verify_tol(n_row, FLT_EPSILON);
+            if (packed) verify_sym(A, B, X, n_row, m_col, vmode, vtol, &vr);
+            else verify(A, B, X, n_row, m_col, vmode, vtol, 0, &vr);
+            PROF_END("verify");
+            verify_print(&vr, vmode, vtol);
 
     } else {
             printf("\nSkipping verification for this system due to solver incompatibility or failure.\n");
@@ -147,22 +609,11 @@ int main(int argc, char *argv[])
 
 
 
-    if (!feof(fp)) {
-        fprintf(stderr, "Warning: File processing stopped before reaching end-of-file. Check file format near last processed system.\n");
-    }
-
-
-    fclose(fp);
     printf("File processing complete for %s.\n", input_filename);
 
     //  Free Memory 
     printf("Freeing memory...\n");
-    free_matrix(A);
-    free_vector(b);
-    free_vector(x);
-    free_matrix(Aug);
-    free_matrix(A_chol);
-    free_vector(check);
+    arena_free(&work);
 
     printf("Done.\n");
     return 0;
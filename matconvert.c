@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util.h"
+#include "matfile.h"
+#include "datfile.h"
+
+
+/* convert between the text .dat matrix format and the binary container:
+   text input is written as binary, binary input is written back as text */
+
+
+static void read_text(const char *path, double ***A, double ***B, int *n, int *m) {
+    datfile df;
+
+    if (datfile_open(path, &df) != 0) exit(EXIT_FAILURE);
+    *n = df.n;
+    *m = df.m;
+    *A = dmatrix(*n, *n);
+    *B = dmatrix(*n, *m);
+    if (datfile_read_d(&df, *A, *B) != 0) exit(EXIT_FAILURE);
+    datfile_close(&df);
+}
+
+
+static int write_text(const char *path, const char *source, double **A, double **B, int n, int m, int dtype) {
+    // enough digits for the values to survive the round trip
+    const char *fmt = (dtype == MATFILE_FLOAT32) ? " %.9g" : " %.17g";
+    FILE *fp;
+    int k, l;
+
+    if ((fp = fopen(path, "w")) == NULL) {
+        fprintf(stderr, "Error: Could not open '%s' for writing.\n", path);
+        return -1;
+    }
+    fprintf(fp, "Converted from %s\n", source);
+    fprintf(fp, "Converted Matrix System\n");
+    fprintf(fp, "%d %d\n", n, m);
+    fprintf(fp, "--- Matrix A (%dx%d) ---\n", n, n);
+    for (k = 0; k < n; k++) {
+        for (l = 0; l < n; l++) fprintf(fp, fmt, A[k][l]);
+        fprintf(fp, "\n");
+    }
+    fprintf(fp, "--- Vector b (%dx%d) ---\n", n, m);
+    for (k = 0; k < n; k++) {
+        for (l = 0; l < m; l++) fprintf(fp, fmt, B[k][l]);
+        fprintf(fp, "\n");
+    }
+    if (fclose(fp) != 0) {
+        fprintf(stderr, "Error: Failed writing '%s'.\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+    int k, n, m;
+    int dtype = MATFILE_FLOAT64, layout = MATFILE_ROW_MAJOR;
+    char *input_filename = NULL, *output_filename = NULL;
+    double **A, **B;
+    matfile mf;
+
+    for (k = 1; k < argc; k++) {
+        if (strcmp(argv[k], "-f32") == 0) dtype = MATFILE_FLOAT32;
+        else if (strcmp(argv[k], "-f64") == 0) dtype = MATFILE_FLOAT64;
+        else if (strcmp(argv[k], "-col") == 0) layout = MATFILE_COL_MAJOR;
+        else if (strcmp(argv[k], "-row") == 0) layout = MATFILE_ROW_MAJOR;
+        else if (input_filename == NULL) input_filename = argv[k];
+        else if (output_filename == NULL) output_filename = argv[k];
+        else fprintf(stderr, "Warning: Extra argument '%s' ignored.\n", argv[k]);
+    }
+    if (input_filename == NULL || output_filename == NULL) {
+        fprintf(stderr, "Usage: %s [-f32 | -f64] [-row | -col] <input> <output>\n", argv[0]);
+        fprintf(stderr, "  text input (.dat) is written as a binary matrix file, binary input as text\n");
+        fprintf(stderr, "  -f32/-f64 : element type of the binary file (default -f64)\n");
+        fprintf(stderr, "  -row/-col : storage order of the binary file (default -row)\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (matfile_is_binary(input_filename)) {
+        if (matfile_open(input_filename, &mf) != 0) exit(EXIT_FAILURE);
+        n = (int)mf.hdr.n;
+        m = (int)mf.hdr.m;
+        A = dmatrix(n, n);
+        B = dmatrix(n, m);
+        matfile_copy_d(&mf, MATFILE_A, A);
+        matfile_copy_d(&mf, MATFILE_B, B);
+        dtype = (int)mf.hdr.dtype;
+        matfile_close(&mf);
+
+        printf("Writing %s (text, N=%d M=%d)\n", output_filename, n, m);
+        if (write_text(output_filename, input_filename, A, B, n, m, dtype) != 0) exit(EXIT_FAILURE);
+    } else {
+        read_text(input_filename, &A, &B, &n, &m);
+
+        printf("Writing %s (binary %s %s, N=%d M=%d)\n", output_filename,
+               (dtype == MATFILE_FLOAT32) ? "float32" : "float64",
+               (layout == MATFILE_ROW_MAJOR) ? "row-major" : "column-major", n, m);
+        if (matfile_write(output_filename, A, B, n, m, dtype, layout) != 0) exit(EXIT_FAILURE);
+    }
+
+    free_dmatrix(A);
+    free_dmatrix(B);
+    return 0;
+}
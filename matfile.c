@@ -0,0 +1,278 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "util.h"
+#include "matfile.h"
+
+_Static_assert(sizeof(matfile_header) == 64, "matfile_header must stay 64 bytes");
+
+
+static size_t align_up(size_t x) {
+    return (x + MATFILE_ALIGN - 1) / MATFILE_ALIGN * MATFILE_ALIGN;
+}
+
+static size_t dtype_size(uint32_t dtype) {
+    return (dtype == MATFILE_FLOAT32) ? sizeof(float) : sizeof(double);
+}
+
+// rows x cols of the A or B block
+static void block_shape(const matfile *mf, int which, long *rows, long *cols) {
+    *rows = (long)mf->hdr.n;
+    *cols = (which == MATFILE_A) ? (long)mf->hdr.n : (long)mf->hdr.m;
+}
+
+
+// 1 if the file starts with MATFILE_MAGIC, 0 otherwise (including unreadable files)
+int matfile_is_binary(const char *path) {
+    char magic[8];
+    FILE *fp = fopen(path, "rb");
+    int is_binary = 0;
+
+    if (fp == NULL) return 0;
+    if (fread(magic, 1, sizeof(magic), fp) == sizeof(magic)) {
+        is_binary = (memcmp(magic, MATFILE_MAGIC, sizeof(magic)) == 0);
+    }
+    fclose(fp);
+    return is_binary;
+}
+
+
+/* map a binary matrix file and validate its header.
+   Returns 0 on success, -1 (with a message on stderr) otherwise. */
+int matfile_open(const char *path, matfile *mf) {
+    struct stat st;
+    size_t esize, size_a, size_b;
+    int fd;
+
+    memset(mf, 0, sizeof(*mf));
+    if ((fd = open(path, O_RDONLY)) < 0) {
+        fprintf(stderr, "Error: Could not open binary matrix file '%s'.\n", path);
+        return -1;
+    }
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(matfile_header)) {
+        fprintf(stderr, "Error: '%s' is too short for a binary matrix header.\n", path);
+        close(fd);
+        return -1;
+    }
+
+    // private writable mapping: a solver may factor A in place, pages are copied on first write
+    mf->map_size = (size_t)st.st_size;
+    mf->map = mmap(NULL, mf->map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps the file alive
+    if (mf->map == MAP_FAILED) {
+        fprintf(stderr, "Error: mmap failed for '%s'.\n", path);
+        mf->map = NULL;
+        return -1;
+    }
+    memcpy(&mf->hdr, mf->map, sizeof(matfile_header));
+
+    if (memcmp(mf->hdr.magic, MATFILE_MAGIC, sizeof(mf->hdr.magic)) != 0
+        || mf->hdr.version != MATFILE_VERSION
+        || (mf->hdr.dtype != MATFILE_FLOAT32 && mf->hdr.dtype != MATFILE_FLOAT64)
+        || (mf->hdr.layout != MATFILE_ROW_MAJOR && mf->hdr.layout != MATFILE_COL_MAJOR)
+        || mf->hdr.n <= 0 || mf->hdr.m <= 0) {
+        fprintf(stderr, "Error: '%s' has an invalid or unsupported binary matrix header.\n", path);
+        matfile_close(mf);
+        return -1;
+    }
+    if (mf->hdr.offset_a == 0) { // solfile.h: a record holds X only
+        fprintf(stderr, "Error: '%s' is a solution file without a matrix A.\n", path);
+        matfile_close(mf);
+        return -1;
+    }
+
+    // the solvers index with int, and n * n * esize must not wrap before the size check below
+    esize = dtype_size(mf->hdr.dtype);
+    if (mf->hdr.n > INT_MAX || mf->hdr.m > INT_MAX
+        || (size_t)mf->hdr.n > SIZE_MAX / (size_t)mf->hdr.n / esize
+        || (size_t)mf->hdr.m > SIZE_MAX / (size_t)mf->hdr.n / esize) {
+        fprintf(stderr, "Error: '%s' declares a system too large to address (N = %lld, M = %lld).\n", path,
+                (long long)mf->hdr.n, (long long)mf->hdr.m);
+        matfile_close(mf);
+        return -1;
+    }
+    size_a = (size_t)mf->hdr.n * (size_t)mf->hdr.n * esize;
+    size_b = (size_t)mf->hdr.n * (size_t)mf->hdr.m * esize;
+    if (mf->hdr.offset_a % MATFILE_ALIGN != 0 || mf->hdr.offset_b % MATFILE_ALIGN != 0
+        || mf->hdr.offset_a > mf->map_size || size_a > mf->map_size - mf->hdr.offset_a
+        || mf->hdr.offset_b > mf->map_size || size_b > mf->map_size - mf->hdr.offset_b) {
+        fprintf(stderr, "Error: '%s' is truncated or has misaligned data blocks.\n", path);
+        matfile_close(mf);
+        return -1;
+    }
+
+    mf->a = (char *)mf->map + mf->hdr.offset_a;
+    mf->b = (char *)mf->map + mf->hdr.offset_b;
+    return 0;
+}
+
+
+void matfile_close(matfile *mf) {
+    if (mf->map != NULL) munmap(mf->map, mf->map_size);
+    mf->map = NULL;
+    mf->a = mf->b = NULL;
+}
+
+
+// copy (and convert) the A or B block into a float matrix of matching shape
+void matfile_copy(const matfile *mf, int which, float **dst) {
+    const void *src = (which == MATFILE_A) ? mf->a : mf->b;
+    long rows, cols, i, j, idx;
+
+    block_shape(mf, which, &rows, &cols);
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < cols; j++) {
+            idx = (mf->hdr.layout == MATFILE_ROW_MAJOR) ? i * cols + j : j * rows + i;
+            dst[i][j] = (mf->hdr.dtype == MATFILE_FLOAT32) ? ((const float *)src)[idx]
+                                                          : (float)((const double *)src)[idx];
+        }
+    }
+}
+
+
+// copy (and convert) the A or B block into a double matrix of matching shape
+void matfile_copy_d(const matfile *mf, int which, double **dst) {
+    const void *src = (which == MATFILE_A) ? mf->a : mf->b;
+    long rows, cols, i, j, idx;
+
+    block_shape(mf, which, &rows, &cols);
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < cols; j++) {
+            idx = (mf->hdr.layout == MATFILE_ROW_MAJOR) ? i * cols + j : j * rows + i;
+            dst[i][j] = (mf->hdr.dtype == MATFILE_FLOAT32) ? (double)((const float *)src)[idx]
+                                                          : ((const double *)src)[idx];
+        }
+    }
+}
+
+
+// A[i][j] as float, any type and layout
+static float a_element(const matfile *mf, long i, long j) {
+    long n = (long)mf->hdr.n, idx = (mf->hdr.layout == MATFILE_ROW_MAJOR) ? i * n + j : j * n + i;
+    return (mf->hdr.dtype == MATFILE_FLOAT32) ? ((const float *)mf->a)[idx] : (float)((const double *)mf->a)[idx];
+}
+
+/* the lower triangle of A into the packed L (tri_matrix()), checking
+   |A[i][j] - A[j][i]| <= 1e-6 on the way like is_symmetric(). Returns 1 if
+   A is symmetric, 0 (with a message on stderr) at the first pair that is not. */
+int matfile_copy_sym(const matfile *mf, float **L) {
+    long n = mf->hdr.n, i, j;
+    float upper;
+
+    for (i = 0; i < n; i++) {
+        for (j = 0; j <= i; j++) {
+            L[i][j] = a_element(mf, i, j);
+            upper = a_element(mf, j, i);
+            if (fabs(L[i][j] - upper) > 1.0e-6) {
+                fprintf(stderr, "Symmetry Check Failed: A[%ld][%ld] (%.4f) != A[%ld][%ld] (%.4f)\n",
+                        j, i, upper, i, j, L[i][j]);
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+
+/* zero-copy row-pointer views straight into the mapping. They only exist when
+   the file already has the wanted element type and row-major layout; otherwise
+   NULL is returned and the caller falls back to matfile_copy*(). Release a view
+   with free_matrix()/free_dmatrix() before matfile_close(). */
+float **matfile_view(const matfile *mf, int which) {
+    long rows, cols;
+
+    if (mf->hdr.dtype != MATFILE_FLOAT32 || mf->hdr.layout != MATFILE_ROW_MAJOR) return NULL;
+    block_shape(mf, which, &rows, &cols);
+    return matrix_view((float *)((which == MATFILE_A) ? mf->a : mf->b), rows, cols);
+}
+
+double **matfile_dview(const matfile *mf, int which) {
+    long rows, cols;
+
+    if (mf->hdr.dtype != MATFILE_FLOAT64 || mf->hdr.layout != MATFILE_ROW_MAJOR) return NULL;
+    block_shape(mf, which, &rows, &cols);
+    return dmatrix_view((double *)((which == MATFILE_A) ? mf->a : mf->b), rows, cols);
+}
+
+// descriptor of a block as stored, any type and layout: nothing is copied
+mat_desc matfile_desc(const matfile *mf, int which) {
+    mat_desc d;
+
+    block_shape(mf, which, &d.rows, &d.cols);
+    d.data = (which == MATFILE_A) ? mf->a : mf->b;
+    d.layout = (mf->hdr.layout == MATFILE_COL_MAJOR) ? MAT_COL_MAJOR : MAT_ROW_MAJOR;
+    d.type = (mf->hdr.dtype == MATFILE_FLOAT32) ? MAT_FLOAT32 : MAT_FLOAT64;
+    d.ld = (d.layout == MAT_ROW_MAJOR) ? d.cols : d.rows;
+    return d;
+}
+
+
+// write one element block in the requested type and layout
+static int write_block(FILE *fp, double **M, long rows, long cols, int dtype, int layout) {
+    long i, j, outer = (layout == MATFILE_ROW_MAJOR) ? rows : cols;
+    long inner = (layout == MATFILE_ROW_MAJOR) ? cols : rows;
+    size_t esize = dtype_size(dtype);
+    char *line = malloc((size_t)inner * esize);
+
+    if (line == NULL) return -1;
+    for (i = 0; i < outer; i++) {
+        for (j = 0; j < inner; j++) {
+            double v = (layout == MATFILE_ROW_MAJOR) ? M[i][j] : M[j][i];
+            if (dtype == MATFILE_FLOAT32) ((float *)line)[j] = (float)v;
+            else ((double *)line)[j] = v;
+        }
+        if (fwrite(line, esize, (size_t)inner, fp) != (size_t)inner) { free(line); return -1; }
+    }
+    free(line);
+    return 0;
+}
+
+// pad the file with zeros up to the next MATFILE_ALIGN boundary
+static int pad_to_alignment(FILE *fp) {
+    static const char zeros[MATFILE_ALIGN] = {0};
+    long pos = ftell(fp);
+    size_t pad = align_up((size_t)pos) - (size_t)pos;
+    return (pos < 0 || fwrite(zeros, 1, pad, fp) != pad) ? -1 : 0;
+}
+
+
+/* write the system A (n x n), B (n x m) as a binary matrix file.
+   Returns 0 on success, -1 (with a message on stderr) otherwise. */
+int matfile_write(const char *path, double **A, double **B, long n, long m, int dtype, int layout) {
+    matfile_header hdr;
+    size_t esize = dtype_size(dtype);
+    FILE *fp;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, MATFILE_MAGIC, sizeof(hdr.magic));
+    hdr.version = MATFILE_VERSION;
+    hdr.dtype = (uint32_t)dtype;
+    hdr.layout = (uint32_t)layout;
+    hdr.n = n;
+    hdr.m = m;
+    hdr.offset_a = align_up(sizeof(matfile_header));
+    hdr.offset_b = align_up(hdr.offset_a + (size_t)n * n * esize);
+
+    if ((fp = fopen(path, "wb")) == NULL) {
+        fprintf(stderr, "Error: Could not open '%s' for writing.\n", path);
+        return -1;
+    }
+    if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1 || pad_to_alignment(fp) != 0
+        || write_block(fp, A, n, n, dtype, layout) != 0 || pad_to_alignment(fp) != 0
+        || write_block(fp, B, n, m, dtype, layout) != 0) {
+        fprintf(stderr, "Error: Failed writing binary matrix file '%s'.\n", path);
+        fclose(fp);
+        return -1;
+    }
+    if (fclose(fp) != 0) {
+        fprintf(stderr, "Error: Failed closing binary matrix file '%s'.\n", path);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,64 @@
+#ifndef MATFILE_H
+#define MATFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "util.h"
+
+/* Binary container for one system AX = B.
+
+   [ 64-byte header | A block (N x N) | B block (N x M) ]
+
+   Both blocks start on a MATFILE_ALIGN boundary and hold raw elements in the
+   native byte order, either all row-major or all column-major. The file is
+   mmap'd, so the solvers can use the data without parsing or copying it. */
+
+#define MATFILE_MAGIC "LAMATBIN"  // first 8 bytes of every binary file
+#define MATFILE_VERSION 1
+#define MATFILE_ALIGN 64
+
+enum { MATFILE_FLOAT32 = 1, MATFILE_FLOAT64 = 2 };        // dtype
+enum { MATFILE_ROW_MAJOR = 0, MATFILE_COL_MAJOR = 1 };    // layout
+enum { MATFILE_A = 0, MATFILE_B = 1 };                    // which block
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t dtype;
+    uint32_t layout;
+    uint32_t reserved;
+    int64_t n;          // rows (and columns) of A
+    int64_t m;          // columns of B
+    uint64_t offset_a;  // byte offsets from the start of the file
+    uint64_t offset_b;
+    uint8_t pad[8];     // up to 64 bytes
+} matfile_header;
+
+typedef struct {
+    matfile_header hdr;
+    void *map;          // the whole file, MAP_PRIVATE: writes stay in this process
+    size_t map_size;
+    void *a, *b;        // start of the A and B blocks inside map
+} matfile;
+
+int matfile_is_binary(const char *path);
+
+int matfile_open(const char *path, matfile *mf);
+
+void matfile_close(matfile *mf);
+
+void matfile_copy(const matfile *mf, int which, float **dst);
+
+void matfile_copy_d(const matfile *mf, int which, double **dst);
+
+int matfile_copy_sym(const matfile *mf, float **L);
+
+float **matfile_view(const matfile *mf, int which);
+
+double **matfile_dview(const matfile *mf, int which);
+
+mat_desc matfile_desc(const matfile *mf, int which);
+
+int matfile_write(const char *path, double **A, double **B, long n, long m, int dtype, int layout);
+
+#endif
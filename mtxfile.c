@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "sparse.h"
+#include "datfile.h"
+#include "mtxfile.h"
+
+#define MTX_BANNER "%%MatrixMarket"
+
+enum { MTX_GENERAL, MTX_SYMMETRIC, MTX_SKEW };
+
+
+static int is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static const char *skip_space(const char *p, const char *e) {
+    while (p < e && is_space(*p)) p++;
+    return p;
+}
+
+static const char *next_line(const char *p, const char *e) {
+    const char *q = memchr(p, '\n', (size_t)(e - p));
+    return (q == NULL) ? e : q + 1;
+}
+
+// a positive integer token; returns its end, or NULL
+static const char *parse_index(const char *p, const char *e, long *v) {
+    const char *start = p;
+    *v = 0;
+    for (; p < e && (unsigned)(*p - '0') < 10; p++) {
+        if (*v > (LONG_MAX - 9) / 10) return NULL;
+        *v = *v * 10 + (*p - '0');
+    }
+    return (p > start && (p == e || is_space(*p))) ? p : NULL;
+}
+
+
+// 1 if the file starts with the Matrix Market banner
+int mtxfile_is_matrix_market(const char *path) {
+    char banner[sizeof(MTX_BANNER) - 1];
+    FILE *fp = fopen(path, "rb");
+    int is_mtx = 0;
+
+    if (fp == NULL) return 0;
+    if (fread(banner, 1, sizeof(banner), fp) == sizeof(banner)) {
+        is_mtx = (strncasecmp(banner, MTX_BANNER, sizeof(banner)) == 0);
+    }
+    fclose(fp);
+    return is_mtx;
+}
+
+
+/* the entries after the size line, as coordinates: the mirrored triangle of
+   symmetric files is added here, explicit zeros of the array format dropped.
+   Returns the number of coordinates, or -1. */
+static long read_entries(const char *p, const char *end, const char *path, int coordinate, int pattern, int sym,
+                         long rows, long cols, long entries, int *ri, int *ci, double *vals) {
+    long i = 0, j = 0, k, nnz = 0;
+    double v;
+
+    if (!coordinate && sym == MTX_SKEW) i = 1; // array format walks the columns of the stored triangle
+    for (k = 0; k < entries; k++) {
+        p = skip_space(p, end);
+        if (coordinate) {
+            if ((p = parse_index(p, end, &i)) == NULL || (p = parse_index(skip_space(p, end), end, &j)) == NULL
+                || i < 1 || i > rows || j < 1 || j > cols) {
+                fprintf(stderr, "Error: Invalid row/column index in entry %ld of '%s'.\n", k + 1, path);
+                return -1;
+            }
+            i--;
+            j--;
+            p = skip_space(p, end);
+        }
+        v = 1.0;
+        if (!pattern && (p >= end || (p = datfile_parse_double(p, end, &v)) == NULL)) {
+            fprintf(stderr, "Error: Invalid or missing value in entry %ld of '%s'.\n", k + 1, path);
+            return -1;
+        }
+
+        if (coordinate || v != 0.0) {
+            ri[nnz] = (int)i; ci[nnz] = (int)j; vals[nnz++] = v;
+            if (sym != MTX_GENERAL && i != j) {
+                ri[nnz] = (int)j; ci[nnz] = (int)i; vals[nnz++] = (sym == MTX_SKEW) ? -v : v;
+            }
+        }
+        if (!coordinate && ++i == rows) {
+            j++;
+            i = (sym == MTX_GENERAL) ? 0 : (sym == MTX_SKEW) ? j + 1 : j;
+        }
+    }
+    if (skip_space(p, end) != end) fprintf(stderr, "Warning: Ignoring data after the last entry of '%s'.\n", path);
+    return nnz;
+}
+
+
+/* banner, comments and size line, then the entries, then CSR assembly */
+static int read_mtx(const char *map, const char *end, const char *path, csr_matrix *A) {
+    char line[256], banner[32], object[32], format[32], field[32], symmetry[32];
+    const char *p, *q, *e;
+    long rows, cols, entries, cap, nnz;
+    int coordinate, pattern, sym, status;
+    int *ri, *ci;
+    double *vals;
+    size_t len;
+
+    e = next_line(map, end);
+    len = (size_t)(e - map) < sizeof(line) - 1 ? (size_t)(e - map) : sizeof(line) - 1;
+    memcpy(line, map, len);
+    line[len] = '\0';
+    if (sscanf(line, "%31s %31s %31s %31s %31s", banner, object, format, field, symmetry) != 5
+        || strcasecmp(banner, MTX_BANNER) != 0 || strcasecmp(object, "matrix") != 0) {
+        fprintf(stderr, "Error: '%s' does not start with a Matrix Market matrix banner.\n", path);
+        return -1;
+    }
+    coordinate = (strcasecmp(format, "coordinate") == 0);
+    pattern = (strcasecmp(field, "pattern") == 0);
+    sym = (strcasecmp(symmetry, "symmetric") == 0) ? MTX_SYMMETRIC
+        : (strcasecmp(symmetry, "skew-symmetric") == 0) ? MTX_SKEW : MTX_GENERAL;
+    if ((!coordinate && strcasecmp(format, "array") != 0)
+        || (!pattern && strcasecmp(field, "real") != 0 && strcasecmp(field, "integer") != 0 && strcasecmp(field, "double") != 0)
+        || (pattern && !coordinate)
+        || (sym == MTX_GENERAL && strcasecmp(symmetry, "general") != 0)) {
+        fprintf(stderr, "Error: '%s' is a %s %s %s matrix, which is not supported.\n", path, format, field, symmetry);
+        return -1;
+    }
+
+    // comment lines start with '%'; the first other non-blank line holds the sizes
+    for (p = e; p < end; p = next_line(p, end)) {
+        for (q = p; q < end && (*q == ' ' || *q == '\t' || *q == '\r'); q++) ;
+        if (q < end && *q != '\n' && *q != '%') break;
+    }
+    if ((p = parse_index(skip_space(p, end), end, &rows)) == NULL
+        || (p = parse_index(skip_space(p, end), end, &cols)) == NULL
+        || (coordinate && (p = parse_index(skip_space(p, end), end, &entries)) == NULL)) {
+        fprintf(stderr, "Error: Could not read the size line of '%s'.\n", path);
+        return -1;
+    }
+    if (rows <= 0 || cols <= 0 || rows > INT_MAX || cols > INT_MAX || (sym != MTX_GENERAL && rows != cols)) {
+        fprintf(stderr, "Error: '%s' has invalid dimensions %ldx%ld.\n", path, rows, cols);
+        return -1;
+    }
+    if (!coordinate) { // stored values: all of them, or one triangle
+        entries = (sym == MTX_GENERAL) ? rows * cols : (sym == MTX_SYMMETRIC) ? rows * (rows + 1) / 2 : rows * (rows - 1) / 2;
+    }
+
+    cap = (sym != MTX_GENERAL) ? 2 * entries : entries;
+    if (cap < 1) cap = 1;
+    ri = malloc((size_t)cap * sizeof(int));
+    ci = malloc((size_t)cap * sizeof(int));
+    vals = malloc((size_t)cap * sizeof(double));
+    if (ri == NULL || ci == NULL || vals == NULL) {
+        fprintf(stderr, "Error: Out of memory reading %ld entries from '%s'.\n", entries, path);
+        status = -1;
+    } else if ((nnz = read_entries(p, end, path, coordinate, pattern, sym, rows, cols, entries, ri, ci, vals)) < 0) {
+        status = -1;
+    } else {
+        status = coo_to_csr(A, rows, cols, nnz, ri, ci, vals);
+    }
+    free(ri);
+    free(ci);
+    free(vals);
+    return status;
+}
+
+
+/* read a Matrix Market file into CSR; no dense copy is made here.
+   Returns 0 on success, -1 (with a message on stderr) otherwise. */
+int mtxfile_read(const char *path, csr_matrix *A) {
+    struct stat st;
+    char *map;
+    int fd, status;
+
+    memset(A, 0, sizeof(*A));
+    if ((fd = open(path, O_RDONLY)) < 0) {
+        fprintf(stderr, "Error: Could not open Matrix Market file '%s'.\n", path);
+        return -1;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        fprintf(stderr, "Error: Matrix Market file '%s' is empty.\n", path);
+        close(fd);
+        return -1;
+    }
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Error: mmap failed for '%s'.\n", path);
+        return -1;
+    }
+    madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    status = read_mtx(map, map + st.st_size, path, A);
+    munmap(map, (size_t)st.st_size);
+    return status;
+}
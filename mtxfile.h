@@ -0,0 +1,18 @@
+#ifndef MTXFILE_H
+#define MTXFILE_H
+
+#include "sparse.h"
+
+/* Matrix Market reader, straight into CSR.
+
+   %%MatrixMarket matrix <coordinate|array> <real|integer|pattern> <general|symmetric|skew-symmetric>
+
+   Symmetric and skew-symmetric files store one triangle; the other one is
+   filled in while reading. Pattern entries get the value 1. Complex and
+   hermitian files are rejected. */
+
+int mtxfile_is_matrix_market(const char *path);
+
+int mtxfile_read(const char *path, csr_matrix *A);
+
+#endif
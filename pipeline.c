@@ -0,0 +1,194 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "util.h"
+#include "pipeline.h"
+
+#define PIPE_MAX_WORKERS 256
+
+enum { SLOT_EMPTY, SLOT_READY, SLOT_SOLVING, SLOT_DONE };
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;   // any slot or counter changed, every waiter re-checks
+    pipe_system *slots;
+    arena *slot_mem;          // A, B and X of the system in each slot
+    int *state;
+    int depth;
+    long n_read;              // systems parsed so far; system k lives in slot k % depth
+    long next_solve;          // next system a worker picks up
+    long next_emit;           // next system the writer waits for
+    int reader_done;          // no more systems will be read
+    int read_error;
+    arena *work;              // one per worker, handed out by next_worker
+    int next_worker;
+    datfile *df;
+    int packed;               // A read by datfile_read_sym()
+    pipe_solve_fn solve;
+    void *ctx;
+} pipeline;
+
+
+static void *reader(void *arg) {
+    pipeline *pl = arg;
+    pipe_system *sys;
+    double t0;
+    int slot, more;
+
+    for (long k = 0; ; k++) {
+        // datfile_open() already positioned the file on the first system
+        if (k > 0 && (more = datfile_next(pl->df)) != 1) {
+            if (more < 0) pl->read_error = 1;
+            break;
+        }
+        slot = (int)(k % pl->depth);
+
+        // wait until the writer has released the slot; until n_read moves on it is ours
+        pthread_mutex_lock(&pl->lock);
+        while (pl->state[slot] != SLOT_EMPTY) pthread_cond_wait(&pl->changed, &pl->lock);
+        pthread_mutex_unlock(&pl->lock);
+
+        sys = &pl->slots[slot];
+        t0 = wall_time();
+        sys->index = k;
+        sys->n = pl->df->n;
+        sys->m = pl->df->m;
+        arena_reset(&pl->slot_mem[slot]);
+        if (pl->packed) sys->A = arena_tri_matrix(&pl->slot_mem[slot], sys->n);
+        else sys->A = arena_matrix(&pl->slot_mem[slot], sys->n, sys->n);
+        sys->B = arena_matrix(&pl->slot_mem[slot], sys->n, sys->m);
+        sys->X = arena_matrix(&pl->slot_mem[slot], sys->n, sys->m);
+        sys->status = sys->errors = 0;
+        sys->symmetric = -1;
+        if ((pl->packed ? datfile_read_sym(pl->df, sys->A, sys->B, &sys->symmetric)
+                        : datfile_read(pl->df, sys->A, sys->B)) != 0) {
+            fprintf(stderr, "Error: Could not read system %ld, stopping the stream.\n", k);
+            pl->read_error = 1;
+            break;
+        }
+        sys->t_read = wall_time() - t0;
+
+        pthread_mutex_lock(&pl->lock);
+        pl->state[slot] = SLOT_READY;
+        pl->n_read = k + 1;
+        pthread_cond_broadcast(&pl->changed);
+        pthread_mutex_unlock(&pl->lock);
+    }
+
+    pthread_mutex_lock(&pl->lock);
+    pl->reader_done = 1;
+    pthread_cond_broadcast(&pl->changed);
+    pthread_mutex_unlock(&pl->lock);
+    return NULL;
+}
+
+
+static void *worker(void *arg) {
+    pipeline *pl = arg;
+    pipe_system *sys;
+    arena *work;
+    double t0;
+    int slot;
+
+    pthread_mutex_lock(&pl->lock);
+    work = &pl->work[pl->next_worker++];
+    for (;;) {
+        while (pl->next_solve == pl->n_read && !pl->reader_done) pthread_cond_wait(&pl->changed, &pl->lock);
+        if (pl->next_solve == pl->n_read) break; // reader finished and everything is taken
+
+        slot = (int)(pl->next_solve++ % pl->depth);
+        pl->state[slot] = SLOT_SOLVING;
+        pthread_mutex_unlock(&pl->lock);
+
+        sys = &pl->slots[slot];
+        t0 = wall_time();
+        sys->work = work;
+        sys->status = pl->solve(sys, pl->ctx);
+        sys->t_solve = wall_time() - t0;
+        sys->work = NULL;
+        arena_reset(work);
+
+        pthread_mutex_lock(&pl->lock);
+        pl->state[slot] = SLOT_DONE;
+        pthread_cond_broadcast(&pl->changed);
+    }
+    pthread_mutex_unlock(&pl->lock);
+    return NULL;
+}
+
+
+/* run the reader, nworkers solver threads and the in-order writer (this
+   thread) over every system of df, starting with the one datfile_open()
+   found. Returns 0 if the whole file was read, -1 otherwise (the systems
+   read before the problem are still solved and emitted). */
+int pipeline_run(datfile *df, int nworkers, int depth, int packed,
+                 pipe_solve_fn solve, pipe_emit_fn emit, void *ctx, pipe_stats *stats) {
+    pipeline pl;
+    pthread_t reader_tid, worker_tid[PIPE_MAX_WORKERS];
+    pipe_system *sys;
+    double t0 = wall_time();
+    int t, slot;
+
+    if (nworkers < 1) nworkers = 1;
+    if (nworkers > PIPE_MAX_WORKERS) nworkers = PIPE_MAX_WORKERS;
+    if (depth < nworkers + 2) depth = nworkers + 2; // one being read, one being written, one per worker
+
+    pl.slots = malloc((size_t)depth * sizeof(pipe_system));
+    pl.state = calloc((size_t)depth, sizeof(int)); // all SLOT_EMPTY
+    pl.slot_mem = calloc((size_t)depth, sizeof(arena)); // empty arenas, they grow to the first system
+    pl.work = calloc((size_t)nworkers, sizeof(arena));
+    if (pl.slots == NULL || pl.state == NULL || pl.slot_mem == NULL || pl.work == NULL) nrerror("allocation failure in pipeline_run()");
+    pthread_mutex_init(&pl.lock, NULL);
+    pthread_cond_init(&pl.changed, NULL);
+    pl.depth = depth;
+    pl.n_read = pl.next_solve = pl.next_emit = 0;
+    pl.reader_done = pl.read_error = 0;
+    pl.next_worker = 0;
+    pl.df = df;
+    pl.packed = packed;
+    pl.solve = solve;
+    pl.ctx = ctx;
+    stats->systems = stats->failed = 0;
+
+    if (pthread_create(&reader_tid, NULL, reader, &pl) != 0) nrerror("Could not start the reader thread");
+    for (t = 0; t < nworkers; t++) {
+        if (pthread_create(&worker_tid[t], NULL, worker, &pl) != 0) nrerror("Could not start a worker thread");
+    }
+
+    // writer: emit in file order, whatever order the workers finish in
+    pthread_mutex_lock(&pl.lock);
+    for (;;) {
+        slot = (int)(pl.next_emit % depth);
+        while (!(pl.next_emit < pl.n_read && pl.state[slot] == SLOT_DONE)
+               && !(pl.reader_done && pl.next_emit == pl.n_read)) {
+            pthread_cond_wait(&pl.changed, &pl.lock);
+        }
+        if (pl.next_emit == pl.n_read) break;
+        pthread_mutex_unlock(&pl.lock);
+
+        sys = &pl.slots[slot];
+        stats->systems++;
+        if (sys->status != 0 || sys->errors > 0) stats->failed++;
+        emit(sys, ctx); // the slot's arena is reset when the reader reuses it
+
+        pthread_mutex_lock(&pl.lock);
+        pl.state[slot] = SLOT_EMPTY;
+        pl.next_emit++;
+        pthread_cond_broadcast(&pl.changed);
+    }
+    pthread_mutex_unlock(&pl.lock);
+
+    pthread_join(reader_tid, NULL);
+    for (t = 0; t < nworkers; t++) pthread_join(worker_tid[t], NULL);
+    stats->seconds = wall_time() - t0;
+
+    pthread_cond_destroy(&pl.changed);
+    pthread_mutex_destroy(&pl.lock);
+    for (t = 0; t < depth; t++) arena_free(&pl.slot_mem[t]);
+    for (t = 0; t < nworkers; t++) arena_free(&pl.work[t]);
+    free(pl.slots);
+    free(pl.slot_mem);
+    free(pl.work);
+    free(pl.state);
+    return pl.read_error ? -1 : 0;
+}
@@ -0,0 +1,43 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "datfile.h"
+#include "util.h"
+
+/* Streaming over every system of a text .dat file.
+
+   reader thread    parses system k+1 into the next free slot
+   worker threads   solve whichever parsed system comes next
+   calling thread   emits finished systems strictly in file order, then
+                    frees them and hands the slot back to the reader
+
+   At most `depth` systems are in flight, so memory stays bounded however
+   long the file is. With packed set, A is read by datfile_read_sym() into
+   a packed lower triangle (tri_matrix()) and checked for symmetry on the
+   way. Each slot and each worker owns an arena that is reset, not freed,
+   between systems, so a steady stream stops calling malloc. */
+
+typedef struct {
+    long index;             // position of the system in the file, from 0
+    int n, m;
+    float **A, **B, **X;    // A is N x N (packed: lower triangle), B and X are N x M, from the slot's arena
+    int symmetric;          // packed: whether A[i][j] matched A[j][i] while reading
+    arena *work;            // the worker's scratch, reset after the solve callback
+    int status;             // returned by the solve callback, 0 = solved
+    int errors;             // set by the solve callback, e.g. verification mismatches
+    double t_read, t_solve; // seconds
+} pipe_system;
+
+typedef int (*pipe_solve_fn)(pipe_system *sys, void *ctx);
+typedef void (*pipe_emit_fn)(const pipe_system *sys, void *ctx);
+
+typedef struct {
+    long systems;           // systems emitted
+    long failed;            // of those, with status != 0 or errors > 0
+    double seconds;         // wall time of the whole run
+} pipe_stats;
+
+int pipeline_run(datfile *df, int nworkers, int depth, int packed,
+                 pipe_solve_fn solve, pipe_emit_fn emit, void *ctx, pipe_stats *stats);
+
+#endif
@@ -1,8 +1,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <float.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include "util.h"
 #include "primitives.h"
+#include "kernels.h"
+#include "fixedsize.h"
 
 #define TOL 1.0e-6 
 #define TOL_DOUBLE 1.0e-9
@@ -12,24 +18,46 @@
 
 
 void gauss_jordan_partial(float **A, int N) {
+    gauss_jordan_multi(A, N, 1);
+}
+
+
+// the message and exit of every Gauss-Jordan entry point that does not return info
+static void gauss_jordan_check(int info) {
+    if (info != 0) {
+        fprintf(stderr,"gauss_jordan: Matrix is singular or nearly singular at pivot %d.\n", info - 1);
+        nrerror("gauss_jordan: Matrix is singular or nearly singular.");
+    }
+}
+
+void gauss_jordan_multi(float **A, int N, int M)
+/* Gauss-Jordan on the augmented N x (N+M) matrix [A|B]; on return the last M columns hold X */
+{
+    gauss_jordan_check(gauss_jordan_multi_info(A, N, M));
+}
+
+int gauss_jordan_multi_info(float **A, int N, int M)
+/* gauss_jordan_multi() that reports failure instead of exiting: returns 0, or
+   k+1 if the pivot of column k is (nearly) zero (A is left partly eliminated) */
+{
 
     int i, j, k, max_row;
     double pivot, factor; 
+    const gj_kernels *kern = gj_kernels_select(); // scalar, AVX2 or AVX-512 row kernels
+    const fixed_kernels *fk = fixed_kernels_for(N);
+
+    // small N: the kernel unrolled for this size, see fixedsize.h
+    if (fk != NULL && M <= fk->max_m) return fk->gj(A, M);
 
     for (i = 0; i < N; i++) { // Loop through pivot columns 1 to N
         // partial pivoting 
-        max_row = i;
-        for (k = i + 1; k < N; k++) {
-            if (fabs(A[k][i]) > fabs(A[max_row][i])) {
-                max_row = k;
-            }
-        }
+        max_row = kern->col_argmax(A, i, i, N);
 
 
         #ifndef MACRO_SWAP
         // Swap rows
         if (max_row != i) {
-            for (int j = 0; j <= N ; j++) {
+            for (int j = 0; j < N + M ; j++) {
                 double temp = A[i][j];
                 A[i][j] = A[max_row][j];
                 A[max_row][j] = temp;
@@ -40,20 +68,14 @@ void gauss_jordan_partial(float **A, int N) {
         #ifdef MACRO_SWAP
         /* Alternatively */
         if (max_row != i) 
-            for (j = 0; j<=N; j++) SWAP(A[i][j], A[max_row][j]);
+            for (j = 0; j < N + M; j++) SWAP(A[i][j], A[max_row][j]);
         #endif
 
         // normalisation 
         pivot = A[i][i];
-        if (fabs(pivot) < 1e-12) {
-            nrerror("gauss_jordan: Matrix is singular or nearly singular.");
-            fprintf(stderr,"gauss_jordan: Matrix is singular or nearly singular at pivot %d.\n", i);
-            exit(1); 
-        }
+        if (fabs(pivot) < 1e-12) return i + 1;
 
-        for (j = i; j <= N ; j++) {
-            A[i][j] /= pivot;
-        }
+        kern->row_div(A[i] + i, (float)pivot, N + M - i);
 
 
         // elimination 
@@ -62,11 +84,91 @@ void gauss_jordan_partial(float **A, int N) {
 
             factor = A[k][i]; // factor for row k, column i
 
-            for (j = i; j <= N ; j++) { 
-                A[k][j] -= factor * A[i][j];
+            kern->row_axpy(A[k] + i, A[i] + i, (float)factor, N + M - i);
+        }
+    }
+    return 0;
+}
+
+
+
+void gauss_jordan_parallel(float **A, int N, int M, int nthreads)
+/* gauss_jordan_multi() with the pivot search and the elimination of the
+   non-pivot rows split across OpenMP threads. nthreads <= 0 takes the count
+   from GJ_NUM_THREADS, then from the OpenMP runtime (OMP_NUM_THREADS). */
+{
+    gauss_jordan_check(gauss_jordan_parallel_info(A, N, M, nthreads));
+}
+
+int gauss_jordan_parallel_info(float **A, int N, int M, int nthreads)
+/* gauss_jordan_parallel() that returns like gauss_jordan_multi_info() */
+{
+#ifdef _OPENMP
+    int i, j, k, max_row = 0, singular = -1;
+    float *cand_val;
+    int *cand_row;
+    const gj_kernels *kern = gj_kernels_select();
+
+    if (nthreads <= 0) {
+        char *env = getenv("GJ_NUM_THREADS");
+        nthreads = (env != NULL) ? atoi(env) : omp_get_max_threads();
+    }
+    // below GJ_PARALLEL_MIN the fork/join and barriers cost more than the rows
+    if (nthreads <= 1 || N < GJ_PARALLEL_MIN) return gauss_jordan_multi_info(A, N, M);
+
+    cand_val = vector(nthreads);
+    cand_row = ivector(nthreads);
+
+    #pragma omp parallel num_threads(nthreads) private(i, j, k)
+    {
+        int tid = omp_get_thread_num();
+        int nth = omp_get_num_threads();
+
+        for (i = 0; i < N; i++) {
+            // partial pivoting as a max-loc reduction: each thread scans its chunk...
+            int my_row = -1;
+            float my_val = -1.0f;
+            #pragma omp for schedule(static) nowait
+            for (k = i; k < N; k++) {
+                if (fabsf(A[k][i]) > my_val) { my_val = fabsf(A[k][i]); my_row = k; }
+            }
+            cand_val[tid] = my_val;
+            cand_row[tid] = my_row;
+            #pragma omp barrier
+
+            #pragma omp single
+            {
+                // ...and the candidates are merged in thread order, so ties resolve to the first row
+                float best = -1.0f;
+                max_row = i;
+                for (int t = 0; t < nth; t++) {
+                    if (cand_row[t] >= 0 && cand_val[t] > best) { best = cand_val[t]; max_row = cand_row[t]; }
+                }
+                if (max_row != i)
+                    for (j = 0; j < N + M; j++) SWAP(A[i][j], A[max_row][j]);
+
+                if (fabs(A[i][i]) < 1e-12) singular = i;
+                else kern->row_div(A[i] + i, A[i][i], N + M - i);
+            } // implicit barrier: the pivot row is ready
+            if (singular >= 0) break;
+
+            // elimination, one independent row per iteration
+            #pragma omp for schedule(static)
+            for (k = 0; k < N; k++) {
+                if (k == i) continue; // skip pivot row
+                kern->row_axpy(A[k] + i, A[i] + i, A[k][i], N + M - i);
             }
         }
     }
+
+    free_vector(cand_val);
+    free_ivector(cand_row);
+
+    return singular + 1;
+#else
+    (void)nthreads; // built without OpenMP, see the omp make target
+    return gauss_jordan_multi_info(A, N, M);
+#endif
 }
 
 
@@ -85,6 +187,22 @@ int is_symmetric(float **a, int n) {
     return 1; // symmetric
 }
 
+/* is_symmetric() of a double A while its lower triangle goes into the packed
+   float L (tri_matrix()), one pass instead of a check and a copy */
+int pack_lower_d(double **A, float **L, int n) {
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j <= i; j++) {
+            L[i][j] = (float)A[i][j];
+            if (fabs(L[i][j] - (float)A[j][i]) > TOL) {
+                fprintf(stderr, "Symmetry Check Failed: A[%d][%d] (%.4f) != A[%d][%d] (%.4f)\n",
+                        j, i, A[j][i], i, j, A[i][j]);
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
 int is_symmetric_double(double **a, int n) {
     for (int i = 0; i < n; i++) {
        for (int j = i + 1; j < n; j++) {
@@ -97,11 +215,43 @@ int is_symmetric_double(double **a, int n) {
 
 
 
+static int cholesky_blocked_info(float **A, int n, int nb);
+
 void cholesky(float **A, int n)
 /* Cholesky decomposition of a symmetric positive-definite matrix */
+{
+    if (cholesky_factor(A, n) != 0) nrerror("Matrix is not positive-definite");
+}
+
+static void zero_upper(float **A, int n) {
+    for (int i = 0; i < n; i++) {
+        for (int j = i + 1; j < n; j++) A[i][j] = 0.0;
+    }
+}
+
+int cholesky_factor(float **A, int n)
+/* cholesky() that reports failure instead of exiting: returns 0, or k+1 if
+   the pivot of column k is not positive (A is left partly factored) */
+{
+    int info = cholesky_packed(A, n);
+
+    /* zero out the upper triangular part of the matrix for clarity */
+    if (info == 0) zero_upper(A, n);
+    return info;
+}
+
+int cholesky_packed(float **A, int n)
+/* the factorization itself, which reads and writes A[i][j] for j <= i only.
+   A may therefore be a packed lower triangle from tri_matrix(); on a full
+   matrix the upper triangle is left as it was. Returns like cholesky_factor(). */
 {
     int i, j, k;
     float sum;
+    const fixed_kernels *fk = fixed_kernels_for(n);
+
+    if (fk != NULL) return fk->cholesky(A);
+    // past a couple of tiles the unblocked loop is memory-bound, use the tiled kernel
+    if (n > 2 * CHOLESKY_BLOCK) return cholesky_blocked_info(A, n, CHOLESKY_BLOCK);
 
     for (i = 0; i < n; i++) {
         for (j = 0; j <= i; j++) {
@@ -111,7 +261,7 @@ void cholesky(float **A, int n)
         }
         if (i==j) {
             if (sum <= 0.0){
-                nrerror("Matrix is not positive-definite");
+                return i + 1;
             }
             A[i][i] = sqrt(sum);
         }
@@ -120,21 +270,129 @@ void cholesky(float **A, int n)
             }
         }
     }
+    return 0;
+}
 
-    /* zero out the upper triangular part of the matrix for clarity */
-    for (i = 0; i<n ; i++){
-        for (j=i+1; j<n ;j++){
-            A[i][j] = 0.0;
+
+#define TILE_MR 4   // register tile rows
+#define TILE_NR 16  // register tile columns, also the width of a packed group
+#define TILE_NC 256 // columns of the packed panel kept hot in L2 per sweep
+
+/* packed panels hold a b-wide block of rows (or columns) in groups of TILE_NR,
+   each group stored k-major and zero padded: element (idx, k) lives at */
+#define PACK_AT(p, b, idx, k) (p)[((size_t)((idx) / TILE_NR) * (b) + (k)) * TILE_NR + (idx) % TILE_NR]
+
+// compiled twice; the loader picks the AVX2 clone on CPUs that support it
+__attribute__((target_clones("avx2", "default")))
+static void update_tile(float **A, int off, const float *pa, const float *pb, int b,
+                        int i0, int j0, int m, int lower)
+/* A[off+i][off+j] -= sum_k pa(i, k) * pb(j, k) for one TILE_MR x TILE_NR register tile
+   of the m x m trailing matrix; lower != 0 leaves the strict upper triangle alone */
+{
+    float acc[TILE_MR][TILE_NR] = {{0.0f}};
+    const float *pi = &PACK_AT(pa, b, i0, 0);
+    const float *pj = &PACK_AT(pb, b, j0, 0);
+    int k, r, c;
+
+    for (k = 0; k < b; k++) {
+        for (r = 0; r < TILE_MR; r++) {
+            for (c = 0; c < TILE_NR; c++) acc[r][c] += pi[r] * pj[c];
+        }
+        pi += TILE_NR;
+        pj += TILE_NR;
+    }
+
+    for (r = 0; r < TILE_MR && i0 + r < m; r++) {
+        float *row = A[off + i0 + r] + off;
+        for (c = 0; c < TILE_NR && j0 + c < m; c++) {
+            if (lower && j0 + c > i0 + r) break;
+            row[j0 + c] -= acc[r][c];
         }
     }
 }
 
 
+void cholesky_blocked(float **A, int n, int nb)
+/* right-looking tiled Cholesky: on return the lower triangle holds L, as in cholesky() */
+{
+    if (cholesky_blocked_info(A, n, nb) != 0) nrerror("Matrix is not positive-definite");
+    zero_upper(A, n);
+}
+
+static int cholesky_blocked_info(float **A, int n, int nb)
+{
+    int i, j, k, kk, jj, b, m;
+    float sum;
+    float *pack, *row;
+
+    if (nb <= 0) nb = CHOLESKY_BLOCK;
+
+    // packed copy of the current panel L21, see update_tile()
+    pack = vector((long)(n + TILE_NR) * nb);
+
+    for (kk = 0; kk < n; kk += nb) {
+        b = (n - kk < nb) ? n - kk : nb;
+        m = n - kk - b;
+
+        // 1. factor the diagonal tile A11 = L11 * L11^T
+        for (i = kk; i < kk + b; i++) {
+            for (j = kk; j <= i; j++) {
+                sum = A[i][j];
+                for (k = kk; k < j; k++) sum -= A[i][k] * A[j][k];
+                if (i == j) {
+                    if (sum <= 0.0) {
+                        free_vector(pack);
+                        return i + 1;
+                    }
+                    A[i][i] = sqrt(sum);
+                } else {
+                    A[i][j] = sum / A[j][j];
+                }
+            }
+        }
+        if (m == 0) break;
+
+        // 2. panel triangular solve L21 = A21 * L11^-T, one contiguous row segment at a time
+        for (i = kk + b; i < n; i++) {
+            row = A[i];
+            for (j = kk; j < kk + b; j++) {
+                sum = row[j];
+                for (k = kk; k < j; k++) sum -= row[k] * A[j][k];
+                row[j] = sum / A[j][j];
+            }
+            for (k = 0; k < b; k++) PACK_AT(pack, b, i - kk - b, k) = row[kk + k];
+        }
+        for (i = m; i % TILE_NR != 0; i++) { // zero pad the last group
+            for (k = 0; k < b; k++) PACK_AT(pack, b, i, k) = 0.0f;
+        }
+
+        // 3. SYRK trailing update A22 -= L21 * L21^T on the lower triangle, sweeping
+        //    TILE_NC columns at a time so that slice of the pack stays in cache
+        for (jj = 0; jj < m; jj += TILE_NC) {
+            for (i = jj; i < m; i += TILE_MR) {
+                for (j = jj; j < jj + TILE_NC && j < m && j <= i + TILE_MR - 1; j += TILE_NR) {
+                    update_tile(A, kk + b, pack, pack, b, i, j, m, 1);
+                }
+            }
+        }
+    }
+    free_vector(pack);
+    return 0;
+}
+
+
 void cholesky_solve(float **A, float *b, float *x, int n)
 /* solve the system Ax = b using Cholesky decomposition */
 {
     int i, j;
     float sum;
+    const fixed_kernels *fk = fixed_kernels_for(n);
+
+    if (fk != NULL) {
+        if (x != b) for (i = 0; i < n; i++) x[i] = b[i];
+        fk->cholesky_solve(A, x);
+        return;
+    }
 
     // forward substitution to solve Ly = b
     for (i = 0; i < n; i++) {
@@ -156,3 +414,250 @@ void cholesky_solve(float **A, float *b, float *x, int n)
 }
 
 
+
+
+int lu_factor(float **A, int n, int *perm)
+/* LU decomposition with partial pivoting, PA = LU. Rows are exchanged by swapping
+   the row pointers of A, and perm[i] records which original row now sits at A[i].
+   L (unit diagonal, not stored) and U overwrite A. Returns 0 on success, or k+1
+   if the pivot in column k is (nearly) zero, like LAPACK's info. */
+{
+    int i, j, k, kk, jj, b, m, p;
+    float *pack_l, *pack_u, *tmp;
+    const gj_kernels *kern = gj_kernels_select();
+    int nb = LU_BLOCK;
+
+    for (i = 0; i < n; i++) perm[i] = i;
+
+    pack_l = vector((long)(n + TILE_NR) * nb);
+    pack_u = vector((long)(n + TILE_NR) * nb);
+
+    for (kk = 0; kk < n; kk += nb) {
+        b = (n - kk < nb) ? n - kk : nb;
+        m = n - kk - b;
+
+        // 1. factor the panel (all rows below kk, columns kk..kk+b) unblocked
+        for (k = kk; k < kk + b; k++) {
+            p = kern->col_argmax(A, k, k, n);
+            if (p != k) {
+                tmp = A[k]; A[k] = A[p]; A[p] = tmp;
+                j = perm[k]; perm[k] = perm[p]; perm[p] = j;
+            }
+            if (fabs(A[k][k]) < 1e-12) {
+                free_vector(pack_l);
+                free_vector(pack_u);
+                return k + 1;
+            }
+            for (i = k + 1; i < n; i++) {
+                A[i][k] /= A[k][k];
+                kern->row_axpy(A[i] + k + 1, A[k] + k + 1, A[i][k], kk + b - k - 1);
+            }
+        }
+        if (m == 0) break;
+
+        // 2. U12 = L11^-1 A12, whole contiguous rows to the right of the panel
+        for (i = kk + 1; i < kk + b; i++) {
+            for (j = kk; j < i; j++) kern->row_axpy(A[i] + kk + b, A[j] + kk + b, A[i][j], m);
+        }
+
+        // 3. GEMM trailing update A22 -= L21 * U12 from packed copies of both panels
+        for (i = 0; i < m || i % TILE_NR != 0; i++) {
+            for (k = 0; k < b; k++) PACK_AT(pack_l, b, i, k) = (i < m) ? A[kk + b + i][kk + k] : 0.0f;
+        }
+        for (k = 0; k < b; k++) {
+            for (j = 0; j < m || j % TILE_NR != 0; j++) PACK_AT(pack_u, b, j, k) = (j < m) ? A[kk + k][kk + b + j] : 0.0f;
+        }
+        for (jj = 0; jj < m; jj += TILE_NC) {
+            for (i = 0; i < m; i += TILE_MR) {
+                for (j = jj; j < jj + TILE_NC && j < m; j += TILE_NR) {
+                    update_tile(A, kk + b, pack_l, pack_u, b, i, j, m, 0);
+                }
+            }
+        }
+    }
+
+    free_vector(pack_l);
+    free_vector(pack_u);
+    return 0;
+}
+
+
+void lu_solve(float **A, int *perm, float *b, float *x, int n)
+/* solve the system Ax = b using the factors and permutation from lu_factor() */
+{
+    int i, j;
+    float sum;
+
+    // forward substitution to solve Ly = Pb (unit diagonal)
+    for (i = 0; i < n; i++) {
+        sum = b[perm[i]];
+        for (j = 0; j < i; j++) {
+            sum -= A[i][j] * x[j];
+        }
+        x[i] = sum;
+    }
+
+    // back substitution to solve Ux = y
+    for (i = n - 1; i >= 0; i--) {
+        sum = x[i];
+        for (j = i + 1; j < n; j++) {
+            sum -= A[i][j] * x[j];
+        }
+        x[i] = sum / A[i][i];
+    }
+}
+
+
+/* the multi-RHS solves sweep B in column blocks of RHS_BLOCK so the block of
+   X being updated stays in cache while the factor streams past it once */
+#define RHS_BLOCK 64
+
+void cholesky_solve_multi(float **A, float **B, float **X, int n, int m)
+/* solve AX = B for an n x m block B using the factor from cholesky() or
+   cholesky_packed(); only the lower triangle is read. B and X may alias */
+{
+    int i, j, c0, w;
+    const gj_kernels *kern = gj_kernels_select();
+    const fixed_kernels *fk = fixed_kernels_for(n);
+    float y[FIXED_KERNEL_MAX];
+
+    if (fk != NULL && m == 1) { // one column: the unrolled solve on a contiguous copy
+        for (i = 0; i < n; i++) y[i] = B[i][0];
+        fk->cholesky_solve(A, y);
+        for (i = 0; i < n; i++) X[i][0] = y[i];
+        return;
+    }
+
+    for (c0 = 0; c0 < m; c0 += RHS_BLOCK) {
+        w = (m - c0 < RHS_BLOCK) ? m - c0 : RHS_BLOCK;
+
+        // forward substitution LY = B, one row of the block at a time
+        for (i = 0; i < n; i++) {
+            float *xi = X[i] + c0;
+            if (X != B) for (j = 0; j < w; j++) xi[j] = B[i][c0 + j];
+            for (j = 0; j < i; j++) kern->row_axpy(xi, X[j] + c0, A[i][j], w);
+            kern->row_div(xi, A[i][i], w);
+        }
+
+        // back substitution L^T X = Y, column-oriented so L is read along its rows
+        for (i = n - 1; i >= 0; i--) {
+            float *xi = X[i] + c0;
+            kern->row_div(xi, A[i][i], w);
+            for (j = 0; j < i; j++) kern->row_axpy(X[j] + c0, xi, A[i][j], w);
+        }
+    }
+}
+
+
+void lu_solve_multi(float **A, int *perm, float **B, float **X, int n, int m)
+/* solve AX = B for an n x m block B using the factors from lu_factor(); X must not alias B */
+{
+    int i, j, c0, w;
+    const gj_kernels *kern = gj_kernels_select();
+
+    for (c0 = 0; c0 < m; c0 += RHS_BLOCK) {
+        w = (m - c0 < RHS_BLOCK) ? m - c0 : RHS_BLOCK;
+
+        // forward substitution LY = PB (unit diagonal)
+        for (i = 0; i < n; i++) {
+            float *xi = X[i] + c0;
+            for (j = 0; j < w; j++) xi[j] = B[perm[i]][c0 + j];
+            for (j = 0; j < i; j++) kern->row_axpy(xi, X[j] + c0, A[i][j], w);
+        }
+
+        // back substitution UX = Y
+        for (i = n - 1; i >= 0; i--) {
+            float *xi = X[i] + c0;
+            for (j = i + 1; j < n; j++) kern->row_axpy(xi, X[j] + c0, A[i][j], w);
+            kern->row_div(xi, A[i][i], w);
+        }
+    }
+}
+
+
+// R = B - A X, accumulated in double, one row of R at a time
+// R = B - AX accumulated in double (r: one row of it), rounded to float for the correction solve;
+// rmax gets ||b - Ax||_inf of every column before that rounding
+static void residual_double(double **A, double **B, double **X, double *r, double *rmax, float **R, int n, int m) {
+    int i, j, l;
+
+    for (l = 0; l < m; l++) rmax[l] = 0.0;
+    for (i = 0; i < n; i++) {
+        for (l = 0; l < m; l++) r[l] = B[i][l];
+        for (j = 0; j < n; j++) {
+            double a = A[i][j];
+            for (l = 0; l < m; l++) r[l] -= a * X[j][l];
+        }
+        for (l = 0; l < m; l++) {
+            R[i][l] = (float)r[l];
+            if (fabs(r[l]) > rmax[l]) rmax[l] = fabs(r[l]);
+        }
+    }
+}
+
+int refine_solve(double **A, double **B, double **X, int n, int m, int use_lu, int max_iter, refine_stats *st)
+/* mixed precision: factor a float copy of A once (cholesky() or lu_factor()),
+   then correct X with residuals computed in double, solving each correction
+   with the float factors. Stops when every column has
+   ||b - Ax||_inf <= sqrt(n) eps ||A||_inf ||x||_inf (LAPACK's dsposv test).
+   Returns 0 on convergence, 1 if refinement stalls or hits max_iter (X is
+   then the last iterate), -1 if the float factorization fails. */
+{
+    float **Af = use_lu ? matrix(n, n) : tri_matrix(n), **R = matrix(n, m), **D = matrix(n, m);
+    int *perm = use_lu ? ivector(n) : NULL;
+    double *r = dvector(m), *rnorm = dvector(m);
+    double anorm = 0.0, eps = DBL_EPSILON * sqrt((double)n), berr, prev = HUGE_VAL, s;
+    int i, j, l, it, status = 1, pass;
+
+    for (i = 0; i < n; i++) {
+        s = 0.0;
+        for (j = 0; j < n; j++) {
+            if (use_lu || j <= i) Af[i][j] = (float)A[i][j]; // Cholesky reads the lower triangle only
+            s += fabs(A[i][j]);
+        }
+        if (s > anorm) anorm = s;
+    }
+    st->iterations = 0;
+    st->backward_error = HUGE_VAL;
+
+    if ((use_lu ? lu_factor(Af, n, perm) : cholesky_packed(Af, n)) != 0) {
+        status = -1;
+    } else {
+        for (i = 0; i < n; i++) for (l = 0; l < m; l++) R[i][l] = (float)B[i][l];
+        for (i = 0; i < n; i++) for (l = 0; l < m; l++) X[i][l] = 0.0;
+
+        // iteration 0 is the plain float solve, starting from X = 0
+        for (it = 0; it <= max_iter; it++) {
+            if (use_lu) lu_solve_multi(Af, perm, R, D, n, m);
+            else cholesky_solve_multi(Af, R, D, n, m);
+            for (i = 0; i < n; i++) for (l = 0; l < m; l++) X[i][l] += (double)D[i][l];
+            residual_double(A, B, X, r, rnorm, R, n, m);
+
+            // worst column: normwise backward error and the stopping test, on the double residual
+            berr = 0.0;
+            pass = 1;
+            for (l = 0; l < m; l++) {
+                double rmax = rnorm[l], xmax = 0.0, bmax = 0.0;
+                for (i = 0; i < n; i++) {
+                    if (fabs(X[i][l]) > xmax) xmax = fabs(X[i][l]);
+                    if (fabs(B[i][l]) > bmax) bmax = fabs(B[i][l]);
+                }
+                if (rmax > eps * anorm * xmax) pass = 0;
+                if (anorm * xmax + bmax > 0.0 && rmax / (anorm * xmax + bmax) > berr) berr = rmax / (anorm * xmax + bmax);
+            }
+            st->iterations = it;
+            st->backward_error = berr;
+            if (pass) { status = 0; break; }
+            if (berr > 0.5 * prev) break; // not even halving any more: stalled
+            prev = berr;
+        }
+    }
+
+    free_matrix(Af);
+    free_matrix(R);
+    free_matrix(D);
+    if (perm != NULL) free_ivector(perm);
+    free_dvector(r);
+    free_dvector(rnorm);
+    return status;
+}
@@ -1,15 +1,65 @@
 #ifndef PRIMITIVES_H
 #define PRIMITIVES_H
 
+// tile size for cholesky_blocked(); override with -DCHOLESKY_BLOCK=<nb>
+#ifndef CHOLESKY_BLOCK
+#define CHOLESKY_BLOCK 64
+#endif
+
+// panel width for lu_factor(); override with -DLU_BLOCK=<nb>
+#ifndef LU_BLOCK
+#define LU_BLOCK 64
+#endif
+
+// smallest N for which gauss_jordan_parallel() actually uses threads
+#ifndef GJ_PARALLEL_MIN
+#define GJ_PARALLEL_MIN 128
+#endif
 
 void cholesky(float **A, int n);
 
+int cholesky_factor(float **A, int n);
+
+int cholesky_packed(float **A, int n);
+
+void cholesky_blocked(float **A, int n, int nb);
+
 void cholesky_solve(float **A, float *b, float *x, int n);
 
+void cholesky_solve_multi(float **A, float **B, float **X, int n, int m);
+
+int lu_factor(float **A, int n, int *perm);
+
+void lu_solve(float **A, int *perm, float *b, float *x, int n);
+
+void lu_solve_multi(float **A, int *perm, float **B, float **X, int n, int m);
+
 void gauss_jordan_partial(float **A, int N);
 
+void gauss_jordan_multi(float **A, int N, int M);
+
+int gauss_jordan_multi_info(float **A, int N, int M);
+
+void gauss_jordan_parallel(float **A, int N, int M, int nthreads);
+
+int gauss_jordan_parallel_info(float **A, int N, int M, int nthreads);
+
+// iteration limit of the mixed-precision refinement
+#ifndef REFINE_MAX_ITER
+#define REFINE_MAX_ITER 30
+#endif
+
+typedef struct {
+    int iterations;         // refinement steps after the first float solve
+    double backward_error;  // worst column, max |b - Ax| / (||A|| max|x| + max|b|)
+} refine_stats;
+
+int refine_solve(double **A, double **B, double **X, int n, int m, int use_lu, int max_iter, refine_stats *st);
+
 int is_symmetric(float **a, int n);
 
 int is_symmetric_double(double **a, int n);
 
+int pack_lower_d(double **A, float **L, int n);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,404 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "matfile.h"
+#include "solfile.h"
+
+#define POW10_MIN (-360)    // covers every double and the digits asked for
+#define POW10_MAX 360
+#define NUM_MAX 32          // longest formatted number, with room to spare
+
+typedef struct {
+    char magic[8];
+    uint64_t count;
+    uint64_t index_offset;
+} sol_trailer;
+
+
+/* shortest round-trip formatting
+
+   v is scaled once to an 18-digit integer in long double (64-bit mantissa).
+   Rounding that integer to p digits gives the p-digit candidates, and a
+   candidate reads back as v when it lies within half the gap to the
+   neighbouring float on its side of v. The gaps are equal except when v is
+   a power of two, where the one below is half the one above. The distance
+   is computed in long double, far more precisely than the 1/64 ulp margin
+   around that bound; the rare candidates inside the margin are settled by
+   strtof/strtod. The shortest passing p is found by bisection: if p digits
+   pass, so do p + 1. */
+
+static const uint64_t pow10_u64[19] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+    1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+    1000000000000000000ULL
+};
+
+static long double pow10_table[POW10_MAX - POW10_MIN + 1];
+static pthread_once_t pow10_once = PTHREAD_ONCE_INIT;
+
+static void pow10_init(void) {
+    for (int i = POW10_MIN; i <= POW10_MAX; i++) pow10_table[i - POW10_MIN] = powl(10.0L, (long double)i);
+}
+
+// built once, whichever thread formats the first number
+static long double pow10l_cached(int e) {
+    pthread_once(&pow10_once, pow10_init);
+    return pow10_table[e - POW10_MIN];
+}
+
+// the value is digits * 10^(exp10 - ndigits + 1), exp10 the power of the leading digit
+static int emit_digits(char *out, int negative, uint64_t digits, int exp10) {
+    char d[24];
+    int nd = 0, len = 0, i, e;
+
+    while (digits >= 10 && digits % 10 == 0) digits /= 10;
+    for (uint64_t t = digits; t > 0 || nd == 0; t /= 10) d[nd++] = (char)('0' + t % 10);
+    // d holds the digits reversed
+    if (negative) out[len++] = '-';
+    if (exp10 >= -5 && exp10 < 17) {
+        if (exp10 < 0) {
+            out[len++] = '0';
+            out[len++] = '.';
+            for (i = -1; i > exp10; i--) out[len++] = '0';
+            for (i = nd - 1; i >= 0; i--) out[len++] = d[i];
+        } else {
+            for (i = 0; i <= exp10; i++) out[len++] = (i < nd) ? d[nd - 1 - i] : '0';
+            if (nd > exp10 + 1) {
+                out[len++] = '.';
+                for (i = exp10 + 1; i < nd; i++) out[len++] = d[nd - 1 - i];
+            }
+        }
+    } else {
+        out[len++] = d[nd - 1];
+        if (nd > 1) {
+            out[len++] = '.';
+            for (i = nd - 2; i >= 0; i--) out[len++] = d[i];
+        }
+        out[len++] = 'e';
+        out[len++] = (exp10 < 0) ? '-' : '+';
+        e = (exp10 < 0) ? -exp10 : exp10;
+        if (e >= 100) out[len++] = (char)('0' + e / 100);
+        out[len++] = (char)('0' + e / 10 % 10);
+        out[len++] = (char)('0' + e % 10);
+    }
+    out[len] = '\0';
+    return len;
+}
+
+typedef struct {
+    double v;               // the value, float or double
+    int is_float;
+    long double a;          // |v|
+    long double half;       // half the gap to the next float above a
+    long double half_below; // and below: half / 2 when a is a power of two
+    uint64_t scaled;        // round(a * 10^(17 - k)), 18 digits
+    int k;                  // power of the leading digit of a
+} digit_search;
+
+// the p-digit rounding of a, if it reads back as a
+static int try_digits(const digit_search *s, int p, uint64_t *digits, int *exp10) {
+    uint64_t div = pow10_u64[18 - p], n = (s->scaled + div / 2) / div;
+    int k = s->k;
+    long double dist, half;
+    char text[NUM_MAX];
+
+    if (n == pow10_u64[p]) { n = pow10_u64[p - 1]; k++; } // 9.99.. rounded up to 10.0..
+    dist = (long double)n * pow10l_cached(k - p + 1) - s->a;
+    half = (dist < 0.0L) ? s->half_below : s->half;
+    dist = fabsl(dist);
+    if (dist >= half + half / 64) return 0;
+    if (dist >= half - half / 64) {
+        emit_digits(text, s->v < 0, n, k);
+        if (s->is_float ? (strtof(text, NULL) != (float)s->v) : (strtod(text, NULL) != s->v)) return 0;
+    }
+    *digits = n;
+    *exp10 = k;
+    return 1;
+}
+
+/* a finite, nonzero float (is_float) or double v; returns 0 if no rounding
+   up to 9 (17) digits passed */
+static int shortest_digits(double v, int is_float, uint64_t *digits, int *exp10) {
+    digit_search s;
+    int e2, lo = 1, hi = is_float ? 9 : 17, mid;
+    int mantissa_bits = is_float ? FLT_MANT_DIG : DBL_MANT_DIG, min_e2 = is_float ? FLT_MIN_EXP : DBL_MIN_EXP;
+    double m;
+
+    m = frexp(v, &e2);
+    s.v = v;
+    s.is_float = is_float;
+    s.a = fabsl((long double)v);
+    s.half = ldexpl(1.0L, ((e2 > min_e2) ? e2 : min_e2) - mantissa_bits - 1);
+    // below a power of two the exponent drops and the gap halves, unless the floats below are subnormal
+    s.half_below = (fabs(m) == 0.5 && e2 > min_e2) ? s.half / 2 : s.half;
+    s.k = (int)floor((e2 - 1) * 0.30102999566398120); // a >= 2^(e2-1), so k or k + 1
+    s.scaled = (uint64_t)(s.a * pow10l_cached(17 - s.k) + 0.5L);
+    if (s.scaled >= pow10_u64[18]) {
+        s.k++;
+        s.scaled = (uint64_t)(s.a * pow10l_cached(17 - s.k) + 0.5L);
+    }
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (try_digits(&s, mid, digits, exp10)) hi = mid;
+        else lo = mid + 1;
+    }
+    return try_digits(&s, lo, digits, exp10);
+}
+
+static int special(char *out, double v) {
+    if (isnan(v)) return snprintf(out, NUM_MAX, "nan");
+    if (isinf(v)) return snprintf(out, NUM_MAX, v < 0 ? "-inf" : "inf");
+    return snprintf(out, NUM_MAX, signbit(v) ? "-0" : "0");
+}
+
+// shortest decimal that reads back as v; out needs NUM_MAX bytes, returns the length
+int format_float(char *out, float v) {
+    int exp10;
+    uint64_t digits;
+
+    if (!isfinite(v) || v == 0.0f) return special(out, v);
+    if (!shortest_digits(v, 1, &digits, &exp10)) {
+        return snprintf(out, NUM_MAX, "%.9g", v);
+    }
+    return emit_digits(out, v < 0, digits, exp10);
+}
+
+int format_double(char *out, double v) {
+    int exp10;
+    uint64_t digits;
+
+    if (!isfinite(v) || v == 0.0) return special(out, v);
+    if (!shortest_digits(v, 0, &digits, &exp10)) {
+        return snprintf(out, NUM_MAX, "%.17g", v);
+    }
+    return emit_digits(out, v < 0, digits, exp10);
+}
+
+
+// buffered output: one write() per SOL_BUFFER_BYTES
+static int sol_flush(solfile *sf) {
+    size_t done = 0;
+    ssize_t w;
+
+    while (done < sf->len && !sf->error) {
+        w = write(sf->fd, sf->buf + done, sf->len - done);
+        if (w < 0) {
+            fprintf(stderr, "Error: Failed writing solution file '%s'.\n", sf->path);
+            sf->error = 1;
+        } else done += (size_t)w;
+    }
+    sf->pos += (off_t)sf->len;
+    sf->len = 0;
+    return sf->error ? -1 : 0;
+}
+
+static void sol_put(solfile *sf, const void *data, size_t bytes) {
+    const char *p = data;
+    size_t chunk;
+
+    while (bytes > 0) {
+        if (sf->len == SOL_BUFFER_BYTES && sol_flush(sf) != 0) return;
+        chunk = SOL_BUFFER_BYTES - sf->len;
+        if (chunk > bytes) chunk = bytes;
+        memcpy(sf->buf + sf->len, p, chunk);
+        sf->len += chunk;
+        p += chunk;
+        bytes -= chunk;
+    }
+}
+
+// room for one more number in the buffer
+static char *sol_reserve(solfile *sf) {
+    if (sf->len + NUM_MAX + 1 > SOL_BUFFER_BYTES) sol_flush(sf);
+    return sf->buf + sf->len;
+}
+
+static void sol_pad(solfile *sf) {
+    static const char zeros[MATFILE_ALIGN] = {0};
+    size_t pad = (size_t)((MATFILE_ALIGN - (sf->pos + (off_t)sf->len) % MATFILE_ALIGN) % MATFILE_ALIGN);
+    sol_put(sf, zeros, pad);
+}
+
+
+/* a binary file to be continued: load its index and cut it off, the next
+   record goes where the index was */
+static int load_index(solfile *sf) {
+    struct stat st;
+    sol_trailer tr;
+    size_t bytes;
+
+    if (fstat(sf->fd, &st) != 0 || st.st_size == 0) return 0;
+    if ((size_t)st.st_size < sizeof(tr) || pread(sf->fd, &tr, sizeof(tr), st.st_size - (off_t)sizeof(tr)) != (ssize_t)sizeof(tr)
+        || memcmp(tr.magic, SOL_INDEX_MAGIC, sizeof(tr.magic)) != 0
+        || tr.index_offset + tr.count * sizeof(sol_index_entry) + sizeof(tr) != (uint64_t)st.st_size) {
+        fprintf(stderr, "Error: '%s' is not a binary solution file, cannot append to it.\n", sf->path);
+        return -1;
+    }
+    sf->cap = (long)tr.count + 16;
+    if ((sf->index = malloc((size_t)sf->cap * sizeof(sol_index_entry))) == NULL) return -1;
+    bytes = tr.count * sizeof(sol_index_entry);
+    if (pread(sf->fd, sf->index, bytes, (off_t)tr.index_offset) != (ssize_t)bytes
+        || ftruncate(sf->fd, (off_t)tr.index_offset) != 0) {
+        fprintf(stderr, "Error: Could not read the index of '%s'.\n", sf->path);
+        return -1;
+    }
+    sf->count = (long)tr.count;
+    sf->pos = (off_t)tr.index_offset;
+    return 0;
+}
+
+/* open the solution file: path, or <source>_solution.txt (.bin) when path
+   is NULL. Text files start with a line naming the source.
+   Returns 0, or -1 with a message on stderr. */
+int solfile_open(solfile *sf, const char *path, const char *source, sol_format format, int append) {
+    int flags = (format == SOL_BINARY) ? O_RDWR | O_CREAT : O_WRONLY | O_CREAT;
+    char line[FILENAME_MAX + 64];
+
+    memset(sf, 0, sizeof(*sf));
+    sf->format = format;
+    if (path != NULL) snprintf(sf->path, sizeof(sf->path), "%s", path);
+    else snprintf(sf->path, sizeof(sf->path), "%s_solution.%s", source, (format == SOL_BINARY) ? "bin" : "txt");
+    flags |= !append ? O_TRUNC : (format == SOL_TEXT) ? O_APPEND : 0;
+
+    printf("Attempting to write solution to: %s\n", sf->path);
+    if ((sf->fd = open(sf->path, flags, 0644)) < 0) {
+        fprintf(stderr, "Error: Could not open output file '%s' for writing solution.\n", sf->path);
+        return -1;
+    }
+    if ((sf->buf = malloc(SOL_BUFFER_BYTES)) == NULL || (append && format == SOL_BINARY && load_index(sf) != 0)) {
+        if (sf->buf == NULL) fprintf(stderr, "Error: Out of memory for the solution writer.\n");
+        close(sf->fd);
+        free(sf->buf);
+        free(sf->index);
+        return -1;
+    }
+    if (format == SOL_BINARY) {
+        lseek(sf->fd, sf->pos, SEEK_SET);
+    } else {
+        snprintf(line, sizeof(line), "# Solutions X for input: %s\n", source ? source : "N/A");
+        sol_put(sf, line, strlen(line));
+    }
+    return 0;
+}
+
+
+static int sol_add(solfile *sf, float **X, double **dX, long n, long m, long system) {
+    matfile_header hdr;
+    sol_index_entry *grown;
+    char line[128], *p;
+    long i, j;
+
+    if (sf->format == SOL_TEXT) {
+        snprintf(line, sizeof(line), "# System %ld, rows and right-hand sides (N_ROW M_COL): %ld %ld\n", system, n, m);
+        sol_put(sf, line, strlen(line));
+        for (i = 0; i < n && !sf->error; i++) {
+            for (j = 0; j < m; j++) {
+                p = sol_reserve(sf);
+                sf->len += (size_t)((dX != NULL) ? format_double(p, dX[i][j]) : format_float(p, X[i][j]));
+                sf->buf[sf->len++] = (j + 1 < m) ? ' ' : '\n';
+            }
+        }
+        return sf->error ? -1 : 0;
+    }
+
+    // binary: a container record without A, indexed at the end
+    sol_pad(sf);
+    if (sf->count == sf->cap) {
+        sf->cap = 2 * sf->cap + 16;
+        if ((grown = realloc(sf->index, (size_t)sf->cap * sizeof(sol_index_entry))) == NULL) {
+            fprintf(stderr, "Error: Out of memory for the solution index.\n");
+            return -1;
+        }
+        sf->index = grown;
+    }
+    sf->index[sf->count].system = system;
+    sf->index[sf->count++].offset = (uint64_t)(sf->pos + (off_t)sf->len);
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, MATFILE_MAGIC, sizeof(hdr.magic));
+    hdr.version = MATFILE_VERSION;
+    hdr.dtype = (dX != NULL) ? MATFILE_FLOAT64 : MATFILE_FLOAT32;
+    hdr.layout = MATFILE_ROW_MAJOR;
+    hdr.n = n;
+    hdr.m = m;
+    hdr.offset_a = 0; // no A block
+    hdr.offset_b = (uint64_t)(sf->pos + (off_t)sf->len) + MATFILE_ALIGN;
+    sol_put(sf, &hdr, sizeof(hdr));
+    sol_pad(sf);
+    for (i = 0; i < n; i++) { // rows are contiguous, but not necessarily one after the other
+        if (dX != NULL) sol_put(sf, dX[i], (size_t)m * sizeof(double));
+        else sol_put(sf, X[i], (size_t)m * sizeof(float));
+    }
+    return sf->error ? -1 : 0;
+}
+
+int solfile_add(solfile *sf, float **X, long n, long m, long system) {
+    return sol_add(sf, X, NULL, n, m, system);
+}
+
+int solfile_add_d(solfile *sf, double **X, long n, long m, long system) {
+    return sol_add(sf, NULL, X, n, m, system);
+}
+
+// flush, write the binary index, close. Returns 0, or -1 if anything failed
+int solfile_close(solfile *sf) {
+    sol_trailer tr;
+    int status;
+
+    if (sf->format == SOL_BINARY && !sf->error) {
+        sol_pad(sf);
+        memcpy(tr.magic, SOL_INDEX_MAGIC, sizeof(tr.magic));
+        tr.count = (uint64_t)sf->count;
+        tr.index_offset = (uint64_t)(sf->pos + (off_t)sf->len);
+        sol_put(sf, sf->index, (size_t)sf->count * sizeof(sol_index_entry));
+        sol_put(sf, &tr, sizeof(tr));
+    }
+    status = sol_flush(sf);
+    if (close(sf->fd) != 0 && status == 0) {
+        fprintf(stderr, "Error: Failed closing solution file '%s'.\n", sf->path);
+        status = -1;
+    }
+    free(sf->buf);
+    free(sf->index);
+    sf->buf = NULL;
+    sf->index = NULL;
+    return status;
+}
+
+
+// the text after --output=
+int solfile_parse_format(const char *arg, sol_format *format) {
+    if (strcmp(arg, "text") == 0) *format = SOL_TEXT;
+    else if (strcmp(arg, "binary") == 0) *format = SOL_BINARY;
+    else return -1;
+    return 0;
+}
+
+// one system as system 0 of its own file, for the single-system drivers
+static int sol_write(const char *path, const char *source, sol_format format, int append,
+                     float **X, double **dX, long n, long m) {
+    solfile sf;
+    int status;
+
+    if (solfile_open(&sf, path, source, format, append) != 0) return -1;
+    status = sol_add(&sf, X, dX, n, m, 0);
+    if (solfile_close(&sf) != 0) status = -1;
+    if (status == 0) printf("Solution successfully written to %s.\n", sf.path);
+    return status;
+}
+
+int solfile_write(const char *path, const char *source, sol_format format, int append, float **X, long n, long m) {
+    return sol_write(path, source, format, append, X, NULL, n, m);
+}
+
+int solfile_write_d(const char *path, const char *source, sol_format format, int append, double **X, long n, long m) {
+    return sol_write(path, source, format, append, NULL, X, n, m);
+}
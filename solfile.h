@@ -0,0 +1,70 @@
+#ifndef SOLFILE_H
+#define SOLFILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/* Solution writer, text or binary, for one system or a stream of them.
+
+   text     # Solutions X for input: <source>
+            # System <i>, rows and right-hand sides (N_ROW M_COL): <n> <m>
+            <n lines of m numbers>
+            ...
+            Each number is the shortest decimal that reads back as the same
+            float (or double). Lines are formatted into a SOL_BUFFER_BYTES
+            buffer that goes out with one write() per block.
+
+   binary   one record per system in the layout of the input container
+            (matfile.h): a 64-byte header with the magic, dtype, layout, n
+            and m, then X (n x m, row-major) on a MATFILE_ALIGN boundary.
+            The A offset is 0, there is no A block. After the last record,
+            an index of (system, record offset) pairs and a trailer:
+              [ "LASOLIDX" | count | offset of the index ]
+            so a reader can seek to any system without scanning.
+
+   With append set, an existing file is continued instead of replaced; a
+   binary file gets its index extended, so one file can collect the
+   solutions of several runs. */
+
+#define SOL_BUFFER_BYTES (1 << 20)
+#define SOL_INDEX_MAGIC "LASOLIDX"
+
+typedef enum { SOL_TEXT, SOL_BINARY } sol_format;
+
+typedef struct {
+    int64_t system;     // index of the system in its input
+    uint64_t offset;    // byte offset of its record header
+} sol_index_entry;
+
+typedef struct {
+    int fd;
+    sol_format format;
+    char *buf;              // pending output, SOL_BUFFER_BYTES
+    size_t len;
+    off_t pos;              // file offset of buf[0]
+    sol_index_entry *index; // binary: one entry per record
+    long count, cap;
+    int error;
+    char path[FILENAME_MAX];
+} solfile;
+
+int solfile_parse_format(const char *arg, sol_format *format);
+
+int solfile_open(solfile *sf, const char *path, const char *source, sol_format format, int append);
+
+int solfile_add(solfile *sf, float **X, long n, long m, long system);
+
+int solfile_add_d(solfile *sf, double **X, long n, long m, long system);
+
+int solfile_close(solfile *sf);
+
+int solfile_write(const char *path, const char *source, sol_format format, int append, float **X, long n, long m);
+
+int solfile_write_d(const char *path, const char *source, sol_format format, int append, double **X, long n, long m);
+
+int format_float(char *out, float v);
+
+int format_double(char *out, double v);
+
+#endif
@@ -0,0 +1,478 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "util.h"
+#include "sparse.h"
+
+#define CSR_PARALLEL_MIN (1L << 18) // entries below which the conversion stays serial
+#define CSR_MAX_THREADS 64
+
+
+/* sort one row by column, carrying the values along. Equal columns
+   (duplicate entries) keep their order in the COO input, org[], so the row
+   comes out the same whichever thread scattered which entry. Rows from the
+   serial scatter are usually sorted already; long rows use heapsort. */
+
+#define ENTRY_BEFORE(a, b) (col[a] < col[b] || (col[a] == col[b] && org[a] < org[b]))
+
+static void swap_entries(int *col, double *val, long *org, long a, long b) {
+    int c = col[a];
+    double v = val[a];
+    long o = org[a];
+
+    col[a] = col[b]; col[b] = c;
+    val[a] = val[b]; val[b] = v;
+    org[a] = org[b]; org[b] = o;
+}
+
+static void sift_down(int *col, double *val, long *org, long root, long len) {
+    long child;
+
+    while ((child = 2 * root + 1) < len) {
+        if (child + 1 < len && ENTRY_BEFORE(child, child + 1)) child++;
+        if (!ENTRY_BEFORE(root, child)) return;
+        swap_entries(col, val, org, root, child);
+        root = child;
+    }
+}
+
+static void sort_row(int *col, double *val, long *org, long len) {
+    long i, j;
+
+    for (i = 1; i < len && ENTRY_BEFORE(i - 1, i); i++) ;
+    if (i >= len) return;
+
+    if (len <= 32) {
+        for (i = 1; i < len; i++) {
+            for (j = i; j > 0 && ENTRY_BEFORE(j, j - 1); j--) swap_entries(col, val, org, j, j - 1);
+        }
+        return;
+    }
+    for (i = len / 2 - 1; i >= 0; i--) sift_down(col, val, org, i, len);
+    for (i = len - 1; i > 0; i--) {
+        swap_entries(col, val, org, 0, i);
+        sift_down(col, val, org, 0, i);
+    }
+}
+
+
+/* one thread's share of a conversion step: COO entries [lo, hi) for the
+   count and scatter steps, rows [lo, hi) for the sort step */
+typedef struct {
+    csr_matrix *A;
+    const int *row, *col;
+    const double *val;
+    long *cursor;
+    long *origin;           // COO position of each CSR entry, the tie-break of sort_row()
+    long lo, hi;
+    int shared;             // other threads update the same counters: use atomics
+} csr_part;
+
+static void *count_part(void *arg) {
+    csr_part *p = arg;
+    if (p->shared) {
+        for (long k = p->lo; k < p->hi; k++) __atomic_fetch_add(&p->A->row_ptr[p->row[k] + 1], 1, __ATOMIC_RELAXED);
+    } else {
+        for (long k = p->lo; k < p->hi; k++) p->A->row_ptr[p->row[k] + 1]++;
+    }
+    return NULL;
+}
+
+static void *scatter_part(void *arg) {
+    csr_part *p = arg;
+    long pos;
+    for (long k = p->lo; k < p->hi; k++) {
+        if (p->shared) pos = __atomic_fetch_add(&p->cursor[p->row[k]], 1, __ATOMIC_RELAXED);
+        else pos = p->cursor[p->row[k]]++;
+        p->A->col_idx[pos] = p->col[k];
+        p->A->val[pos] = p->val[k];
+        p->origin[pos] = k;
+    }
+    return NULL;
+}
+
+static void *sort_part(void *arg) {
+    csr_part *p = arg;
+    for (long i = p->lo; i < p->hi; i++) {
+        long start = p->A->row_ptr[i];
+        sort_row(p->A->col_idx + start, p->A->val + start, p->origin + start, p->A->row_ptr[i + 1] - start);
+    }
+    return NULL;
+}
+
+// run step() on every part, part 0 on the calling thread
+static void run_parts(csr_part *parts, int nthreads, void *(*step)(void *)) {
+    pthread_t tid[CSR_MAX_THREADS];
+    int started[CSR_MAX_THREADS];
+    int t;
+
+    for (t = 1; t < nthreads; t++) {
+        started[t] = (pthread_create(&tid[t], NULL, step, &parts[t]) == 0);
+        if (!started[t]) step(&parts[t]);
+    }
+    step(&parts[0]);
+    for (t = 1; t < nthreads; t++) {
+        if (started[t]) pthread_join(tid[t], NULL);
+    }
+}
+
+// same knob as the text parser: DAT_NUM_THREADS, default all online CPUs
+static int csr_threads(long nnz) {
+    const char *env = getenv("DAT_NUM_THREADS");
+    long nthreads;
+
+    if (nnz < CSR_PARALLEL_MIN) return 1;
+    nthreads = (env != NULL) ? atol(env) : sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads < 1) nthreads = 1;
+    if (nthreads > CSR_MAX_THREADS) nthreads = CSR_MAX_THREADS;
+    return (int)nthreads;
+}
+
+
+/* assemble CSR from nnz coordinate entries (0-based). Count the entries of
+   each row, prefix-sum the counts into row_ptr, scatter every entry to its
+   row, then sort each row by column. Duplicate entries are kept in input
+   order, with any number of threads, so the sums they add up to in
+   csr_to_matrix() and in products are reproducible. Returns 0, or -1 if out
+   of memory. */
+int coo_to_csr(csr_matrix *A, long n_rows, long n_cols, long nnz,
+               const int *row, const int *col, const double *val) {
+    csr_part parts[CSR_MAX_THREADS];
+    long *cursor, *origin;
+    long i;
+    int nthreads = csr_threads(nnz), t;
+
+    A->n_rows = n_rows;
+    A->n_cols = n_cols;
+    A->nnz = nnz;
+    A->row_ptr = calloc((size_t)n_rows + 1, sizeof(long));
+    A->col_idx = malloc((size_t)(nnz > 0 ? nnz : 1) * sizeof(int));
+    A->val = malloc((size_t)(nnz > 0 ? nnz : 1) * sizeof(double));
+    cursor = malloc((size_t)(n_rows > 0 ? n_rows : 1) * sizeof(long));
+    origin = malloc((size_t)(nnz > 0 ? nnz : 1) * sizeof(long));
+    if (A->row_ptr == NULL || A->col_idx == NULL || A->val == NULL || cursor == NULL || origin == NULL) {
+        fprintf(stderr, "Error: Out of memory assembling a %ldx%ld CSR matrix with %ld entries.\n", n_rows, n_cols, nnz);
+        free(cursor);
+        free(origin);
+        free_csr(A);
+        return -1;
+    }
+
+    for (t = 0; t < nthreads; t++) {
+        parts[t] = (csr_part){ A, row, col, val, cursor, origin, nnz * t / nthreads, nnz * (t + 1) / nthreads, nthreads > 1 };
+    }
+    run_parts(parts, nthreads, count_part);
+
+    for (i = 0; i < n_rows; i++) A->row_ptr[i + 1] += A->row_ptr[i];
+    memcpy(cursor, A->row_ptr, (size_t)n_rows * sizeof(long));
+    run_parts(parts, nthreads, scatter_part);
+    free(cursor);
+
+    // rows are split evenly by count, not by entries; good enough for sorting
+    for (t = 0; t < nthreads; t++) {
+        parts[t].lo = n_rows * t / nthreads;
+        parts[t].hi = n_rows * (t + 1) / nthreads;
+    }
+    run_parts(parts, nthreads, sort_part);
+    free(origin);
+    return 0;
+}
+
+
+void free_csr(csr_matrix *A) {
+    free(A->row_ptr);
+    free(A->col_idx);
+    free(A->val);
+    A->row_ptr = NULL;
+    A->col_idx = NULL;
+    A->val = NULL;
+    A->nnz = 0;
+}
+
+
+// dense copies, only for the dense solvers
+float **csr_to_matrix(const csr_matrix *A) {
+    float **D = matrix(A->n_rows, A->n_cols);
+
+    for (long i = 0; i < A->n_rows; i++) {
+        memset(D[i], 0, (size_t)A->n_cols * sizeof(float));
+        for (long k = A->row_ptr[i]; k < A->row_ptr[i + 1]; k++) D[i][A->col_idx[k]] += (float)A->val[k];
+    }
+    return D;
+}
+
+double **csr_to_dmatrix(const csr_matrix *A) {
+    double **D = dmatrix(A->n_rows, A->n_cols);
+
+    for (long i = 0; i < A->n_rows; i++) {
+        memset(D[i], 0, (size_t)A->n_cols * sizeof(double));
+        for (long k = A->row_ptr[i]; k < A->row_ptr[i + 1]; k++) D[i][A->col_idx[k]] += A->val[k];
+    }
+    return D;
+}
+
+
+// keep only the entries that are not exactly zero
+int dmatrix_to_csr(double **D, long n_rows, long n_cols, csr_matrix *A) {
+    long i, j, k = 0;
+
+    A->n_rows = n_rows;
+    A->n_cols = n_cols;
+    A->row_ptr = malloc((size_t)(n_rows + 1) * sizeof(long));
+    if (A->row_ptr == NULL) return -1;
+    A->row_ptr[0] = 0;
+    for (i = 0; i < n_rows; i++) {
+        for (j = 0; j < n_cols; j++) k += (D[i][j] != 0.0);
+        A->row_ptr[i + 1] = k;
+    }
+    A->nnz = k;
+    A->col_idx = malloc((size_t)(k > 0 ? k : 1) * sizeof(int));
+    A->val = malloc((size_t)(k > 0 ? k : 1) * sizeof(double));
+    if (A->col_idx == NULL || A->val == NULL) {
+        fprintf(stderr, "Error: Out of memory assembling a %ldx%ld CSR matrix with %ld entries.\n", n_rows, n_cols, k);
+        free_csr(A);
+        return -1;
+    }
+    for (i = 0, k = 0; i < n_rows; i++) {
+        for (j = 0; j < n_cols; j++) {
+            if (D[i][j] != 0.0) { A->col_idx[k] = (int)j; A->val[k++] = D[i][j]; }
+        }
+    }
+    return 0;
+}
+
+
+// A[i][j], adding up duplicates; the row is sorted, so binary search
+static double csr_entry(const csr_matrix *A, long i, long j) {
+    long lo = A->row_ptr[i], hi = A->row_ptr[i + 1], mid, k;
+    double v = 0.0;
+
+    while (lo < hi) { // first entry with column >= j
+        mid = lo + (hi - lo) / 2;
+        if (A->col_idx[mid] < j) lo = mid + 1; else hi = mid;
+    }
+    for (k = lo; k < A->row_ptr[i + 1] && A->col_idx[k] == j; k++) v += A->val[k];
+    return v;
+}
+
+// CSR counterpart of is_symmetric_double(): |A[i][j] - A[j][i]| <= tol everywhere
+int csr_is_symmetric(const csr_matrix *A, double tol) {
+    if (A->n_rows != A->n_cols) return 0;
+    for (long i = 0; i < A->n_rows; i++) {
+        for (long k = A->row_ptr[i]; k < A->row_ptr[i + 1]; k++) {
+            long j = A->col_idx[k];
+            if (j == i || (k > A->row_ptr[i] && A->col_idx[k - 1] == j)) continue;
+            if (fabs(csr_entry(A, i, j) - csr_entry(A, j, i)) > tol) return 0;
+        }
+    }
+    return 1;
+}
+
+
+// y = A * x
+void csr_matvec(const csr_matrix *A, const double *x, double *y) {
+    for (long i = 0; i < A->n_rows; i++) {
+        double sum = 0.0;
+        for (long k = A->row_ptr[i]; k < A->row_ptr[i + 1]; k++) sum += A->val[k] * x[A->col_idx[k]];
+        y[i] = sum;
+    }
+}
+
+
+/* ---- preconditioned conjugate gradients ---- */
+
+typedef struct {
+    pcg_precond kind;
+    double *inv_diag;   // Jacobi: 1 / A[i][i]
+    csr_matrix L;       // IC(0): lower factor on the pattern of tril(A), diagonal last in each row
+} preconditioner;
+
+static void free_precond(preconditioner *M) {
+    free(M->inv_diag);
+    M->inv_diag = NULL;
+    if (M->kind == PRECOND_IC0) free_csr(&M->L);
+}
+
+static int jacobi_setup(const csr_matrix *A, preconditioner *M) {
+    long n = A->n_rows;
+
+    M->kind = PRECOND_JACOBI;
+    M->inv_diag = malloc((size_t)(n > 0 ? n : 1) * sizeof(double));
+    if (M->inv_diag == NULL) nrerror("allocation failure in jacobi_setup()");
+    for (long i = 0; i < n; i++) {
+        double d = csr_entry(A, i, i);
+        if (d <= 0.0) {
+            fprintf(stderr, "Error: Jacobi preconditioner needs a positive diagonal (A[%ld][%ld] = %g).\n", i, i, d);
+            free(M->inv_diag);
+            M->inv_diag = NULL;
+            return -1;
+        }
+        M->inv_diag[i] = 1.0 / d;
+    }
+    return 0;
+}
+
+/* IC(0): A ~ L * L^T with L restricted to the pattern of the lower triangle.
+   Row by row, L[i][j] = (A[i][j] - sum_k L[i][k] L[j][k]) / L[j][j] over the
+   columns k < j both rows hold, then the diagonal. Returns -1 on breakdown
+   (a missing or non-positive pivot), which happens for some SPD matrices. */
+static int ic0_setup(const csr_matrix *A, preconditioner *M) {
+    csr_matrix *L = &M->L;
+    long n = A->n_rows, i, k, nnz = 0;
+
+    M->kind = PRECOND_IC0;
+    L->n_rows = L->n_cols = n;
+    L->row_ptr = malloc((size_t)(n + 1) * sizeof(long));
+    L->col_idx = malloc((size_t)(A->nnz > 0 ? A->nnz : 1) * sizeof(int));
+    L->val = malloc((size_t)(A->nnz > 0 ? A->nnz : 1) * sizeof(double));
+    if (L->row_ptr == NULL || L->col_idx == NULL || L->val == NULL) nrerror("allocation failure in ic0_setup()");
+
+    // copy tril(A), merging duplicate entries
+    L->row_ptr[0] = 0;
+    for (i = 0; i < n; i++) {
+        for (k = A->row_ptr[i]; k < A->row_ptr[i + 1] && A->col_idx[k] <= i; k++) {
+            if (nnz > L->row_ptr[i] && L->col_idx[nnz - 1] == A->col_idx[k]) { L->val[nnz - 1] += A->val[k]; continue; }
+            L->col_idx[nnz] = A->col_idx[k];
+            L->val[nnz++] = A->val[k];
+        }
+        L->row_ptr[i + 1] = nnz;
+    }
+    L->nnz = nnz;
+
+    for (i = 0; i < n; i++) {
+        long start = L->row_ptr[i], diag = L->row_ptr[i + 1] - 1, p;
+        double d;
+
+        if (diag < start || L->col_idx[diag] != i) {
+            fprintf(stderr, "Warning: IC(0) found no diagonal entry in row %ld.\n", i);
+            return -1;
+        }
+        for (p = start; p < diag; p++) {
+            long j = L->col_idx[p], a = start, b = L->row_ptr[j], jdiag = L->row_ptr[j + 1] - 1;
+            double s = L->val[p];
+
+            while (a < p && b < jdiag) { // sorted merge of rows i and j, columns < j
+                if (L->col_idx[a] < L->col_idx[b]) a++;
+                else if (L->col_idx[a] > L->col_idx[b]) b++;
+                else s -= L->val[a++] * L->val[b++];
+            }
+            L->val[p] = s / L->val[jdiag];
+        }
+        d = L->val[diag];
+        for (p = start; p < diag; p++) d -= L->val[p] * L->val[p];
+        if (d <= 0.0) {
+            fprintf(stderr, "Warning: IC(0) broke down at row %ld (pivot %g).\n", i, d);
+            return -1;
+        }
+        L->val[diag] = sqrt(d);
+    }
+    return 0;
+}
+
+// z = M^-1 r
+static void apply_precond(const preconditioner *M, const double *r, double *z, long n) {
+    const csr_matrix *L = &M->L;
+    long i, k;
+
+    switch (M->kind) {
+    case PRECOND_JACOBI:
+        for (i = 0; i < n; i++) z[i] = M->inv_diag[i] * r[i];
+        break;
+    case PRECOND_IC0:
+        for (i = 0; i < n; i++) { // L y = r
+            double s = r[i];
+            for (k = L->row_ptr[i]; k < L->row_ptr[i + 1] - 1; k++) s -= L->val[k] * z[L->col_idx[k]];
+            z[i] = s / L->val[L->row_ptr[i + 1] - 1];
+        }
+        for (i = n - 1; i >= 0; i--) { // L^T z = y, column by column
+            z[i] /= L->val[L->row_ptr[i + 1] - 1];
+            for (k = L->row_ptr[i]; k < L->row_ptr[i + 1] - 1; k++) z[L->col_idx[k]] -= L->val[k] * z[i];
+        }
+        break;
+    default:
+        memcpy(z, r, (size_t)n * sizeof(double));
+    }
+}
+
+static double dot(const double *x, const double *y, long n) {
+    double s = 0.0;
+    for (long i = 0; i < n; i++) s += x[i] * y[i];
+    return s;
+}
+
+
+/* solve A x = b for symmetric positive definite A by preconditioned
+   conjugate gradients, starting from the x passed in. Stops once
+   ||b - A x|| <= tol * ||b|| or after max_iter iterations. If IC(0) breaks
+   down, Jacobi is used instead. Returns 0 if converged, 1 if the iteration
+   limit was hit, -1 if A turned out not to be positive definite. */
+int pcg_solve(const csr_matrix *A, const double *b, double *x, pcg_precond pc,
+              double tol, int max_iter, pcg_stats *stats) {
+    preconditioner M = { PRECOND_NONE, NULL, { 0, 0, 0, NULL, NULL, NULL } };
+    long n = A->n_rows, i;
+    double *r, *z, *p, *q;
+    double bnorm, rel, rz, rz_old, alpha, beta, pq;
+    int it = 0, status = 0;
+
+    if (pc == PRECOND_IC0 && ic0_setup(A, &M) != 0) {
+        fprintf(stderr, "Warning: Falling back to the Jacobi preconditioner.\n");
+        free_precond(&M);
+        pc = PRECOND_JACOBI;
+    }
+    if (pc == PRECOND_JACOBI && jacobi_setup(A, &M) != 0) return -1;
+    stats->precond = M.kind;
+
+    r = dvector(n);
+    z = dvector(n);
+    p = dvector(n);
+    q = dvector(n);
+
+    csr_matvec(A, x, q);
+    for (i = 0; i < n; i++) r[i] = b[i] - q[i];
+    bnorm = sqrt(dot(b, b, n));
+    if (bnorm == 0.0) bnorm = 1.0; // b = 0: absolute residual
+    rel = sqrt(dot(r, r, n)) / bnorm;
+    if (stats->history != NULL) stats->history[0] = rel;
+
+    apply_precond(&M, r, z, n);
+    memcpy(p, z, (size_t)n * sizeof(double));
+    rz = dot(r, z, n);
+
+    while (rel > tol && it < max_iter) {
+        csr_matvec(A, p, q);
+        pq = dot(p, q, n);
+        if (pq <= 0.0) {
+            fprintf(stderr, "Error: PCG breakdown in iteration %d (p'Ap = %g): A is not positive definite.\n", it + 1, pq);
+            status = -1;
+            break;
+        }
+        alpha = rz / pq;
+        for (i = 0; i < n; i++) {
+            x[i] += alpha * p[i];
+            r[i] -= alpha * q[i];
+        }
+        rel = sqrt(dot(r, r, n)) / bnorm;
+        if (stats->history != NULL) stats->history[it + 1] = rel;
+        it++;
+        if (rel <= tol) break;
+
+        apply_precond(&M, r, z, n);
+        rz_old = rz;
+        rz = dot(r, z, n);
+        beta = rz / rz_old;
+        for (i = 0; i < n; i++) p[i] = z[i] + beta * p[i];
+    }
+    if (status == 0 && rel > tol) status = 1;
+
+    stats->iterations = it;
+    stats->residual = rel;
+    free_dvector(r);
+    free_dvector(z);
+    free_dvector(p);
+    free_dvector(q);
+    free_precond(&M);
+    return status;
+}
@@ -0,0 +1,44 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+
+/* compressed sparse row storage: the entries of row i are
+   col_idx[row_ptr[i] .. row_ptr[i+1]-1] and val[...], columns ascending */
+typedef struct {
+    long n_rows, n_cols;
+    long nnz;
+    long *row_ptr;      // n_rows + 1 offsets
+    int *col_idx;       // nnz column indices, 0-based
+    double *val;        // nnz values
+} csr_matrix;
+
+int coo_to_csr(csr_matrix *A, long n_rows, long n_cols, long nnz,
+               const int *row, const int *col, const double *val);
+
+void free_csr(csr_matrix *A);
+
+float **csr_to_matrix(const csr_matrix *A);
+
+double **csr_to_dmatrix(const csr_matrix *A);
+
+int dmatrix_to_csr(double **D, long n_rows, long n_cols, csr_matrix *A);
+
+int csr_is_symmetric(const csr_matrix *A, double tol);
+
+void csr_matvec(const csr_matrix *A, const double *x, double *y);
+
+
+/* preconditioned conjugate gradients, for sparse SPD systems */
+typedef enum { PRECOND_NONE, PRECOND_JACOBI, PRECOND_IC0 } pcg_precond;
+
+typedef struct {
+    int iterations;
+    double residual;        // final ||b - A x|| / ||b||
+    double *history;        // if not NULL, filled with the relative residual of
+                            // iterations 0..iterations (room for max_iter + 1)
+    pcg_precond precond;    // the preconditioner actually used
+} pcg_stats;
+
+int pcg_solve(const csr_matrix *A, const double *b, double *x, pcg_precond pc,
+              double tol, int max_iter, pcg_stats *stats);
+
+#endif
@@ -0,0 +1,389 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include "util.h"
+#include "taskdag.h"
+
+// failed steal rounds before an idle worker yields its core
+#define TASK_SPIN 64
+
+
+/* one deque per worker, cache-line aligned so owners do not share lines.
+   Ready tasks are buf[head .. tail) modulo cap (a power of two); the owner
+   works at the tail, thieves at the head. A mutex per deque is plenty for
+   tasks of a tile's worth of flops. */
+typedef struct {
+    pthread_mutex_t lock;
+    uint64_t *buf;
+    long head, tail, cap;
+} __attribute__((aligned(64))) task_deque;
+
+struct task_pool {
+    task_deque *q;
+    int nthreads;
+    long ntasks;
+    long done;      // tasks finished, atomic
+    int aborted;    // atomic
+    task_fn run;
+    void *ctx;
+};
+
+typedef struct {
+    task_pool *pool;
+    int id;
+    uint64_t seed;  // victim choice
+} task_worker;
+
+
+// threads for the pool: the argument, then TASK_NUM_THREADS, then the online CPUs
+int task_threads(int nthreads) {
+    const char *env = getenv("TASK_NUM_THREADS");
+    long t = (nthreads > 0) ? nthreads : (env != NULL) ? atol(env) : sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (t > TASK_MAX_THREADS) t = TASK_MAX_THREADS;
+    return (t < 1) ? 1 : (int)t;
+}
+
+void task_push(task_pool *pool, int worker, uint64_t task) {
+    task_deque *d = &pool->q[worker];
+
+    pthread_mutex_lock(&d->lock);
+    if (d->tail - d->head == d->cap) { // full: double, keeping the order
+        long cap = 2 * d->cap, k;
+        uint64_t *buf = malloc((size_t)cap * sizeof(uint64_t));
+        if (buf == NULL) nrerror("allocation failure in task_push()");
+        for (k = d->head; k < d->tail; k++) buf[k & (cap - 1)] = d->buf[k & (d->cap - 1)];
+        free(d->buf);
+        d->buf = buf;
+        d->cap = cap;
+    }
+    d->buf[d->tail++ & (d->cap - 1)] = task;
+    pthread_mutex_unlock(&d->lock);
+}
+
+// the newest task of the own deque (from_top = 0) or the oldest of a victim's
+static int task_take(task_deque *d, int from_top, uint64_t *task) {
+    int found = 0;
+
+    pthread_mutex_lock(&d->lock);
+    if (d->tail > d->head) {
+        *task = from_top ? d->buf[d->head++ & (d->cap - 1)] : d->buf[--d->tail & (d->cap - 1)];
+        found = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return found;
+}
+
+void task_pool_abort(task_pool *pool) {
+    __atomic_store_n(&pool->aborted, 1, __ATOMIC_RELEASE);
+}
+
+static void *task_loop(void *arg) {
+    task_worker *w = arg;
+    task_pool *p = w->pool;
+    uint64_t task;
+    int idle = 0, k, victim;
+
+    while (!__atomic_load_n(&p->aborted, __ATOMIC_ACQUIRE) && __atomic_load_n(&p->done, __ATOMIC_ACQUIRE) < p->ntasks) {
+        int found = task_take(&p->q[w->id], 0, &task);
+
+        // steal: every other deque once, from a random start (xorshift)
+        if (!found && p->nthreads > 1) {
+            w->seed ^= w->seed << 13;
+            w->seed ^= w->seed >> 7;
+            w->seed ^= w->seed << 17;
+            victim = (int)(w->seed % (uint64_t)p->nthreads);
+            for (k = 0; k < p->nthreads && !found; k++, victim = (victim + 1) % p->nthreads) {
+                if (victim != w->id) found = task_take(&p->q[victim], 1, &task);
+            }
+        }
+        if (found) {
+            p->run(p, task, w->id, p->ctx);
+            __atomic_fetch_add(&p->done, 1, __ATOMIC_ACQ_REL);
+            idle = 0;
+        } else if (++idle >= TASK_SPIN) {
+            sched_yield();
+            idle = 0;
+        }
+    }
+    return NULL;
+}
+
+/* run ntasks tasks, starting from the nready ones in ready[] (dealt round
+   robin over the workers), on nthreads threads. Returns 0, or -1 if a task
+   aborted the run. */
+int task_pool_run(int nthreads, long ntasks, const uint64_t *ready, long nready, task_fn run, void *ctx) {
+    pthread_t tid[TASK_MAX_THREADS];
+    int started[TASK_MAX_THREADS];
+    task_worker workers[TASK_MAX_THREADS];
+    task_pool pool;
+    long k;
+    int t;
+
+    if (nthreads > TASK_MAX_THREADS) nthreads = TASK_MAX_THREADS;
+    if (nthreads < 1) nthreads = 1;
+    pool = (task_pool){ NULL, nthreads, ntasks, 0, 0, run, ctx };
+    if (posix_memalign((void **)&pool.q, 64, (size_t)nthreads * sizeof(task_deque)) != 0) nrerror("allocation failure in task_pool_run()");
+    for (t = 0; t < nthreads; t++) {
+        task_deque *d = &pool.q[t];
+        pthread_mutex_init(&d->lock, NULL);
+        d->head = d->tail = 0;
+        d->cap = 64;
+        while (d->cap < nready / nthreads + 1) d->cap *= 2;
+        if ((d->buf = malloc((size_t)d->cap * sizeof(uint64_t))) == NULL) nrerror("allocation failure in task_pool_run()");
+    }
+    for (k = 0; k < nready; k++) task_push(&pool, (int)(k % nthreads), ready[k]);
+
+    for (t = 0; t < nthreads; t++) workers[t] = (task_worker){ &pool, t, 0x9E3779B97F4A7C15ULL * (uint64_t)(t + 1) };
+    for (t = 1; t < nthreads; t++) started[t] = (pthread_create(&tid[t], NULL, task_loop, &workers[t]) == 0);
+    task_loop(&workers[0]); // a worker that did not start leaves its deque to the thieves
+    for (t = 1; t < nthreads; t++) {
+        if (started[t]) pthread_join(tid[t], NULL);
+    }
+
+    for (t = 0; t < nthreads; t++) {
+        pthread_mutex_destroy(&pool.q[t].lock);
+        free(pool.q[t].buf);
+    }
+    free(pool.q);
+    return pool.aborted ? -1 : 0;
+}
+
+
+
+/* the Cholesky DAG on nt x nt tiles of nb x nb (the last ones padded with
+   the identity, so every kernel sees full tiles). Only the lower tiles
+   exist. With L(i,k) the final tile (i,k) of the factor, the tasks are
+
+     POTRF(k)       L(k,k) = chol(A(k,k))
+     TRSM(i,k)      L(i,k) = A(i,k) L(k,k)^-T                   i > k
+     SYRK(i,k)      A(i,i) -= L(i,k) L(i,k)^T                   i > k
+     GEMM(i,j,k)    A(i,j) -= L(i,k) L(j,k)^T                   i > j > k
+
+   and the updates of one tile run in the order of k. */
+enum { T_POTRF, T_TRSM, T_SYRK, T_GEMM };
+
+#define TASK_ID(type, i, j, k) ((uint64_t)(type) << 60 | (uint64_t)(i) << 40 | (uint64_t)(j) << 20 | (uint64_t)(k))
+#define TASK_FIELD(id, shift) ((int)(((id) >> (shift)) & 0xFFFFF))
+
+typedef struct {
+    int n, nt, nb;
+    double *a;          // the caller's column-major matrix
+    int lda;
+    double *tiles;      // tile (i, j), i >= j, row-major at TILE(d, i, j)
+    int *dep;           // outstanding inputs of every task, see dep_slot()
+    long trsm0, syrk0, gemm0; // first slot of each task type
+    double *scratch;    // one transposed tile per worker
+    int info;           // first failed pivot + 1
+} chol_dag;
+
+#define TILE(d, i, j) ((d)->tiles + ((size_t)(i) * ((i) + 1) / 2 + (j)) * (d)->nb * (d)->nb)
+
+// counter of a task: POTRF by k, TRSM and SYRK by the strict lower (i, k), GEMM by the tetrahedron (i, j, k)
+static long dep_slot(const chol_dag *d, int type, int i, int j, int k) {
+    switch (type) {
+        case T_POTRF: return k;
+        case T_TRSM: return d->trsm0 + (long)i * (i - 1) / 2 + k;
+        case T_SYRK: return d->syrk0 + (long)i * (i - 1) / 2 + k;
+        default: return d->gemm0 + (long)i * (i - 1) * (i - 2) / 6 + (long)j * (j - 1) / 2 + k;
+    }
+}
+
+// one input of a task is final; the last one makes it ready on this worker
+static void release(task_pool *pool, int worker, chol_dag *d, int type, int i, int j, int k) {
+    if (__atomic_sub_fetch(&d->dep[dep_slot(d, type, i, j, k)], 1, __ATOMIC_ACQ_REL) == 0) {
+        task_push(pool, worker, TASK_ID(type, i, j, k));
+    }
+}
+
+
+// T = S^T of an nb x nb tile
+static void transpose_tile(double *T, const double *S, int nb) {
+    for (int r = 0; r < nb; r++) {
+        for (int c = 0; c < nb; c++) T[(size_t)c * nb + r] = S[(size_t)r * nb + c];
+    }
+}
+
+// unblocked Cholesky of the lower triangle of a tile; 0, or r+1 for a bad pivot in row r
+static int potrf_tile(double *A, int nb) {
+    int i, j, k;
+    double sum;
+
+    for (i = 0; i < nb; i++) {
+        double *ai = A + (size_t)i * nb;
+        for (j = 0; j <= i; j++) {
+            const double *aj = A + (size_t)j * nb;
+            sum = ai[j];
+            for (k = 0; k < j; k++) sum -= ai[k] * aj[k];
+            if (i == j) {
+                if (sum <= 0.0 || isnan(sum)) return i + 1;
+                ai[i] = sqrt(sum);
+            } else {
+                ai[j] = sum / aj[j];
+            }
+        }
+    }
+    return 0;
+}
+
+// B = B L^-T, each row a forward substitution along the rows of Lt = L^T
+__attribute__((target_clones("avx2", "default")))
+static void trsm_tile(double *B, const double *Lt, int nb) {
+    for (int r = 0; r < nb; r++) {
+        double *b = B + (size_t)r * nb;
+        for (int j = 0; j < nb; j++) {
+            const double *lt = Lt + (size_t)j * nb;
+            double x = b[j] / lt[j];
+            b[j] = x;
+            for (int c = j + 1; c < nb; c++) b[c] -= x * lt[c];
+        }
+    }
+}
+
+// C -= A B^T with Bt = B^T transposed beforehand: 4 x 8 register tiles, k innermost
+__attribute__((target_clones("avx2", "default")))
+static void gemm_tile(double *C, const double *A, const double *Bt, int nb) {
+    for (int i0 = 0; i0 < nb; i0 += 4) {
+        for (int j0 = 0; j0 < nb; j0 += 8) {
+            double acc[4][8] = {{0.0}};
+            for (int k = 0; k < nb; k++) {
+                const double *b = Bt + (size_t)k * nb + j0;
+                for (int r = 0; r < 4; r++) {
+                    double a = A[(size_t)(i0 + r) * nb + k];
+                    for (int c = 0; c < 8; c++) acc[r][c] += a * b[c];
+                }
+            }
+            for (int r = 0; r < 4; r++) {
+                double *cr = C + (size_t)(i0 + r) * nb + j0;
+                for (int c = 0; c < 8; c++) cr[c] -= acc[r][c];
+            }
+        }
+    }
+}
+
+static void chol_task(task_pool *pool, uint64_t id, int worker, void *ctx) {
+    chol_dag *d = ctx;
+    int type = (int)(id >> 60), i = TASK_FIELD(id, 40), j = TASK_FIELD(id, 20), k = TASK_FIELD(id, 0);
+    int nb = d->nb, r, info;
+    double *tmp = d->scratch + (size_t)worker * nb * nb;
+
+    switch (type) {
+        case T_POTRF:
+            if ((info = potrf_tile(TILE(d, k, k), nb)) != 0) {
+                __atomic_store_n(&d->info, k * nb + info, __ATOMIC_RELAXED);
+                task_pool_abort(pool);
+                return;
+            }
+            // the owner pops the last push first: the next panel's TRSM
+            for (r = d->nt - 1; r > k; r--) release(pool, worker, d, T_TRSM, r, 0, k);
+            break;
+        case T_TRSM:
+            transpose_tile(tmp, TILE(d, k, k), nb);
+            trsm_tile(TILE(d, i, k), tmp, nb);
+            // L(i,k) feeds row i and column i of the trailing matrix; columns nearest the
+            // next panel are pushed last so they run first
+            for (r = d->nt - 1; r > i; r--) release(pool, worker, d, T_GEMM, r, i, k);
+            release(pool, worker, d, T_SYRK, i, 0, k);
+            for (r = i - 1; r > k; r--) release(pool, worker, d, T_GEMM, i, r, k);
+            break;
+        case T_SYRK: // the full tile: its upper half is never read
+            transpose_tile(tmp, TILE(d, i, k), nb);
+            gemm_tile(TILE(d, i, i), TILE(d, i, k), tmp, nb);
+            if (k + 1 < i) release(pool, worker, d, T_SYRK, i, 0, k + 1);
+            else release(pool, worker, d, T_POTRF, 0, 0, i);
+            break;
+        default:
+            transpose_tile(tmp, TILE(d, j, k), nb);
+            gemm_tile(TILE(d, i, j), TILE(d, i, k), tmp, nb);
+            if (k + 1 < j) release(pool, worker, d, T_GEMM, i, j, k + 1);
+            else release(pool, worker, d, T_TRSM, i, 0, j);
+            break;
+    }
+}
+
+// tile (i, j) in from the column-major matrix (dir = 0) or back out (dir = 1), lower part only
+static void copy_task(task_pool *pool, uint64_t id, int worker, void *ctx) {
+    chol_dag *d = ctx;
+    int i = TASK_FIELD(id, 40), j = TASK_FIELD(id, 20), dir = TASK_FIELD(id, 0), nb = d->nb, r, c;
+    int rows = (d->n - i * nb < nb) ? d->n - i * nb : nb, cols = (d->n - j * nb < nb) ? d->n - j * nb : nb;
+    double *t = TILE(d, i, j);
+    (void)pool; (void)worker;
+
+    for (c = 0; c < cols; c++) {
+        double *col = d->a + (size_t)(j * nb + c) * d->lda + (size_t)i * nb;
+        for (r = (i == j) ? c : 0; r < rows; r++) {
+            if (dir == 0) t[(size_t)r * nb + c] = col[r];
+            else col[r] = t[(size_t)r * nb + c];
+        }
+        for (r = 0; dir == 0 && i == j && r < c; r++) t[(size_t)r * nb + c] = 0.0; // upper half of a diagonal tile
+    }
+    if (dir == 0 && (rows < nb || cols < nb)) { // padding: the identity on the diagonal, zeros elsewhere
+        for (r = 0; r < nb; r++) {
+            for (c = 0; c < nb; c++) {
+                if (r >= rows || c >= cols) t[(size_t)r * nb + c] = (i == j && r == c) ? 1.0 : 0.0;
+            }
+        }
+    }
+}
+
+/* A = L L^T for the lower triangle of the column-major n x n matrix a, as
+   dpotrf('L'); the strict upper triangle is not touched. nthreads <= 0 takes
+   TASK_NUM_THREADS, then the online CPUs. Returns 0, or k+1 if the pivot of
+   column k is not positive (a is then left unchanged). */
+int task_potrf(int n, double *a, int lda, int nthreads) {
+    chol_dag d;
+    uint64_t *ready, first = TASK_ID(T_POTRF, 0, 0, 0);
+    long ntiles, ntasks, s;
+    int i, j, k, nt;
+
+    if (n <= 0) return 0;
+    nthreads = task_threads(nthreads);
+    d.n = n;
+    // as many tiles as TASK_TILE needs, then as small as they can be: little padding
+    d.nt = nt = (n + TASK_TILE - 1) / TASK_TILE;
+    d.nb = ((n + nt - 1) / nt + 7) / 8 * 8;
+    d.a = a;
+    d.lda = lda;
+    d.info = 0;
+    ntiles = (long)nt * (nt + 1) / 2;
+    d.trsm0 = nt;
+    d.syrk0 = d.trsm0 + (long)nt * (nt - 1) / 2;
+    d.gemm0 = d.syrk0 + (long)nt * (nt - 1) / 2;
+    ntasks = d.gemm0 + (long)nt * (nt - 1) * (nt - 2) / 6;
+
+    if (posix_memalign((void **)&d.tiles, 64, (size_t)ntiles * d.nb * d.nb * sizeof(double)) != 0
+        || posix_memalign((void **)&d.scratch, 64, (size_t)nthreads * d.nb * d.nb * sizeof(double)) != 0) {
+        nrerror("allocation failure in task_potrf()");
+    }
+    d.dep = malloc((size_t)ntasks * sizeof(int));
+    ready = malloc((size_t)ntiles * sizeof(uint64_t));
+    if (d.dep == NULL || ready == NULL) nrerror("allocation failure in task_potrf()");
+
+    // inputs of every task: the tasks it reads plus the previous update of its own tile
+    for (k = 0; k < nt; k++) {
+        d.dep[dep_slot(&d, T_POTRF, 0, 0, k)] = (k > 0);
+        for (i = k + 1; i < nt; i++) {
+            d.dep[dep_slot(&d, T_TRSM, i, 0, k)] = 1 + (k > 0);
+            d.dep[dep_slot(&d, T_SYRK, i, 0, k)] = 1 + (k > 0);
+            for (j = k + 1; j < i; j++) d.dep[dep_slot(&d, T_GEMM, i, j, k)] = 2 + (k > 0);
+        }
+    }
+
+    for (s = 0, i = 0; i < nt; i++) for (j = 0; j <= i; j++) ready[s++] = TASK_ID(0, i, j, 0);
+    task_pool_run(nthreads, ntiles, ready, ntiles, copy_task, &d);
+    task_pool_run(nthreads, ntasks, &first, 1, chol_task, &d);
+    if (d.info == 0) {
+        for (s = 0; s < ntiles; s++) ready[s] |= 1; // dir = 1: copy the factor back
+        task_pool_run(nthreads, ntiles, ready, ntiles, copy_task, &d);
+    }
+
+    free(d.tiles);
+    free(d.scratch);
+    free(d.dep);
+    free(ready);
+    return d.info;
+}
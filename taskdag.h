@@ -0,0 +1,44 @@
+#ifndef TASKDAG_H
+#define TASKDAG_H
+
+#include <stdint.h>
+
+/* work-stealing pool for algorithms written as a DAG of tasks.
+
+   A task is a 64-bit id the algorithm decodes itself. Every worker owns a
+   deque of ready tasks: what its own tasks make ready goes to the bottom and
+   is popped from there first (newest, its data still in cache), while an
+   idle worker steals from the top of another deque (oldest). Running a task
+   may push more; the pool ends once the announced number of tasks has run,
+   or at the first task_pool_abort(). Worker 0 is the calling thread. */
+
+#ifndef TASK_MAX_THREADS
+#define TASK_MAX_THREADS 256
+#endif
+
+typedef struct task_pool task_pool;
+
+typedef void (*task_fn)(task_pool *pool, uint64_t task, int worker, void *ctx);
+
+int task_threads(int nthreads);
+
+int task_pool_run(int nthreads, long ntasks, const uint64_t *ready, long nready, task_fn run, void *ctx);
+
+void task_push(task_pool *pool, int worker, uint64_t task);
+
+void task_pool_abort(task_pool *pool);
+
+
+/* tiled Cholesky whose POTRF / TRSM / SYRK / GEMM tile tasks run as soon as
+   their inputs are final, so the next panel is factored while the trailing
+   updates of the previous ones are still running (no barrier per panel).
+   Same interface as LAPACK's dpotrf with uplo = 'L', see backend.h. */
+
+// tile size (a multiple of 8); override with -DTASK_TILE=<nb>
+#ifndef TASK_TILE
+#define TASK_TILE 128
+#endif
+
+int task_potrf(int n, double *a, int lda, int nthreads);
+
+#endif
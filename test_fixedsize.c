@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "fixedsize.h"
+
+/* the unrolled Gauss-Jordan kernels against the rules of the general
+   gauss_jordan_multi_info(): the pivot is tested in double against 1e-12,
+   so 1e-12f (just below it) fails and the next float up passes, at every
+   step k; and on random diagonally dominant systems the solution matches a
+   double-precision elimination. Run by `make check`. */
+
+#define MAX_M 8
+
+static long failures;
+
+// identity with pivot p at step k, B = e_k: fails at k + 1, or gives x_k = 1 / p
+static void check_pivot(const fixed_kernels *fk, int k, float p, int expect) {
+    float rows[FIXED_KERNEL_MAX][FIXED_KERNEL_MAX + 1], *A[FIXED_KERNEL_MAX];
+    int n = fk->n, i, j, info;
+
+    for (i = 0; i < n; i++) {
+        A[i] = rows[i];
+        for (j = 0; j <= n; j++) rows[i][j] = (i == j) ? 1.0f : 0.0f;
+    }
+    rows[k][k] = p;
+    rows[k][n] = 1.0f;
+    info = fk->gj(A, 1);
+    if (info != expect && failures++ < 10) fprintf(stderr, "N=%d pivot %a at step %d: info %d, expected %d\n", n, (double)p, k, info, expect);
+}
+
+// random diagonally dominant [A | B], solved by the kernel and in double
+static void check_solve(const fixed_kernels *fk, int m, unsigned long long *state) {
+    float rows[FIXED_KERNEL_MAX][FIXED_KERNEL_MAX + MAX_M], *A[FIXED_KERNEL_MAX];
+    double ref[FIXED_KERNEL_MAX][FIXED_KERNEL_MAX + MAX_M], f, err = 0.0;
+    int n = fk->n, c = n + m, i, j, k;
+
+    for (i = 0; i < n; i++) {
+        A[i] = rows[i];
+        for (j = 0; j < c; j++) {
+            *state ^= *state << 13;
+            *state ^= *state >> 7;
+            *state ^= *state << 17;
+            rows[i][j] = (float)((double)(*state >> 11) / 9007199254740992.0 - 0.5);
+        }
+        rows[i][i] += (float)n;
+        for (j = 0; j < c; j++) ref[i][j] = rows[i][j];
+    }
+    for (k = 0; k < n; k++) { // no pivoting needed, the diagonal dominates
+        for (j = c - 1; j >= k; j--) ref[k][j] /= ref[k][k];
+        for (i = 0; i < n; i++) {
+            if (i == k) continue;
+            f = ref[i][k];
+            for (j = k; j < c; j++) ref[i][j] -= f * ref[k][j];
+        }
+    }
+    if (fk->gj(A, m) != 0) err = INFINITY;
+    for (i = 0; i < n; i++) {
+        for (j = n; j < c; j++) err = fmax(err, fabs(rows[i][j] - ref[i][j]));
+    }
+    if (!(err <= 1e-5) && failures++ < 10) fprintf(stderr, "N=%d m=%d: max error %.3e\n", n, m, err);
+}
+
+int main(void) {
+    const fixed_kernels *fk;
+    unsigned long long state = 88172645463325252ULL;
+    float below = 1e-12f, above = nextafterf(1e-12f, 1.0f);
+    long count = 0;
+    int n, k, m, rep;
+
+    if ((double)below >= 1e-12 || (double)above < 1e-12) {
+        fprintf(stderr, "1e-12f does not sit just below 1e-12, the pivot cases test nothing\n");
+        return EXIT_FAILURE;
+    }
+    for (n = 2; n <= FIXED_KERNEL_MAX; n++) {
+        if ((fk = fixed_kernels_for(n)) == NULL) continue; // built with a smaller FIXED_MAX_N
+        for (k = 0; k < n; k++, count += 3) {
+            check_pivot(fk, k, below, k + 1);
+            check_pivot(fk, k, above, 0);
+            check_pivot(fk, k, 0.0f, k + 1);
+        }
+        for (m = 1; m <= fk->max_m && m <= MAX_M; m++) {
+            for (rep = 0; rep < 20; rep++, count++) check_solve(fk, m, &state);
+        }
+    }
+
+    printf("fixed-size Gauss-Jordan: %ld case(s), %ld failure(s)\n", count, failures);
+    return failures ? EXIT_FAILURE : 0;
+}
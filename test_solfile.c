@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+#include "solfile.h"
+
+/* round trip of the shortest-digits formatter: every power of two in float
+   and double (the gap below them is half the one above), their neighbours,
+   and a sweep of random bit patterns must read back as the same value.
+   Run by `make check`; exits nonzero on the first mismatches. */
+
+static long failures;
+
+static void check_float(float v) {
+    char text[64];
+    float r;
+
+    format_float(text, v);
+    r = strtof(text, NULL);
+    if (r != v && failures++ < 10) fprintf(stderr, "float %a -> %s -> %a\n", (double)v, text, (double)r);
+}
+
+static void check_double(double v) {
+    char text[64];
+    double r;
+
+    format_double(text, v);
+    r = strtod(text, NULL);
+    if (r != v && failures++ < 10) fprintf(stderr, "double %a -> %s -> %a\n", v, text, r);
+}
+
+int main(void) {
+    long count = 0;
+    int e;
+    unsigned long long bits = 88172645463325252ULL;
+
+    for (e = FLT_MIN_EXP - FLT_MANT_DIG; e < FLT_MAX_EXP; e++, count += 6) {
+        float v = ldexpf(1.0f, e);
+        check_float(v);
+        check_float(-v);
+        check_float(nextafterf(v, 0.0f));
+        check_float(nextafterf(v, INFINITY));
+        check_float(-nextafterf(v, 0.0f));
+        check_float(-nextafterf(v, INFINITY));
+    }
+    for (e = DBL_MIN_EXP - DBL_MANT_DIG; e < DBL_MAX_EXP; e++, count += 6) {
+        double v = ldexp(1.0, e);
+        check_double(v);
+        check_double(-v);
+        check_double(nextafter(v, 0.0));
+        check_double(nextafter(v, INFINITY));
+        check_double(-nextafter(v, 0.0));
+        check_double(-nextafter(v, INFINITY));
+    }
+    // xorshift over the bit patterns, skipping inf and nan
+    for (long i = 0; i < 1000000; i++, count += 2) {
+        float f;
+        double d;
+        unsigned int fb;
+
+        bits ^= bits << 13;
+        bits ^= bits >> 7;
+        bits ^= bits << 17;
+        fb = (unsigned int)bits;
+        __builtin_memcpy(&f, &fb, sizeof(f));
+        __builtin_memcpy(&d, &bits, sizeof(d));
+        if (isfinite(f)) check_float(f);
+        if (isfinite(d)) check_double(d);
+    }
+
+    printf("solfile round trip: %ld value(s), %ld failure(s)\n", count, failures);
+    return failures ? EXIT_FAILURE : 0;
+}
@@ -1,7 +1,15 @@
 #include<stdio.h>
 #include<stdlib.h>
 #include<stddef.h>
+#include<string.h>
 #include<math.h>
+#include<time.h>
+#include<unistd.h>
+#ifdef __linux__
+#include<sys/syscall.h>
+#include<linux/perf_event.h>
+#endif
+#include "util.h"
 
 
 
@@ -14,30 +22,322 @@ void nrerror(char error_text[])
 }
 
 
-void print_matrix(float **mat, long length_row, long length_col, const char *name) {
-    printf("%s [%ld..%ld]:\n", name, length_row, length_col);
-    for (long i = 0; i < length_row; i++) {
-        printf("  [ ");
-        for (long j = 0; j < length_col; j++) {
-            float val = mat[i][j];
-            if (fabs(val) < 1e-12) val = 0.0; // Prevent printing -0.0000
-            printf("%10.4f ", val);
+// seconds on the monotonic clock, for timing stretches of code
+double wall_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + 1.0e-9 * (double)ts.tv_nsec;
+}
+
+
+/* per-phase timers behind PROF_BEGIN/PROF_END, on when SOLVER_PROFILE is set.
+   Phases are kept in order of first use and reported by an atexit handler.
+   The hardware counters are per process (inherit: threads started inside a
+   phase are counted once they are joined); without perf_event_open access
+   the table just has no counter columns. Not thread-safe: main thread only. */
+#define PROF_MAX_PHASES 32
+enum { PROF_CYCLES, PROF_INSTRUCTIONS, PROF_LLC_MISSES, PROF_COUNTERS };
+
+typedef struct {
+    const char *name;
+    long calls;
+    double seconds, start;
+    long long count[PROF_COUNTERS], count_start[PROF_COUNTERS];
+} prof_phase;
+
+static prof_phase prof_phases[PROF_MAX_PHASES];
+static int prof_nphases;
+static int prof_state = -1; // -1: SOLVER_PROFILE not looked at yet
+static int prof_fd[PROF_COUNTERS] = { -1, -1, -1 };
+static double prof_t0;
+
+static int perf_counter_open(unsigned int type, unsigned long long config) {
+#ifdef __linux__
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    (void)type; (void)config;
+    return -1;
+#endif
+}
+
+static void prof_read(long long *v) {
+    for (int c = 0; c < PROF_COUNTERS; c++) {
+        if (prof_fd[c] < 0 || read(prof_fd[c], &v[c], sizeof(v[c])) != (ssize_t)sizeof(v[c])) v[c] = -1;
+    }
+}
+
+static void prof_report(void) {
+    double total = wall_time() - prof_t0;
+    int counters = (prof_fd[PROF_CYCLES] >= 0 || prof_fd[PROF_INSTRUCTIONS] >= 0 || prof_fd[PROF_LLC_MISSES] >= 0);
+
+    if (prof_nphases == 0) return;
+    printf("\nPhase breakdown (%.6f s since the first phase):\n", total);
+    printf("  %-14s %6s %12s %7s", "phase", "calls", "seconds", "%");
+    if (counters) printf(" %15s %15s %6s %13s", "cycles", "instructions", "IPC", "LLC misses");
+    printf("\n");
+    for (int i = 0; i < prof_nphases; i++) {
+        const prof_phase *ph = &prof_phases[i];
+        printf("  %-14s %6ld %12.6f %6.1f%%", ph->name, ph->calls, ph->seconds, (total > 0.0) ? 100.0 * ph->seconds / total : 0.0);
+        if (counters) {
+            for (int c = 0; c < 2; c++) {
+                if (ph->count[c] >= 0) printf(" %15lld", ph->count[c]);
+                else printf(" %15s", "-");
+            }
+            if (ph->count[PROF_CYCLES] > 0 && ph->count[PROF_INSTRUCTIONS] >= 0) {
+                printf(" %6.2f", (double)ph->count[PROF_INSTRUCTIONS] / (double)ph->count[PROF_CYCLES]);
+            } else printf(" %6s", "-");
+            if (ph->count[PROF_LLC_MISSES] >= 0) printf(" %13lld", ph->count[PROF_LLC_MISSES]);
+            else printf(" %13s", "-");
+        }
+        printf("\n");
+    }
+}
+
+static int prof_enabled(void) {
+    const char *env;
+
+    if (prof_state >= 0) return prof_state;
+    env = getenv("SOLVER_PROFILE");
+    prof_state = (env != NULL && *env != '\0' && strcmp(env, "0") != 0);
+    if (prof_state) {
+        prof_fd[PROF_CYCLES] = perf_counter_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        prof_fd[PROF_INSTRUCTIONS] = perf_counter_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        prof_fd[PROF_LLC_MISSES] = perf_counter_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        prof_t0 = wall_time();
+        atexit(prof_report);
+    }
+    return prof_state;
+}
+
+static prof_phase *prof_find(const char *name) {
+    int i;
+
+    for (i = 0; i < prof_nphases; i++) {
+        if (prof_phases[i].name == name || strcmp(prof_phases[i].name, name) == 0) return &prof_phases[i];
+    }
+    if (prof_nphases == PROF_MAX_PHASES) return NULL;
+    prof_phases[i].name = name;
+    prof_nphases++;
+    return &prof_phases[i];
+}
+
+void prof_begin(const char *name) {
+    prof_phase *ph;
+
+    if (!prof_enabled() || (ph = prof_find(name)) == NULL) return;
+    prof_read(ph->count_start);
+    ph->start = wall_time();
+}
+
+void prof_end(const char *name) {
+    long long now[PROF_COUNTERS];
+    prof_phase *ph;
+    double t;
+
+    if (!prof_enabled() || (ph = prof_find(name)) == NULL) return;
+    t = wall_time();
+    prof_read(now);
+    ph->calls++;
+    ph->seconds += t - ph->start;
+    for (int c = 0; c < PROF_COUNTERS; c++) {
+        if (now[c] < 0 || ph->count_start[c] < 0) ph->count[c] = -1;
+        else if (ph->count[c] >= 0) ph->count[c] += now[c] - ph->count_start[c];
+    }
+}
+
+
+/* matrix and vector printing, see util.h. The level is set once by the
+   driver; every print_*() call checks it. */
+static verbosity print_level = VERBOSITY_AUTO;
+
+enum { TRI_NONE, TRI_MIRROR, TRI_ZERO }; // full rows, or packed lower shown symmetric or triangular
+
+typedef struct {
+    float **f;              // one of f and d is set
+    double **d;
+    int tri;
+} print_src;
+
+typedef struct {
+    long nnz;
+    double min, max;
+    double norm_1, norm_inf, sumsq;  // of a vector: sum |x|, max |x| and sum x^2
+} print_stats;
+
+/* the text after --verbosity=; returns 0, or -1 if unknown */
+int verbosity_parse(const char *arg, verbosity *level) {
+    if (strcmp(arg, "quiet") == 0) *level = VERBOSITY_QUIET;
+    else if (strcmp(arg, "summary") == 0) *level = VERBOSITY_SUMMARY;
+    else if (strcmp(arg, "full") == 0) *level = VERBOSITY_FULL;
+    else if (strcmp(arg, "auto") == 0) *level = VERBOSITY_AUTO;
+    else return -1;
+    return 0;
+}
+
+void set_verbosity(verbosity level) {
+    print_level = level;
+}
+
+// what a rows x cols print comes to at the current level
+static verbosity print_resolve(long rows, long cols) {
+    if (print_level != VERBOSITY_AUTO) return print_level;
+    return (rows <= PRINT_FULL_MAX && cols <= PRINT_FULL_MAX) ? VERBOSITY_FULL : VERBOSITY_SUMMARY;
+}
+
+// one element of a float (f) or double (d) matrix; packed lower (tri_matrix()) ones mirror or show zeros above
+static inline double print_elem(const print_src *src, long i, long j) {
+    if (src->tri != TRI_NONE && j > i) {
+        if (src->tri == TRI_ZERO) return 0.0;
+        long t = i; i = j; j = t;
+    }
+    return (src->f != NULL) ? (double)src->f[i][j] : src->d[i][j];
+}
+
+#define PRINT_VALUE_MAX 330  // "%10.4f " of DBL_MAX
+
+// one "%10.4f " without -0.0000, appended at buf + len; needs PRINT_VALUE_MAX bytes
+static size_t print_value(char *buf, size_t len, double val) {
+    if (fabs(val) < 1e-12) val = 0.0;
+    return len + (size_t)snprintf(buf + len, PRINT_VALUE_MAX, "%10.4f ", val);
+}
+
+/* every row, formatted into a PRINT_BUFFER_BYTES block that goes to stdout
+   with one fwrite() instead of a printf() per element */
+static void print_full(const print_src *src, long rows, long cols) {
+    char buf[PRINT_BUFFER_BYTES];
+    size_t len = 0;
+
+    for (long i = 0; i < rows; i++) {
+        for (long j = -1; j <= cols; j++) {
+            if (len + PRINT_VALUE_MAX > sizeof(buf)) { fwrite(buf, 1, len, stdout); len = 0; }
+            if (j < 0) len += (size_t)snprintf(buf + len, 8, "  [ ");
+            else if (j == cols) len += (size_t)snprintf(buf + len, 8, "]\n");
+            else len = print_value(buf, len, print_elem(src, i, j));
+        }
+    }
+    buf[len++] = '\n';
+    fwrite(buf, 1, len, stdout);
+}
+
+/* nnz, min, max and the norms in one pass over the elements; col_sum holds
+   cols zeros (matrices) or is NULL (vectors, a single row) */
+static void print_scan(const print_src *src, long rows, long cols, double *col_sum, print_stats *st) {
+    double val, row_sum;
+
+    st->nnz = 0;
+    st->min = st->max = print_elem(src, 0, 0);
+    st->norm_1 = st->norm_inf = st->sumsq = 0.0;
+    for (long i = 0; i < rows; i++) {
+        row_sum = 0.0;
+        for (long j = 0; j < cols; j++) {
+            val = print_elem(src, i, j);
+            st->nnz += (val != 0.0);
+            if (val < st->min) st->min = val;
+            if (val > st->max) st->max = val;
+            st->sumsq += val * val;
+            if (col_sum != NULL) col_sum[j] += fabs(val);
+            else if (fabs(val) > st->norm_inf) st->norm_inf = fabs(val);
+            row_sum += fabs(val);
+        }
+        if (col_sum == NULL) st->norm_1 = row_sum;
+        else if (row_sum > st->norm_inf) st->norm_inf = row_sum;
+    }
+    for (long j = 0; col_sum != NULL && j < cols; j++) {
+        if (col_sum[j] > st->norm_1) st->norm_1 = col_sum[j];
+    }
+}
+
+// the first and last PRINT_CORNER elements of row i
+static void print_corner_row(const print_src *src, long i, long cols) {
+    char buf[(2 * PRINT_CORNER + 1) * PRINT_VALUE_MAX + 16];
+    size_t len = (size_t)snprintf(buf, 8, "  [ ");
+
+    for (long j = 0; j < cols; j++) {
+        if (j == PRINT_CORNER && cols > 2 * PRINT_CORNER) {
+            len += (size_t)snprintf(buf + len, 16, "%10s ", "...");
+            j = cols - PRINT_CORNER;
+        }
+        len = print_value(buf, len, print_elem(src, i, j));
+    }
+    len += (size_t)snprintf(buf + len, 8, "]\n");
+    fwrite(buf, 1, len, stdout);
+}
+
+static void print_summary(const print_src *src, long rows, long cols) {
+    double *col_sum = dvector(cols);
+    print_stats st;
+
+    for (long j = 0; j < cols; j++) col_sum[j] = 0.0;
+    print_scan(src, rows, cols, col_sum, &st);
+    free(col_sum);
+    printf("  nnz %ld, min %.4e, max %.4e, norm_1 %.4e, norm_inf %.4e, norm_F %.4e\n",
+           st.nnz, st.min, st.max, st.norm_1, st.norm_inf, sqrt(st.sumsq));
+    for (long i = 0; i < rows; i++) {
+        if (i == PRINT_CORNER && rows > 2 * PRINT_CORNER) {
+            printf("  %10s\n", "...");
+            i = rows - PRINT_CORNER;
         }
-        printf("]\n");
+        print_corner_row(src, i, cols);
     }
     printf("\n");
 }
 
+static void print_any(const print_src *src, long rows, long cols, const char *name) {
+    verbosity level = print_resolve(rows, cols);
+
+    if (level == VERBOSITY_QUIET || rows <= 0 || cols <= 0) return;
+    if (level == VERBOSITY_FULL) {
+        printf("%s [%ld..%ld]:\n", name, rows, cols);
+        print_full(src, rows, cols);
+    } else {
+        printf("%s [%ld x %ld], corners:\n", name, rows, cols);
+        print_summary(src, rows, cols);
+    }
+}
+
+void print_matrix(float **mat, long length_row, long length_col, const char *name) {
+    print_src src = { mat, NULL, TRI_NONE };
+    print_any(&src, length_row, length_col, name);
+}
+
+void print_dmatrix(double **mat, long length_row, long length_col, const char *name) {
+    print_src src = { NULL, mat, TRI_NONE };
+    print_any(&src, length_row, length_col, name);
+}
+
+// L from tri_matrix(): a symmetric A stored by its lower triangle, or a triangular factor
+void print_tri_matrix(float **L, long n, int symmetric, const char *name) {
+    print_src src = { L, NULL, symmetric ? TRI_MIRROR : TRI_ZERO };
+    print_any(&src, n, n, name);
+}
 
 void print_vector(float *vec, long length, const char *name) {
-    printf("%s [%ld]:\n", name, length);
-    printf("  [ ");
-    for (long i = 0; i < length; i++) {
-        float val = vec[i];
-         if (fabs(val) < 1e-12) val = 0.0; // Prevent printing -0.0000
-        printf("%10.4f ", val);
+    verbosity level = print_resolve(length, 1);
+    float *row[1] = { vec };
+    print_src src = { row, NULL, TRI_NONE };
+    print_stats st;
+
+    if (level == VERBOSITY_QUIET || length <= 0) return;
+    if (level == VERBOSITY_FULL) {
+        printf("%s [%ld]:\n", name, length);
+        print_full(&src, 1, length);
+        return;
     }
-    printf("]\n\n");
+    print_scan(&src, 1, length, NULL, &st);
+    printf("%s [%ld], ends:\n", name, length);
+    printf("  nnz %ld, min %.4e, max %.4e, norm_1 %.4e, norm_2 %.4e, norm_inf %.4e\n",
+           st.nnz, st.min, st.max, st.norm_1, sqrt(st.sumsq), st.norm_inf);
+    print_corner_row(&src, 0, length);
+    printf("\n");
 }
 
 
@@ -67,11 +367,15 @@ double *dvector(long length) {
 
 
 
+/* the row pointers may be permuted after allocation (lu_factor() swaps them),
+   so matrix() and dmatrix() keep the address of the data block in a hidden
+   slot just before the row pointers, for the free functions to use */
+
 float **matrix(long length_rows, long length_cols) {
     float **m;
     float *m_data;
-    // allocate pointers to rows
-    m = malloc((size_t)(length_rows * sizeof(float *)));
+    // allocate pointers to rows, plus the hidden slot
+    m = malloc((size_t)((length_rows + 1) * sizeof(float *)));
     if (!m) nrerror("allocation failure 1 in matrix()");
 
     m_data = malloc((size_t)(length_rows * length_cols * sizeof(float)));
@@ -79,6 +383,9 @@ float **matrix(long length_rows, long length_cols) {
 
    
 
+    m[0] = m_data;
+    m++;
+
     // allocate rows and set pointers to them
     for (long i = 0; i < length_rows; i++) {
         m[i] = m_data + (size_t)i * length_cols; //link the data to the matrix
@@ -94,11 +401,14 @@ double **dmatrix(long length_rows, long length_cols) {
     double *m_data;
 
     // allocate pointers to rows
-    m = (double **)malloc((size_t)( length_rows * sizeof(double *)));
+    m = (double **)malloc((size_t)((length_rows + 1) * sizeof(double *)));
     if (!m) nrerror("allocation failure 1 in matrix()");
     m_data = (double *)malloc((size_t)(length_rows * length_cols * sizeof(double)));
     if (!m_data) nrerror("allocation failure 2 in matrix()");
 
+    m[0] = m_data;
+    m++;
+
     // allocate rows and set pointers to them
     for (long i = 0; i < length_rows; i++) {
         m[i] = m_data + (size_t)i * length_cols; //link the data to the matrix
@@ -109,6 +419,52 @@ double **dmatrix(long length_rows, long length_cols) {
 
 
 
+/* packed lower triangle of an n x n matrix: row i holds columns 0..i and the
+   rows follow each other in one block of n(n+1)/2 elements, so L[i][j] works
+   for j <= i as with matrix(). Free with free_matrix(). */
+float **tri_matrix(long n) {
+    float **m = malloc((size_t)((n + 1) * sizeof(float *)));
+    float *m_data;
+
+    if (!m) nrerror("allocation failure 1 in tri_matrix()");
+    m_data = malloc((size_t)n * (n + 1) / 2 * sizeof(float));
+    if (!m_data) nrerror("allocation failure 2 in tri_matrix()");
+    m[0] = m_data;
+    m++;
+    for (long i = 0; i < n; i++) m[i] = m_data + (size_t)i * (i + 1) / 2;
+    return m;
+}
+
+
+/* row-pointer views over data owned by someone else (e.g. an mmap'd file).
+   The hidden slot is NULL, so free_matrix()/free_dmatrix() only release the
+   pointer array and leave the data alone. */
+
+float **matrix_view(float *data, long length_rows, long length_cols) {
+    float **m = malloc((size_t)((length_rows + 1) * sizeof(float *)));
+    if (!m) nrerror("allocation failure in matrix_view()");
+    m[0] = NULL;
+    m++;
+    for (long i = 0; i < length_rows; i++) {
+        m[i] = data + (size_t)i * length_cols;
+    }
+    return m;
+}
+
+
+double **dmatrix_view(double *data, long length_rows, long length_cols) {
+    double **m = malloc((size_t)((length_rows + 1) * sizeof(double *)));
+    if (!m) nrerror("allocation failure in dmatrix_view()");
+    m[0] = NULL;
+    m++;
+    for (long i = 0; i < length_rows; i++) {
+        m[i] = data + (size_t)i * length_cols;
+    }
+    return m;
+}
+
+
+
 // deallocation Functions 
 
 void free_vector(float *v) {
@@ -125,15 +481,221 @@ void free_dvector(double *v) {
 }
 
 void free_matrix(float **m) {
-    if (m[0] != NULL) {
-        free(m[0]); 
+    if (m[-1] != NULL) {
+        free(m[-1]); 
     }
-    free(m); 
+    free(m - 1); 
 }
 
 
 void free_dmatrix(double **m) {
-    free(m[0]); // free the data array
-    free(m); // free the array of pointers
+    if (m[-1] != NULL) free(m[-1]); // free the data array (NULL for views)
+    free(m - 1); // free the array of pointers
+}
+
+
+
+
+/* arena: bump allocation out of 64-byte aligned blocks, released all at once.
+   A block that runs out chains a new one; arena_reset() then merges them into
+   a single block of the high-water size, so a run of similar systems settles
+   on one block and no further malloc/free. */
+
+#define ARENA_ALIGN 64
+#define ARENA_ROUND(x) (((x) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+struct arena_block {
+    struct arena_block *next;   // older, full blocks
+    size_t size, used;          // bytes of data after the header
+};
+
+// header rounded up so the data of every block starts 64-byte aligned
+#define ARENA_HEADER ARENA_ROUND(sizeof(struct arena_block))
+
+static struct arena_block *arena_new_block(size_t size, struct arena_block *next) {
+    struct arena_block *b;
+
+    if (posix_memalign((void **)&b, ARENA_ALIGN, ARENA_HEADER + size) != 0) nrerror("allocation failure in arena_alloc()");
+    b->next = next;
+    b->size = size;
+    b->used = 0;
+    return b;
 }
 
+void arena_init(arena *a, size_t size) {
+    a->head = (size > 0) ? arena_new_block(ARENA_ROUND(size), NULL) : NULL;
+    a->used = a->peak = 0;
+}
+
+void *arena_alloc(arena *a, size_t bytes) {
+    struct arena_block *b = a->head;
+    void *p;
+
+    bytes = ARENA_ROUND(bytes > 0 ? bytes : 1);
+    if (b == NULL || b->size - b->used < bytes) {
+        size_t size = (b != NULL && 2 * b->size > bytes) ? 2 * b->size : bytes;
+        b = a->head = arena_new_block(size, b);
+    }
+    p = (char *)b + ARENA_HEADER + b->used;
+    b->used += bytes;
+    a->used += bytes;
+    if (a->used > a->peak) a->peak = a->used;
+    return p;
+}
+
+void arena_reset(arena *a) {
+    struct arena_block *b = a->head, *next;
+
+    if (b != NULL && b->next != NULL) {
+        for (; b != NULL; b = next) {
+            next = b->next;
+            free(b);
+        }
+        a->head = arena_new_block(a->peak, NULL);
+    } else if (b != NULL) {
+        b->used = 0;
+    }
+    a->used = 0;
+}
+
+void arena_free(arena *a) {
+    struct arena_block *b, *next;
+
+    for (b = a->head; b != NULL; b = next) {
+        next = b->next;
+        free(b);
+    }
+    a->head = NULL;
+    a->used = a->peak = 0;
+}
+
+// bytes arena_matrix()/arena_dmatrix() take, for sizing an arena up front
+size_t arena_matrix_size(long length_rows, long length_cols, size_t elem_size) {
+    return ARENA_ROUND((size_t)length_rows * sizeof(void *))
+         + ARENA_ROUND((size_t)length_rows * length_cols * elem_size);
+}
+
+// bytes arena_tri_matrix() takes
+size_t arena_tri_matrix_size(long n, size_t elem_size) {
+    return ARENA_ROUND((size_t)n * sizeof(void *)) + ARENA_ROUND((size_t)n * (n + 1) / 2 * elem_size);
+}
+
+float *arena_vector(arena *a, long length) {
+    return arena_alloc(a, (size_t)length * sizeof(float));
+}
+
+int *arena_ivector(arena *a, long length) {
+    return arena_alloc(a, (size_t)length * sizeof(int));
+}
+
+double *arena_dvector(arena *a, long length) {
+    return arena_alloc(a, (size_t)length * sizeof(double));
+}
+
+/* row-pointer matrices like matrix()/dmatrix(), rows contiguous from a
+   64-byte aligned start. They go away with the arena: never pass them to
+   free_matrix()/free_dmatrix(). */
+float **arena_matrix(arena *a, long length_rows, long length_cols) {
+    float **m = arena_alloc(a, (size_t)length_rows * sizeof(float *));
+    float *m_data = arena_vector(a, length_rows * length_cols);
+
+    for (long i = 0; i < length_rows; i++) m[i] = m_data + (size_t)i * length_cols;
+    return m;
+}
+
+double **arena_dmatrix(arena *a, long length_rows, long length_cols) {
+    double **m = arena_alloc(a, (size_t)length_rows * sizeof(double *));
+    double *m_data = arena_dvector(a, length_rows * length_cols);
+
+    for (long i = 0; i < length_rows; i++) m[i] = m_data + (size_t)i * length_cols;
+    return m;
+}
+
+// tri_matrix() from the arena
+float **arena_tri_matrix(arena *a, long n) {
+    float **m = arena_alloc(a, (size_t)n * sizeof(float *));
+    float *m_data = arena_vector(a, n * (n + 1) / 2);
+
+    for (long i = 0; i < n; i++) m[i] = m_data + (size_t)i * (i + 1) / 2;
+    return m;
+}
+
+
+
+/* strided matrix descriptors: element (i, j) of a row-major matrix is at
+   data[i * ld + j], of a column-major one at data[j * ld + i] */
+
+static size_t mat_type_size(mat_type type) {
+    return (type == MAT_FLOAT32) ? sizeof(float) : sizeof(double);
+}
+
+/* a rows x cols matrix from the arena; the leading dimension is padded to a
+   multiple of 64 bytes so every row (or column) starts aligned */
+mat_desc mat_alloc(arena *a, long rows, long cols, mat_layout layout, mat_type type) {
+    mat_desc d;
+    long per_line = ARENA_ALIGN / (long)mat_type_size(type);
+    long inner = (layout == MAT_ROW_MAJOR) ? cols : rows, outer = (layout == MAT_ROW_MAJOR) ? rows : cols;
+
+    d.ld = (inner + per_line - 1) / per_line * per_line;
+    d.data = arena_alloc(a, (size_t)outer * d.ld * mat_type_size(type));
+    d.rows = rows;
+    d.cols = cols;
+    d.layout = layout;
+    d.type = type;
+    return d;
+}
+
+// the storage of a dmatrix(), dmatrix_view() or csr_to_dmatrix() result; its row pointers must be in order
+mat_desc dmatrix_desc(double **m, long rows, long cols) {
+    mat_desc d = { m[0], rows, cols, cols, MAT_ROW_MAJOR, MAT_FLOAT64 };
+    return d;
+}
+
+// same data read the other way round: a row-major A is a column-major A^T
+mat_desc mat_transpose(mat_desc d) {
+    long t = d.rows;
+    d.rows = d.cols;
+    d.cols = t;
+    d.layout = (d.layout == MAT_ROW_MAJOR) ? MAT_COL_MAJOR : MAT_ROW_MAJOR;
+    return d;
+}
+
+static double mat_get(const mat_desc *d, long i, long j) {
+    size_t k = (d->layout == MAT_ROW_MAJOR) ? (size_t)i * d->ld + j : (size_t)j * d->ld + i;
+    return (d->type == MAT_FLOAT32) ? (double)((const float *)d->data)[k] : ((const double *)d->data)[k];
+}
+
+static void mat_set(mat_desc *d, long i, long j, double v) {
+    size_t k = (d->layout == MAT_ROW_MAJOR) ? (size_t)i * d->ld + j : (size_t)j * d->ld + i;
+    if (d->type == MAT_FLOAT32) ((float *)d->data)[k] = (float)v;
+    else ((double *)d->data)[k] = v;
+}
+
+#define MAT_TILE 32 // transposing copies go tile by tile so both sides stay in cache
+
+/* dst = src, converting layout and element type as needed; same layout and
+   type is one memcpy per row (or column) */
+void mat_copy(const mat_desc *src, mat_desc *dst) {
+    long i, j, ii, jj, outer, inner;
+
+    if (src->rows != dst->rows || src->cols != dst->cols) nrerror("mat_copy(): shapes differ");
+    outer = (dst->layout == MAT_ROW_MAJOR) ? dst->rows : dst->cols;
+    inner = (dst->layout == MAT_ROW_MAJOR) ? dst->cols : dst->rows;
+
+    if (src->layout == dst->layout && src->type == dst->type) {
+        size_t esize = mat_type_size(src->type);
+        for (i = 0; i < outer; i++) {
+            memcpy((char *)dst->data + (size_t)i * dst->ld * esize, (const char *)src->data + (size_t)i * src->ld * esize, (size_t)inner * esize);
+        }
+    } else if (src->layout == dst->layout) {
+        for (i = 0; i < src->rows; i++) for (j = 0; j < src->cols; j++) mat_set(dst, i, j, mat_get(src, i, j));
+    } else {
+        for (ii = 0; ii < src->rows; ii += MAT_TILE) {
+            for (jj = 0; jj < src->cols; jj += MAT_TILE) {
+                for (i = ii; i < ii + MAT_TILE && i < src->rows; i++) {
+                    for (j = jj; j < jj + MAT_TILE && j < src->cols; j++) mat_set(dst, i, j, mat_get(src, i, j));
+                }
+            }
+        }
+    }
+}
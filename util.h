@@ -1,10 +1,56 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <stdio.h>
+
 void nrerror(char error_text[]);
 
+double wall_time(void);
+
+/* per-phase timers: PROF_BEGIN("factor") ... PROF_END("factor") around each
+   phase of a run. Built in by default (make PROFILE=0 compiles them to
+   nothing); they only measure when SOLVER_PROFILE=1, and then print a table
+   with wall time and, where perf_event_open is allowed, cycles,
+   instructions and LLC misses per phase when the program exits. */
+#ifdef PROFILE
+#define PROF_BEGIN(phase) prof_begin(phase)
+#define PROF_END(phase) prof_end(phase)
+#else
+#define PROF_BEGIN(phase) ((void)0)
+#define PROF_END(phase) ((void)0)
+#endif
+
+void prof_begin(const char *name);
+
+void prof_end(const char *name);
+
+/* how print_matrix() and friends show a matrix:
+     quiet     not at all
+     summary   dimensions; nnz, min, max, norm_1, norm_inf and norm_F from
+               one pass over the elements; the PRINT_CORNER x PRINT_CORNER
+               corner blocks
+     full      every element, formatted into PRINT_BUFFER_BYTES blocks that
+               go out with one fwrite() each
+     auto      full up to PRINT_FULL_MAX rows and columns, summary above
+               (the default) */
+typedef enum { VERBOSITY_AUTO, VERBOSITY_QUIET, VERBOSITY_SUMMARY, VERBOSITY_FULL } verbosity;
+
+#ifndef PRINT_FULL_MAX
+#define PRINT_FULL_MAX 32
+#endif
+#define PRINT_CORNER 3
+#define PRINT_BUFFER_BYTES (1 << 16)
+
+int verbosity_parse(const char *arg, verbosity *level);
+
+void set_verbosity(verbosity level);
+
 void print_matrix(float **mat, long length_row, long length_col, const char *name);
 
+void print_dmatrix(double **mat, long length_row, long length_col, const char *name);
+
+void print_tri_matrix(float **L, long n, int symmetric, const char *name);
+
 void print_vector(float *vec, long length, const char *name);
 
 float *vector(long length);
@@ -17,6 +63,12 @@ float **matrix(long length_rows, long length_cols);
 
 double **dmatrix(long length_rows, long length_cols);
 
+float **tri_matrix(long n);
+
+float **matrix_view(float *data, long length_rows, long length_cols);
+
+double **dmatrix_view(double *data, long length_rows, long length_cols);
+
 void free_vector(float *v) ;
 
 void free_ivector(int *v);
@@ -28,5 +80,59 @@ void free_matrix(float **m);
 void free_dmatrix(double **m);
 
 
+/* arena allocator: 64-byte aligned blocks freed in one call, see util.c */
+typedef struct {
+    struct arena_block *head;   // current block, NULL until the first allocation
+    size_t used;                // bytes handed out since the last reset
+    size_t peak;                // most bytes ever in use at once
+} arena;
+
+void arena_init(arena *a, size_t size);
+
+void *arena_alloc(arena *a, size_t bytes);
+
+void arena_reset(arena *a);
+
+void arena_free(arena *a);
+
+size_t arena_matrix_size(long length_rows, long length_cols, size_t elem_size);
+
+size_t arena_tri_matrix_size(long n, size_t elem_size);
+
+float *arena_vector(arena *a, long length);
+
+int *arena_ivector(arena *a, long length);
+
+double *arena_dvector(arena *a, long length);
+
+float **arena_matrix(arena *a, long length_rows, long length_cols);
+
+double **arena_dmatrix(arena *a, long length_rows, long length_cols);
+
+float **arena_tri_matrix(arena *a, long n);
+
+
+/* strided matrix descriptor: contiguous storage with a leading dimension,
+   in the layout LAPACKE expects, to pass alongside the row-pointer matrices */
+typedef enum { MAT_ROW_MAJOR, MAT_COL_MAJOR } mat_layout;
+typedef enum { MAT_FLOAT32, MAT_FLOAT64 } mat_type;
+
+typedef struct {
+    void *data;
+    long rows, cols;
+    long ld;            // elements between the starts of consecutive rows (row-major) or columns (col-major)
+    mat_layout layout;
+    mat_type type;
+} mat_desc;
+
+mat_desc mat_alloc(arena *a, long rows, long cols, mat_layout layout, mat_type type);
+
+mat_desc dmatrix_desc(double **m, long rows, long cols);
+
+mat_desc mat_transpose(mat_desc d);
+
+void mat_copy(const mat_desc *src, mat_desc *dst);
+
+
 
 #endif
\ No newline at end of file
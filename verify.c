@@ -0,0 +1,329 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "verify.h"
+
+#define VERIFY_ROWS 4           // rows sharing each load of x
+#define VERIFY_LANES 8          // independent partial sums per row, for the vectorizer
+#define VERIFY_MAX_THREADS 64
+#define VERIFY_MIN_WORK (1L << 18) // multiply-adds per thread worth starting it for
+
+typedef struct {
+    float **A;                  // one of A and dA is set
+    double **dA;
+    float **B;                  // likewise
+    double **dB;
+    const double *x;            // X packed by columns, n per column
+    const long *rows;           // the rows to check, NULL: all of them
+    long first, last;           // positions in rows handled by this worker
+    int n, m;
+    double *rmax;               // per column, max |b - Ax| over this worker's rows
+    double anorm;               // max row sum of |A| over this worker's rows
+} verify_worker;
+
+
+/* y[r] = A[r] . x and s[r] = sum |A[r]| for VERIFY_ROWS rows at once,
+   VERIFY_LANES partial sums each; compiled twice, the loader picks the AVX2
+   clone where it runs */
+#define DEFINE_DOT_ROWS(name, type)                                                          \
+__attribute__((target_clones("avx2", "default")))                                            \
+static void name(type *const *a, const double *x, int n, double *y, double *s)               \
+{                                                                                            \
+    double acc[VERIFY_ROWS][VERIFY_LANES] = {{0.0}}, abs_acc[VERIFY_ROWS][VERIFY_LANES] = {{0.0}}; \
+    int j = 0, r, l;                                                                         \
+                                                                                             \
+    for (; j + VERIFY_LANES <= n; j += VERIFY_LANES) {                                       \
+        for (r = 0; r < VERIFY_ROWS; r++) {                                                  \
+            for (l = 0; l < VERIFY_LANES; l++) {                                             \
+                double v = (double)a[r][j + l];                                              \
+                acc[r][l] += v * x[j + l];                                                   \
+                abs_acc[r][l] += fabs(v);                                                    \
+            }                                                                                \
+        }                                                                                    \
+    }                                                                                        \
+    for (r = 0; r < VERIFY_ROWS; r++) {                                                      \
+        double d = 0.0, t = 0.0;                                                             \
+        for (l = 0; l < VERIFY_LANES; l++) { d += acc[r][l]; t += abs_acc[r][l]; }           \
+        for (l = j; l < n; l++) { d += (double)a[r][l] * x[l]; t += fabs((double)a[r][l]); } \
+        y[r] = d;                                                                            \
+        s[r] = t;                                                                            \
+    }                                                                                        \
+}
+
+DEFINE_DOT_ROWS(dot_rows_f, float)
+DEFINE_DOT_ROWS(dot_rows_d, double)
+
+
+static void *verify_rows(void *arg) {
+    verify_worker *w = arg;
+    float *ra[VERIFY_ROWS];
+    double *rd[VERIFY_ROWS], y[VERIFY_ROWS], s[VERIFY_ROWS], b, r;
+    long p, idx[VERIFY_ROWS];
+    int k, l, cnt;
+
+    for (l = 0; l < w->m; l++) w->rmax[l] = 0.0;
+    w->anorm = 0.0;
+    for (p = w->first; p < w->last; p += VERIFY_ROWS) {
+        // a short last block repeats its final row
+        cnt = (w->last - p < VERIFY_ROWS) ? (int)(w->last - p) : VERIFY_ROWS;
+        for (k = 0; k < VERIFY_ROWS; k++) {
+            idx[k] = (w->rows != NULL) ? w->rows[p + (k < cnt ? k : cnt - 1)] : p + (k < cnt ? k : cnt - 1);
+            if (w->dA != NULL) rd[k] = w->dA[idx[k]];
+            else ra[k] = w->A[idx[k]];
+        }
+        for (l = 0; l < w->m; l++) {
+            if (w->dA != NULL) dot_rows_d(rd, w->x + (size_t)l * w->n, w->n, y, s);
+            else dot_rows_f(ra, w->x + (size_t)l * w->n, w->n, y, s);
+            for (k = 0; k < cnt; k++) {
+                b = (w->dB != NULL) ? w->dB[idx[k]][l] : w->B[idx[k]][l];
+                r = fabs(b - y[k]);
+                if (r > w->rmax[l] || isnan(r)) w->rmax[l] = r;
+                if (l == 0 && s[k] > w->anorm) w->anorm = s[k];
+            }
+        }
+    }
+    return NULL;
+}
+
+static int verify_threads(long positions, int n, int nthreads) {
+    const char *env = getenv("VERIFY_NUM_THREADS");
+    long t = (nthreads > 0) ? nthreads : (env != NULL) ? atol(env) : sysconf(_SC_NPROCESSORS_ONLN);
+    long useful = positions * (long)n / VERIFY_MIN_WORK;
+
+    if (t > useful) t = useful;
+    if (t > VERIFY_MAX_THREADS) t = VERIFY_MAX_THREADS;
+    return (t < 1) ? 1 : (int)t;
+}
+
+// worst column of eta from the per-column residual maxima and the norms
+static void finish(verify_result *res, const double *rmax, double anorm, double **dB, float **B, double **dX, float **X,
+                   int n, int m, double tol) {
+    double bnorm, xnorm, eta, den;
+    int i, l;
+
+    res->backward_error = -1.0;
+    for (l = 0; l < m; l++) {
+        bnorm = xnorm = 0.0;
+        for (i = 0; i < n; i++) {
+            bnorm = fmax(bnorm, fabs((dB != NULL) ? dB[i][l] : B[i][l]));
+            xnorm = fmax(xnorm, fabs((dX != NULL) ? dX[i][l] : X[i][l]));
+        }
+        den = anorm * xnorm + bnorm;
+        eta = (den > 0.0) ? rmax[l] / den : rmax[l];
+        if (isnan(eta) || isnan(xnorm)) eta = INFINITY;
+        if (eta > res->backward_error) {
+            res->backward_error = eta;
+            res->residual = rmax[l];
+            res->column = l;
+        }
+    }
+    res->passed = (res->backward_error <= tol);
+}
+
+// VERIFY_SAMPLE_ROWS rows by a fixed xorshift, so runs are repeatable; NULL for all rows
+static long *sample_rows(long n, verify_mode mode, long *count) {
+    uint64_t state = 0x9E3779B97F4A7C15ULL ^ (uint64_t)n;
+    long *rows, k;
+
+    *count = n;
+    if (mode != VERIFY_SAMPLED || n <= VERIFY_SAMPLE_ROWS) return NULL;
+    if ((rows = malloc(VERIFY_SAMPLE_ROWS * sizeof(long))) == NULL) return NULL; // falls back to all rows
+    for (k = 0; k < VERIFY_SAMPLE_ROWS; k++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        rows[k] = (long)(state % (uint64_t)n);
+    }
+    *count = VERIFY_SAMPLE_ROWS;
+    return rows;
+}
+
+
+static void verify_dense(float **A, float **B, float **X, double **dA, double **dB, double **dX,
+                         int n, int m, verify_mode mode, double tol, int nthreads, verify_result *res) {
+    pthread_t tid[VERIFY_MAX_THREADS];
+    int started[VERIFY_MAX_THREADS];
+    verify_worker workers[VERIFY_MAX_THREADS];
+    double *x, *rmax, anorm = 0.0;
+    long *rows, count, chunk;
+    int t, j, l;
+
+    memset(res, 0, sizeof(*res));
+    if (mode == VERIFY_NONE) { res->passed = 1; return; }
+    rows = sample_rows(n, mode, &count);
+    nthreads = verify_threads(count, n, nthreads);
+    x = malloc(((size_t)n * m + (size_t)nthreads * m) * sizeof(double));
+    if (x == NULL) {
+        fprintf(stderr, "Error: Out of memory in the verification.\n");
+        free(rows);
+        res->backward_error = INFINITY;
+        return;
+    }
+    rmax = x + (size_t)n * m;
+    for (j = 0; j < n; j++) {
+        for (l = 0; l < m; l++) x[(size_t)l * n + j] = (dX != NULL) ? dX[j][l] : X[j][l];
+    }
+
+    // contiguous row ranges, in whole blocks; worker 0 runs on the calling thread
+    chunk = ((count + nthreads - 1) / nthreads + VERIFY_ROWS - 1) / VERIFY_ROWS * VERIFY_ROWS;
+    for (t = 0; t < nthreads; t++) {
+        long first = (long)t * chunk < count ? (long)t * chunk : count;
+        long last = first + chunk < count ? first + chunk : count;
+        workers[t] = (verify_worker){ A, dA, B, dB, x, rows, first, last, n, m, rmax + (size_t)t * m, 0.0 };
+    }
+    for (t = 1; t < nthreads; t++) {
+        started[t] = (pthread_create(&tid[t], NULL, verify_rows, &workers[t]) == 0);
+        if (!started[t]) verify_rows(&workers[t]);
+    }
+    verify_rows(&workers[0]);
+    for (t = 1; t < nthreads; t++) {
+        if (started[t]) pthread_join(tid[t], NULL);
+    }
+
+    for (t = 0; t < nthreads; t++) {
+        anorm = fmax(anorm, workers[t].anorm);
+        for (l = 0; l < m && t > 0; l++) {
+            if (rmax[(size_t)t * m + l] > rmax[l] || isnan(rmax[(size_t)t * m + l])) rmax[l] = rmax[(size_t)t * m + l];
+        }
+    }
+    res->rows = count;
+    finish(res, rmax, anorm, dB, B, dX, X, n, m, tol);
+    free(x);
+    free(rows);
+}
+
+void verify(float **A, float **B, float **X, int n, int m, verify_mode mode, double tol, int nthreads, verify_result *res) {
+    verify_dense(A, B, X, NULL, NULL, NULL, n, m, mode, tol, nthreads, res);
+}
+
+void verify_d(double **A, double **B, double **X, int n, int m, verify_mode mode, double tol, int nthreads, verify_result *res) {
+    verify_dense(NULL, NULL, NULL, A, B, X, n, m, mode, tol, nthreads, res);
+}
+
+/* same check with A symmetric, stored as its packed lower triangle L
+   (tri_matrix()); one thread. All rows: y = Ax as a SYMV sweep, each row
+   of L read once per column and used for both its row and its column.
+   Sampled rows: row i is L[i][0..i] followed by the column L[i+1..n-1][i]. */
+void verify_sym(float **L, float **B, float **X, int n, int m, verify_mode mode, double tol, verify_result *res) {
+    long *rows, count, p;
+    double *x, *y, *s, *rmax, anorm = 0.0, a, d, t, r;
+    int i, j, l;
+
+    memset(res, 0, sizeof(*res));
+    if (mode == VERIFY_NONE) { res->passed = 1; return; }
+    rows = sample_rows(n, mode, &count);
+    if ((x = malloc((3 * (size_t)n + (size_t)m) * sizeof(double))) == NULL) {
+        fprintf(stderr, "Error: Out of memory in the verification.\n");
+        free(rows);
+        res->backward_error = INFINITY;
+        return;
+    }
+    y = x + n;
+    s = y + n;
+    rmax = s + n;
+    for (l = 0; l < m; l++) {
+        rmax[l] = 0.0;
+        for (j = 0; j < n; j++) x[j] = X[j][l];
+        if (rows == NULL) {
+            for (i = 0; i < n; i++) y[i] = s[i] = 0.0;
+            for (i = 0; i < n; i++) {
+                d = t = 0.0;
+                for (j = 0; j < i; j++) {
+                    a = L[i][j];
+                    d += a * x[j];
+                    t += fabs(a);
+                    y[j] += a * x[i];
+                    s[j] += fabs(a);
+                }
+                y[i] += d + (double)L[i][i] * x[i];
+                s[i] += t + fabs((double)L[i][i]);
+            }
+        }
+        for (p = 0; p < count; p++) {
+            i = (rows != NULL) ? (int)rows[p] : (int)p;
+            if (rows != NULL) {
+                d = t = 0.0;
+                for (j = 0; j < n; j++) {
+                    a = (j <= i) ? L[i][j] : L[j][i];
+                    d += a * x[j];
+                    t += fabs(a);
+                }
+                y[i] = d;
+                s[i] = t;
+            }
+            r = fabs(B[i][l] - y[i]);
+            if (r > rmax[l] || isnan(r)) rmax[l] = r;
+            if (l == 0) anorm = fmax(anorm, s[i]);
+        }
+    }
+    res->rows = count;
+    finish(res, rmax, anorm, NULL, B, NULL, X, n, m, tol);
+    free(x);
+    free(rows);
+}
+
+// same check on CSR storage, one thread: the product is nnz long
+void verify_csr(const csr_matrix *A, double **B, double **X, int m, verify_mode mode, double tol, verify_result *res) {
+    long n = A->n_rows, *rows, count, p, i, k;
+    double *rmax, anorm = 0.0, d, s, r;
+    int l;
+
+    memset(res, 0, sizeof(*res));
+    if (mode == VERIFY_NONE) { res->passed = 1; return; }
+    rows = sample_rows(n, mode, &count);
+    if ((rmax = calloc((size_t)m, sizeof(double))) == NULL) {
+        fprintf(stderr, "Error: Out of memory in the verification.\n");
+        free(rows);
+        res->backward_error = INFINITY;
+        return;
+    }
+    for (p = 0; p < count; p++) {
+        i = (rows != NULL) ? rows[p] : p;
+        s = 0.0;
+        for (k = A->row_ptr[i]; k < A->row_ptr[i + 1]; k++) s += fabs(A->val[k]);
+        anorm = fmax(anorm, s);
+        for (l = 0; l < m; l++) {
+            d = 0.0;
+            for (k = A->row_ptr[i]; k < A->row_ptr[i + 1]; k++) d += A->val[k] * X[A->col_idx[k]][l];
+            r = fabs(B[i][l] - d);
+            if (r > rmax[l] || isnan(r)) rmax[l] = r;
+        }
+    }
+    res->rows = count;
+    finish(res, rmax, anorm, B, NULL, X, NULL, (int)n, m, tol);
+    free(rmax);
+    free(rows);
+}
+
+
+// the text after --verify=
+int verify_parse(const char *arg, verify_mode *mode) {
+    if (strcmp(arg, "full") == 0) *mode = VERIFY_FULL;
+    else if (strcmp(arg, "sampled") == 0) *mode = VERIFY_SAMPLED;
+    else if (strcmp(arg, "none") == 0) *mode = VERIFY_NONE;
+    else return -1;
+    return 0;
+}
+
+const char *verify_mode_name(verify_mode mode) {
+    return (mode == VERIFY_SAMPLED) ? "sampled" : (mode == VERIFY_NONE) ? "none" : "full";
+}
+
+double verify_tol(long n, double eps) {
+    return VERIFY_RATIO * sqrt((double)(n > 1 ? n : 1)) * eps;
+}
+
+void verify_print(const verify_result *res, verify_mode mode, double tol) {
+    if (mode == VERIFY_NONE) {
+        printf("  Verification skipped (--verify=none).\n");
+        return;
+    }
+    printf("  Backward error %.3e (column %d, ||b - Ax||_inf = %.3e, %s, %ld row(s)).\n",
+           res->backward_error, res->column, res->residual, verify_mode_name(mode), res->rows);
+    if (res->passed) printf("  Verification successful (backward error <= %.1e).\n", tol);
+    else printf("  Verification FAILED (backward error > %.1e).\n", tol);
+}
@@ -0,0 +1,58 @@
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include "sparse.h"
+
+/* checking a solution X of AX = B by its normwise backward error
+
+     eta = ||b - Ax||_inf / (||A||_inf ||x||_inf + ||b||_inf)
+
+   per column, reporting the worst one. eta is the relative perturbation of
+   A and b for which x is exact, so it is comparable across sizes and
+   scalings where a fixed per-entry tolerance is not.
+
+   full      every row; the product runs VERIFY_ROWS rows at a time against
+             each column, accumulated in double, split over threads
+             (VERIFY_NUM_THREADS, default: all online CPUs)
+   sampled   VERIFY_SAMPLE_ROWS random rows, O(k n): a sanity check for the
+             hot path. ||A||_inf is taken over the same rows, which can only
+             make eta larger.
+   none      no check */
+
+#ifndef VERIFY_SAMPLE_ROWS
+#define VERIFY_SAMPLE_ROWS 64
+#endif
+
+/* eta passes below VERIFY_RATIO * sqrt(n) * eps. n * eps is the worst-case
+   bound for a stable solve and lets a bad one through at a few hundred rows;
+   rounding errors that do not line up grow like sqrt(n) * eps, which is what
+   the float solvers here show (eta a few eps, ~15 eps at n = 5000). */
+#define VERIFY_RATIO 10.0
+
+typedef enum { VERIFY_FULL, VERIFY_SAMPLED, VERIFY_NONE } verify_mode;
+
+typedef struct {
+    double backward_error;  // worst column
+    double residual;        // ||b - Ax||_inf of that column
+    int column;
+    long rows;              // rows checked per column
+    int passed;             // backward_error <= tol
+} verify_result;
+
+int verify_parse(const char *arg, verify_mode *mode);
+
+const char *verify_mode_name(verify_mode mode);
+
+double verify_tol(long n, double eps);
+
+void verify(float **A, float **B, float **X, int n, int m, verify_mode mode, double tol, int nthreads, verify_result *res);
+
+void verify_d(double **A, double **B, double **X, int n, int m, verify_mode mode, double tol, int nthreads, verify_result *res);
+
+void verify_sym(float **L, float **B, float **X, int n, int m, verify_mode mode, double tol, verify_result *res);
+
+void verify_csr(const csr_matrix *A, double **B, double **X, int m, verify_mode mode, double tol, verify_result *res);
+
+void verify_print(const verify_result *res, verify_mode mode, double tol);
+
+#endif